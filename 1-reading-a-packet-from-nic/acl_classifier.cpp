@@ -0,0 +1,360 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "acl_classifier.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <rte_acl.h>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_pause.h>
+
+constexpr uint16_t max_acl_burst = 64;
+
+// The classification key of a packet. The fields are copied from the packet in network byte order, so packets with
+// IPv4 options and protocols without ports (ports are 0) can be classified with the same field layout.
+struct acl_key {
+    uint8_t proto;
+    uint8_t reserved[3];
+    uint32_t src_addr;
+    uint32_t dst_addr;
+    uint16_t src_port;
+    uint16_t dst_port;
+};
+
+enum { PROTO_FIELD, SRC_FIELD, DST_FIELD, SRC_PORT_FIELD, DST_PORT_FIELD, NUM_FIELDS };
+
+// rte_acl reads the key in 4 byte groups (input_index). The two ports share one group.
+static const rte_acl_field_def acl_field_defs[NUM_FIELDS] = {
+    {RTE_ACL_FIELD_TYPE_BITMASK, sizeof(uint8_t), PROTO_FIELD, 0, offsetof(acl_key, proto)},
+    {RTE_ACL_FIELD_TYPE_MASK, sizeof(uint32_t), SRC_FIELD, 1, offsetof(acl_key, src_addr)},
+    {RTE_ACL_FIELD_TYPE_MASK, sizeof(uint32_t), DST_FIELD, 2, offsetof(acl_key, dst_addr)},
+    {RTE_ACL_FIELD_TYPE_RANGE, sizeof(uint16_t), SRC_PORT_FIELD, 3, offsetof(acl_key, src_port)},
+    {RTE_ACL_FIELD_TYPE_RANGE, sizeof(uint16_t), DST_PORT_FIELD, 3, offsetof(acl_key, dst_port)},
+};
+
+RTE_ACL_RULE_DEF(acl_ipv4_rule, NUM_FIELDS);
+
+// The classify algorithms from the widest to the narrowest SIMD width. The first one which the CPU (and the EAL
+// argument --force-max-simd-bitwidth) supports is used.
+static const struct {
+    rte_acl_classify_alg alg;
+    const char *name;
+} acl_algorithms[] = {
+    {RTE_ACL_CLASSIFY_AVX512X32, "avx512x32"},
+    {RTE_ACL_CLASSIFY_AVX512X16, "avx512x16"},
+    {RTE_ACL_CLASSIFY_AVX2, "avx2"},
+    {RTE_ACL_CLASSIFY_SSE, "sse"},
+    {RTE_ACL_CLASSIFY_SCALAR, "scalar"},
+};
+
+struct acl_classifier {
+    int32_t socket_id = 0;
+    uint32_t generation = 0;                    // Used to give every built context a unique name.
+    std::atomic<rte_acl_ctx *> ctx{nullptr};
+    std::atomic<uint32_t> rule_count{0};
+    std::atomic<const char *> algorithm{nullptr};
+
+    // Odd while the data path classifies, even otherwise. acl_classifier_reload() waits on it before it frees the
+    // replaced context.
+    alignas(RTE_CACHE_LINE_SIZE) std::atomic<uint64_t> reader_sequence{0};
+    uint64_t classify_cycles = 0;
+    uint64_t classified_packets = 0;
+};
+
+static bool parse_prefix(const std::string &text, rte_acl_field &field)
+{
+    const size_t slash = text.find('/');
+    const std::string address = text.substr(0, slash);
+    const uint32_t depth = (slash == std::string::npos) ? 32 : strtoul(text.c_str() + slash + 1, nullptr, 10);
+
+    uint32_t ip = 0;
+    if (depth > 32 || inet_pton(AF_INET, address.c_str(), &ip) != 1) {
+        return false;
+    }
+    // Rule values are given in host byte order, rte_acl converts them when the context is built.
+    field.value.u32 = rte_be_to_cpu_32(ip);
+    field.mask_range.u32 = depth;
+    return true;
+}
+
+static bool parse_port_range(const std::string &text, rte_acl_field &field)
+{
+    char *end = nullptr;
+    const uint32_t low = strtoul(text.c_str(), &end, 10);
+    const uint32_t high = (*end == '-') ? strtoul(end + 1, nullptr, 10) : low;
+    if (low > high || high > UINT16_MAX) {
+        return false;
+    }
+    field.value.u16 = low;
+    field.mask_range.u16 = high;
+    return true;
+}
+
+static bool parse_protocol(const std::string &text, rte_acl_field &field)
+{
+    field.mask_range.u8 = 0xff;
+    if (text == "any") {
+        field.value.u8 = 0;
+        field.mask_range.u8 = 0;
+    } else if (text == "tcp") {
+        field.value.u8 = IPPROTO_TCP;
+    } else if (text == "udp") {
+        field.value.u8 = IPPROTO_UDP;
+    } else if (text == "icmp") {
+        field.value.u8 = IPPROTO_ICMP;
+    } else {
+        const uint32_t proto = strtoul(text.c_str(), nullptr, 10);
+        if (proto > UINT8_MAX) {
+            return false;
+        }
+        field.value.u8 = proto;
+    }
+    return true;
+}
+
+static bool load_rules(const char *rules_file, std::vector<acl_ipv4_rule> &rules)
+{
+    std::ifstream file(rules_file);
+    if (!file) {
+        std::cerr << "Unable to open ACL rules file: " << rules_file << std::endl;
+        return false;
+    }
+
+    std::string text;
+    uint32_t line_number = 0;
+    while (std::getline(file, text)) {
+        line_number++;
+        std::istringstream line(text);
+        std::string src, dst, src_ports, dst_ports, proto, action;
+        if (!(line >> src) || src[0] == '#') {
+            continue;
+        }
+
+        acl_ipv4_rule rule = {};
+        line >> dst >> src_ports >> dst_ports >> proto >> action;
+        if (!parse_prefix(src, rule.field[SRC_FIELD]) || !parse_prefix(dst, rule.field[DST_FIELD]) ||
+            !parse_port_range(src_ports, rule.field[SRC_PORT_FIELD]) ||
+            !parse_port_range(dst_ports, rule.field[DST_PORT_FIELD]) ||
+            !parse_protocol(proto, rule.field[PROTO_FIELD]) || (action != "permit" && action != "deny")) {
+            std::cerr << "Invalid rule in ACL rules file " << rules_file << " line " << line_number << ": " << text << std::endl;
+            return false;
+        }
+
+        // rte_acl picks the matching rule with the highest priority, so earlier lines get higher priorities.
+        rule.data.category_mask = 1;
+        rule.data.priority = RTE_ACL_MAX_PRIORITY - static_cast<int32_t>(rules.size());
+        rule.data.userdata = (action == "permit") ? acl_permit : acl_deny;
+        rules.push_back(rule);
+    }
+
+    return true;
+}
+
+// Builds a new ACL context from the rules file. Returns nullptr if the rules are invalid or the build fails.
+static rte_acl_ctx *build_context(acl_classifier *classifier, const char *rules_file, uint32_t &rule_count, const char *&algorithm)
+{
+    std::vector<acl_ipv4_rule> rules;
+    if (!load_rules(rules_file, rules)) {
+        return nullptr;
+    }
+
+    const std::string name = "acl_ctx_" + std::to_string(classifier->generation++);
+    rte_acl_param param = {};
+    param.name = name.c_str();
+    param.socket_id = classifier->socket_id;
+    param.rule_size = RTE_ACL_RULE_SZ(NUM_FIELDS);
+    param.max_rule_num = RTE_MAX(static_cast<uint32_t>(rules.size()), 1U);
+
+    rte_acl_ctx *ctx = rte_acl_create(&param);
+    if (ctx == nullptr) {
+        std::cerr << "Unable to create ACL context. Error code: " << rte_errno << std::endl;
+        return nullptr;
+    }
+
+    rte_acl_config config = {};
+    config.num_categories = 1;
+    config.num_fields = NUM_FIELDS;
+    memcpy(config.defs, acl_field_defs, sizeof(acl_field_defs));
+
+    int32_t return_val = rte_acl_add_rules(ctx, reinterpret_cast<const rte_acl_rule *>(rules.data()), rules.size());
+    if (return_val == 0) {
+        return_val = rte_acl_build(ctx, &config);
+    }
+    if (return_val != 0) {
+        std::cerr << "Unable to build ACL context. Return code: " << return_val << std::endl;
+        rte_acl_free(ctx);
+        return nullptr;
+    }
+
+    for (const auto &candidate : acl_algorithms) {
+        if (rte_acl_set_ctx_classify(ctx, candidate.alg) == 0) {
+            algorithm = candidate.name;
+            break;
+        }
+    }
+
+    rule_count = rules.size();
+    return ctx;
+}
+
+acl_classifier *acl_classifier_create(const char *rules_file, int32_t socket_id)
+{
+    acl_classifier *classifier = new acl_classifier();
+    classifier->socket_id = socket_id;
+
+    uint32_t rule_count = 0;
+    const char *algorithm = nullptr;
+    rte_acl_ctx *ctx = build_context(classifier, rules_file, rule_count, algorithm);
+    if (ctx == nullptr) {
+        delete classifier;
+        return nullptr;
+    }
+
+    classifier->ctx.store(ctx);
+    classifier->rule_count.store(rule_count);
+    classifier->algorithm.store(algorithm);
+    std::cout << "Loaded " << rule_count << " ACL rules from " << rules_file << ". Classify algorithm: " << algorithm << std::endl;
+    return classifier;
+}
+
+void acl_classifier_free(acl_classifier *classifier)
+{
+    if (classifier == nullptr) {
+        return;
+    }
+    rte_acl_free(classifier->ctx.load());
+    delete classifier;
+}
+
+bool acl_classifier_reload(acl_classifier *classifier, const char *rules_file)
+{
+    uint32_t rule_count = 0;
+    const char *algorithm = nullptr;
+    rte_acl_ctx *ctx = build_context(classifier, rules_file, rule_count, algorithm);
+    if (ctx == nullptr) {
+        std::cerr << "Keeping the current ACL rules" << std::endl;
+        return false;
+    }
+
+    rte_acl_ctx *old_ctx = classifier->ctx.exchange(ctx);
+    classifier->rule_count.store(rule_count);
+    classifier->algorithm.store(algorithm);
+
+    // If the data path is inside acl_classify_burst() (odd sequence) it may still use the old context. Once the
+    // sequence changes, the burst is finished and every later burst loads the new context.
+    const uint64_t sequence = classifier->reader_sequence.load();
+    if (sequence & 1) {
+        while (classifier->reader_sequence.load() == sequence) {
+            rte_pause();
+        }
+    }
+
+    rte_acl_free(old_ctx);
+    std::cout << "Reloaded " << rule_count << " ACL rules from " << rules_file << std::endl;
+    return true;
+}
+
+void acl_classify_burst(acl_classifier *classifier, rte_mbuf **packets, uint16_t count, uint32_t *actions)
+{
+    acl_key keys[max_acl_burst];
+    const uint8_t *data[max_acl_burst];
+    uint16_t indexes[max_acl_burst];
+    uint32_t results[max_acl_burst];
+    uint16_t key_count = 0;
+
+    if (count > max_acl_burst) {
+        acl_classify_burst(classifier, packets + max_acl_burst, count - max_acl_burst, actions + max_acl_burst);
+        count = max_acl_burst;
+    }
+
+    const uint64_t start_cycles = rte_rdtsc();
+
+    for (uint16_t i = 0; i < count; i++) {
+        actions[i] = acl_no_match;
+
+        const rte_mbuf *packet = packets[i];
+        const rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packet, const rte_ether_hdr *);
+        if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+            packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr)) {
+            continue;
+        }
+
+        const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(eth_hdr + 1);
+        const uint32_t l3_len = rte_ipv4_hdr_len(ipv4_hdr);
+        acl_key &key = keys[key_count];
+        key.proto = ipv4_hdr->next_proto_id;
+        key.src_addr = ipv4_hdr->src_addr;
+        key.dst_addr = ipv4_hdr->dst_addr;
+        key.src_port = 0;
+        key.dst_port = 0;
+
+        // Only the first fragment carries the TCP / UDP header; the other fragments are matched with port 0, like
+        // protocols without ports, so their payload never decides a port rule.
+        const bool first_fragment = (ipv4_hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0;
+        if ((key.proto == IPPROTO_TCP || key.proto == IPPROTO_UDP) && first_fragment &&
+            packet->data_len >= sizeof(rte_ether_hdr) + l3_len + 2 * sizeof(uint16_t)) {
+            // The source and destination ports are the first 4 bytes of both the TCP and the UDP header.
+            const uint16_t *ports = reinterpret_cast<const uint16_t *>(reinterpret_cast<const uint8_t *>(ipv4_hdr) + l3_len);
+            key.src_port = ports[0];
+            key.dst_port = ports[1];
+        }
+
+        data[key_count] = reinterpret_cast<const uint8_t *>(&key);
+        indexes[key_count++] = i;
+    }
+
+    if (key_count > 0) {
+        // Enter the read side: the sequence is odd while the context is in use (see acl_classifier_reload()).
+        const uint64_t sequence = classifier->reader_sequence.load(std::memory_order_relaxed);
+        classifier->reader_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        rte_acl_classify(classifier->ctx.load(std::memory_order_acquire), data, results, key_count, 1);
+
+        classifier->reader_sequence.store(sequence + 2, std::memory_order_release);
+
+        for (uint16_t i = 0; i < key_count; i++) {
+            actions[indexes[i]] = results[i];
+        }
+    }
+
+    classifier->classify_cycles += rte_rdtsc() - start_cycles;
+    classifier->classified_packets += count;
+}
+
+void acl_classifier_print_stats(const acl_classifier *classifier)
+{
+    const uint64_t packets = classifier->classified_packets;
+    std::cout << "ACL rules: " << classifier->rule_count.load() << " Algorithm: " << classifier->algorithm.load()
+              << " Classified packets: " << packets << " Cycles/packet: "
+              << (packets > 0 ? static_cast<double>(classifier->classify_cycles) / packets : 0.0) << std::endl;
+}
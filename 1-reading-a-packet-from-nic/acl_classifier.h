@@ -0,0 +1,63 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mbuf.h>
+
+// Access control list (ACL) stage. Every received IPv4 packet is classified against a list of 5-tuple rules with the
+// DPDK ACL library (rte_acl). The first matching rule decides if the packet is permitted or denied. Packets which do
+// not match any rule (and non IPv4 packets) are permitted.
+//
+// The rules file has one rule per line. Empty lines and lines starting with '#' are ignored. Rules on earlier lines
+// have a higher priority.
+//   <src prefix> <dst prefix> <src port range> <dst port range> <protocol> <permit|deny>
+//   e.g. 10.0.0.0/8 0.0.0.0/0 0-65535 22-22 tcp deny
+// <protocol> is tcp, udp, icmp, any or a protocol number.
+
+// Result of the classification of a single packet.
+enum acl_action : uint32_t {
+    acl_no_match = 0,   // rte_acl_classify() returns 0 when no rule matches.
+    acl_permit = 1,
+    acl_deny = 2
+};
+
+struct acl_classifier;
+
+// Builds the ACL context from the rules file. Returns nullptr and prints the reason if the file is invalid.
+acl_classifier *acl_classifier_create(const char *rules_file, int32_t socket_id);
+
+void acl_classifier_free(acl_classifier *classifier);
+
+// Builds a new ACL context from the rules file and atomically replaces the context used by acl_classify_burst(). The
+// old context is freed once the data path no longer uses it. The data path keeps classifying during the rebuild. Must
+// be called from a control thread, never from the lcore which classifies. Returns false if the new rules are invalid;
+// the old rules stay active in that case.
+bool acl_classifier_reload(acl_classifier *classifier, const char *rules_file);
+
+// Classifies a burst of packets and writes one acl_action per packet to `actions`. Only one lcore may classify with a
+// classifier at a time.
+void acl_classify_burst(acl_classifier *classifier, rte_mbuf **packets, uint16_t count, uint32_t *actions);
+
+// Prints the number of rules, the SIMD algorithm used and the classification cycles per packet.
+void acl_classifier_print_stats(const acl_classifier *classifier);
@@ -0,0 +1,44 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Incremental checksum update of RFC 1624 (eqn. 3): HC' = ~(~HC + ~m + m'). When a stage rewrites a field of a header,
+// the IPv4 header checksum and the TCP / UDP checksum (whose pseudo header covers the IPv4 addresses) are patched from
+// the old and the new value of the field instead of summing the whole header or payload again. The values are 16 bit
+// words as they are in the packet, so the byte order does not matter.
+
+static inline uint16_t checksum_replace16(uint16_t checksum, uint16_t old_value, uint16_t new_value)
+{
+    uint32_t sum = static_cast<uint16_t>(~checksum) + static_cast<uint16_t>(~old_value) + new_value;
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return ~sum;
+}
+
+static inline uint16_t checksum_replace32(uint16_t checksum, uint32_t old_value, uint32_t new_value)
+{
+    checksum = checksum_replace16(checksum, old_value >> 16, new_value >> 16);
+    return checksum_replace16(checksum, old_value & 0xFFFF, new_value & 0xFFFF);
+}
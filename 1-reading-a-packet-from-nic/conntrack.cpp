@@ -0,0 +1,505 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "conntrack.h"
+
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_tcp.h>
+#include <rte_telemetry.h>
+
+#include "app_telemetry.h"
+#include "flow_key.h"
+
+constexpr uint16_t max_track_burst = 64;
+constexpr uint32_t wheel_slots = 256;               // With 1 second slots, longer timeouts go around the wheel again.
+constexpr uint32_t expire_budget = 256;             // Entries checked by the timer wheel per poll.
+constexpr uint32_t no_entry = UINT32_MAX;
+
+enum conntrack_state : uint8_t {
+    tcp_syn_sent,
+    tcp_syn_recv,
+    tcp_established,
+    tcp_fin_wait,
+    tcp_time_wait,
+    tcp_close,
+    unreplied,
+    replied,
+    conntrack_state_count
+};
+
+static const struct {
+    const char *name;
+    uint32_t timeout_s;
+} conntrack_states[conntrack_state_count] = {
+    {"tcp_syn_sent", 120},
+    {"tcp_syn_recv", 60},
+    {"tcp_established", 600},
+    {"tcp_fin_wait", 120},
+    {"tcp_time_wait", 120},
+    {"tcp_close", 10},
+    {"unreplied", 30},
+    {"replied", 120},
+};
+
+struct conntrack_entry {
+    uint64_t last_tsc;
+    uint64_t packets;
+    uint64_t bytes;
+    uint32_t next;                  // Next entry in the same timer wheel slot.
+    conntrack_state state;
+    bool in_use;
+    bool swapped;                   // The originator is the second address of the key.
+    bool fin_from_reply;            // Direction of the first FIN.
+};
+
+struct alignas(RTE_CACHE_LINE_SIZE) conntrack_shard {
+    rte_hash *table;
+    rte_rcu_qsbr *qsbr;
+    conntrack_entry *entries;
+    uint32_t wheel[wheel_slots];
+    uint32_t current_slot;
+    uint32_t pending;               // Entries of a due slot which are not checked yet.
+    uint64_t next_tick_tsc;
+
+    // Written only by the lcore of the shard, read by the telemetry thread.
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> inserts;
+    std::atomic<uint64_t> insert_failures;
+    std::atomic<uint64_t> expired;
+    std::atomic<uint64_t> states[conntrack_state_count];
+};
+
+struct conntrack_callback {
+    uint16_t port_id;
+    uint16_t queue_id;
+    const rte_eth_rxtx_callback *callback;
+};
+
+static conntrack_shard *shards[RTE_MAX_LCORE];
+static std::vector<conntrack_callback> callbacks;
+static uint32_t shard_capacity = 0;
+static uint64_t tick_cycles = 0;
+
+// Orders the two endpoints of the key, so that both directions of a connection have the same key. Returns true if
+// the endpoints were swapped.
+static inline bool make_canonical(flow_key &key)
+{
+    const uint64_t src = (static_cast<uint64_t>(key.src_addr) << 16) | key.src_port;
+    const uint64_t dst = (static_cast<uint64_t>(key.dst_addr) << 16) | key.dst_port;
+    if (src <= dst) {
+        return false;
+    }
+    std::swap(key.src_addr, key.dst_addr);
+    std::swap(key.src_port, key.dst_port);
+    return true;
+}
+
+// Returns the TCP flags of a packet, or 0 if the TCP header is truncated or the packet is a non-first fragment, which
+// carries payload where the TCP header would be.
+static inline uint8_t tcp_flags(const rte_mbuf *packet)
+{
+    const rte_ipv4_hdr *ipv4_hdr = rte_pktmbuf_mtod_offset(packet, const rte_ipv4_hdr *, sizeof(rte_ether_hdr));
+    if ((ipv4_hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) != 0) {
+        return 0;
+    }
+    const uint32_t l4_offset = sizeof(rte_ether_hdr) + rte_ipv4_hdr_len(ipv4_hdr);
+    if (packet->data_len < l4_offset + sizeof(rte_tcp_hdr)) {
+        return 0;
+    }
+    return rte_pktmbuf_mtod_offset(packet, const rte_tcp_hdr *, l4_offset)->tcp_flags;
+}
+
+static inline void set_state(conntrack_shard &shard, conntrack_entry &entry, conntrack_state state)
+{
+    std::atomic<uint64_t> &old_count = shard.states[entry.state];
+    old_count.store(old_count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    telemetry_counter_add(shard.states[state], 1);
+    entry.state = state;
+}
+
+// Puts an entry on the slot of the wheel in which it expires. Timeouts longer than the wheel go to the last slot and
+// are checked again there.
+static inline void schedule(conntrack_shard &shard, uint32_t position, uint64_t now)
+{
+    conntrack_entry &entry = shard.entries[position];
+    const uint64_t expiry = entry.last_tsc + conntrack_states[entry.state].timeout_s * rte_get_tsc_hz();
+    const uint64_t ticks = (expiry > now) ? (expiry - now + tick_cycles - 1) / tick_cycles : 0;
+    const uint64_t offset = RTE_MIN(RTE_MAX(ticks, UINT64_C(1)), UINT64_C(wheel_slots - 1));
+    const uint32_t slot = (shard.current_slot + offset) % wheel_slots;
+    entry.next = shard.wheel[slot];
+    shard.wheel[slot] = position;
+}
+
+// Advances the wheel by at most one slot and checks up to expire_budget entries of the due slots.
+static void expire_entries(conntrack_shard &shard, uint64_t now)
+{
+    if (shard.pending == no_entry && now >= shard.next_tick_tsc) {
+        shard.pending = shard.wheel[shard.current_slot];
+        shard.wheel[shard.current_slot] = no_entry;
+        shard.current_slot = (shard.current_slot + 1) % wheel_slots;
+        shard.next_tick_tsc += tick_cycles;
+    }
+
+    for (uint32_t i = 0; i < expire_budget && shard.pending != no_entry; i++) {
+        const uint32_t position = shard.pending;
+        conntrack_entry &entry = shard.entries[position];
+        shard.pending = entry.next;
+
+        if (now < entry.last_tsc + conntrack_states[entry.state].timeout_s * rte_get_tsc_hz()) {
+            schedule(shard, position, now);
+            continue;
+        }
+
+        // The key slot goes to the RCU defer queue of the table and is reused once no reader can see it any more.
+        void *key = nullptr;
+        if (rte_hash_get_key_with_position(shard.table, position, &key) == 0) {
+            rte_hash_del_key(shard.table, key);
+        }
+        std::atomic<uint64_t> &state_count = shard.states[entry.state];
+        state_count.store(state_count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        entry.in_use = false;
+        telemetry_counter_add(shard.expired, 1);
+    }
+}
+
+// Initial state of a new connection from its first packet.
+static inline conntrack_state initial_state(uint8_t proto, uint8_t flags)
+{
+    if (proto != IPPROTO_TCP) {
+        return unreplied;
+    }
+    if (flags & RTE_TCP_RST_FLAG) {
+        return tcp_close;
+    }
+    return ((flags & (RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG)) == RTE_TCP_SYN_FLAG) ? tcp_syn_sent : tcp_established;
+}
+
+static inline void update_state(conntrack_shard &shard, conntrack_entry &entry, uint8_t proto, uint8_t flags,
+                                bool reply)
+{
+    if (proto != IPPROTO_TCP) {
+        if (reply && entry.state == unreplied) {
+            set_state(shard, entry, replied);
+        }
+        return;
+    }
+
+    if (flags & RTE_TCP_RST_FLAG) {
+        set_state(shard, entry, tcp_close);
+        return;
+    }
+
+    switch (entry.state) {
+    case tcp_syn_sent:
+        if (reply && (flags & RTE_TCP_SYN_FLAG) && (flags & RTE_TCP_ACK_FLAG)) {
+            set_state(shard, entry, tcp_syn_recv);
+        }
+        break;
+    case tcp_syn_recv:
+        if (!reply && (flags & RTE_TCP_ACK_FLAG)) {
+            set_state(shard, entry, tcp_established);
+        }
+        break;
+    case tcp_established:
+        if (flags & RTE_TCP_FIN_FLAG) {
+            entry.fin_from_reply = reply;
+            set_state(shard, entry, tcp_fin_wait);
+        }
+        break;
+    case tcp_fin_wait:
+        if ((flags & RTE_TCP_FIN_FLAG) && reply != entry.fin_from_reply) {
+            set_state(shard, entry, tcp_time_wait);
+        }
+        break;
+    case tcp_close:
+        // A new SYN on a closed 5-tuple starts a new connection.
+        if ((flags & (RTE_TCP_SYN_FLAG | RTE_TCP_ACK_FLAG)) == RTE_TCP_SYN_FLAG) {
+            entry.swapped ^= reply;
+            set_state(shard, entry, tcp_syn_sent);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static uint16_t track_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                               uint16_t max_packets, void *user_param)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (lcore_id >= RTE_MAX_LCORE || shards[lcore_id] == nullptr) {
+        return count;
+    }
+    conntrack_shard &shard = *shards[lcore_id];
+    const uint64_t now = rte_rdtsc();
+
+    for (uint16_t first = 0; first < count; first += max_track_burst) {
+        const uint16_t chunk = RTE_MIN(static_cast<uint16_t>(count - first), max_track_burst);
+        flow_key keys[max_track_burst];
+        const void *key_pointers[max_track_burst];
+        bool swapped[max_track_burst];
+        rte_mbuf *tracked[max_track_burst];
+        int32_t positions[max_track_burst];
+        uint32_t key_count = 0;
+
+        for (uint16_t i = 0; i < chunk; i++) {
+            rte_mbuf *packet = packets[first + i];
+            if (!flow_key_extract(packet, keys[key_count])) {
+                continue;
+            }
+            swapped[key_count] = make_canonical(keys[key_count]);
+            key_pointers[key_count] = &keys[key_count];
+            tracked[key_count++] = packet;
+        }
+        if (key_count == 0) {
+            continue;
+        }
+
+        rte_hash_lookup_bulk(shard.table, key_pointers, key_count, positions);
+
+        for (uint32_t i = 0; i < key_count; i++) {
+            const uint8_t proto = keys[i].proto;
+            const uint8_t flags = (proto == IPPROTO_TCP) ? tcp_flags(tracked[i]) : 0;
+
+            int32_t position = positions[i];
+            if (position < 0) {
+                // Adding a key which an earlier packet of the burst already added returns the existing position.
+                position = rte_hash_add_key(shard.table, &keys[i]);
+                if (position < 0) {
+                    telemetry_counter_add(shard.insert_failures, 1);
+                    continue;
+                }
+            }
+
+            conntrack_entry &entry = shard.entries[position];
+            if (!entry.in_use) {
+                entry = {};
+                entry.in_use = true;
+                entry.swapped = swapped[i];
+                entry.state = initial_state(proto, flags);
+                entry.last_tsc = now;
+                telemetry_counter_add(shard.states[entry.state], 1);
+                telemetry_counter_add(shard.inserts, 1);
+                schedule(shard, position, now);
+            } else {
+                update_state(shard, entry, proto, flags, swapped[i] != entry.swapped);
+                entry.last_tsc = now;
+            }
+            entry.packets++;
+            entry.bytes += tracked[i]->pkt_len;
+        }
+        telemetry_counter_add(shard.packets, key_count);
+    }
+
+    expire_entries(shard, now);
+    return count;
+}
+
+static int conntrack_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    uint64_t entries = 0;
+    uint64_t capacity = 0;
+    uint64_t packets = 0;
+    uint64_t inserts = 0;
+    uint64_t insert_failures = 0;
+    uint64_t expired = 0;
+    uint64_t states[conntrack_state_count] = {};
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const conntrack_shard *shard = shards[lcore_id];
+        if (shard == nullptr) {
+            continue;
+        }
+        entries += rte_hash_count(shard->table);
+        capacity += shard_capacity;
+        packets += shard->packets.load(std::memory_order_relaxed);
+        inserts += shard->inserts.load(std::memory_order_relaxed);
+        insert_failures += shard->insert_failures.load(std::memory_order_relaxed);
+        expired += shard->expired.load(std::memory_order_relaxed);
+        for (uint32_t i = 0; i < conntrack_state_count; i++) {
+            states[i] += shard->states[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_uint(data, "entries", entries);
+    rte_tel_data_add_dict_uint(data, "capacity", capacity);
+    rte_tel_data_add_dict_uint(data, "packets", packets);
+    rte_tel_data_add_dict_uint(data, "inserts", inserts);
+    rte_tel_data_add_dict_uint(data, "insert_failures", insert_failures);
+    rte_tel_data_add_dict_uint(data, "expired", expired);
+    for (uint32_t i = 0; i < conntrack_state_count; i++) {
+        rte_tel_data_add_dict_uint(data, conntrack_states[i].name, states[i]);
+    }
+    return 0;
+}
+
+static void free_shard(conntrack_shard *shard)
+{
+    if (shard == nullptr) {
+        return;
+    }
+    rte_hash_free(shard->table);
+    rte_free(shard->qsbr);
+    rte_free(shard->entries);
+    rte_free(shard);
+}
+
+// Creates the table, the entry array and the RCU variable of the shard of an lcore. Returns nullptr if any of them
+// cannot be created.
+static conntrack_shard *create_shard(uint32_t lcore_id, uint32_t max_flows)
+{
+    const int32_t socket_id = rte_lcore_to_socket_id(lcore_id);
+    conntrack_shard *shard = static_cast<conntrack_shard *>(rte_zmalloc_socket("conntrack", sizeof(conntrack_shard),
+                                                                               RTE_CACHE_LINE_SIZE, socket_id));
+    if (shard == nullptr) {
+        return nullptr;
+    }
+    for (uint32_t &slot : shard->wheel) {
+        slot = no_entry;
+    }
+    shard->pending = no_entry;
+    shard->next_tick_tsc = rte_rdtsc() + tick_cycles;
+
+    const std::string name = "conntrack_" + std::to_string(lcore_id);
+    rte_hash_parameters params = {};
+    params.name = name.c_str();
+    params.entries = max_flows;
+    params.key_len = sizeof(flow_key);
+    params.hash_func = rte_hash_crc;
+    params.socket_id = socket_id;
+    params.extra_flag = RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF;
+    shard->table = rte_hash_create(&params);
+
+    // Without multi writer support the positions of the table are below `entries`.
+    shard->entries = static_cast<conntrack_entry *>(rte_zmalloc_socket("conntrack_entries",
+                                                                       max_flows * sizeof(conntrack_entry),
+                                                                       RTE_CACHE_LINE_SIZE, socket_id));
+    shard->qsbr = static_cast<rte_rcu_qsbr *>(rte_zmalloc_socket("conntrack_qsbr",
+                                                                  rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE),
+                                                                  RTE_CACHE_LINE_SIZE, socket_id));
+    if (shard->table == nullptr || shard->entries == nullptr || shard->qsbr == nullptr ||
+        rte_rcu_qsbr_init(shard->qsbr, RTE_MAX_LCORE) != 0) {
+        free_shard(shard);
+        return nullptr;
+    }
+
+    rte_hash_rcu_config rcu_config = {};
+    rcu_config.v = shard->qsbr;
+    rcu_config.mode = RTE_HASH_QSBR_MODE_DQ;
+    if (rte_hash_rcu_qsbr_add(shard->table, &rcu_config) != 0) {
+        free_shard(shard);
+        return nullptr;
+    }
+    return shard;
+}
+
+bool conntrack_create(uint32_t max_flows)
+{
+    shard_capacity = max_flows;
+    tick_cycles = rte_get_tsc_hz();
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        shards[lcore_id] = create_shard(lcore_id, max_flows);
+        if (shards[lcore_id] == nullptr) {
+            std::cerr << "Unable to create the connection table of lcore " << lcore_id << ". Error code: " << rte_errno
+                      << std::endl;
+            conntrack_free();
+            return false;
+        }
+    }
+
+    if (rte_telemetry_register_cmd("/app/conntrack", conntrack_command,
+                                   "Returns the connection table occupancy and states. Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/conntrack telemetry command. Ignoring ... " << std::endl;
+    }
+    return true;
+}
+
+bool conntrack_add_port(uint16_t port_id, uint16_t rx_queues)
+{
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        const rte_eth_rxtx_callback *callback = rte_eth_add_rx_callback(port_id, i, track_callback, nullptr);
+        if (callback == nullptr) {
+            std::cerr << "Unable to add the connection tracking callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+        callbacks.push_back({port_id, i, callback});
+    }
+    return true;
+}
+
+void conntrack_print_stats()
+{
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const conntrack_shard *shard = shards[lcore_id];
+        if (shard == nullptr || shard->packets.load() == 0) {
+            continue;
+        }
+
+        std::cout << "Conntrack lcore " << lcore_id << ": entries: " << rte_hash_count(shard->table) << "/"
+                  << shard_capacity << " Packets: " << shard->packets.load() << " Inserts: " << shard->inserts.load()
+                  << " Insert failures: " << shard->insert_failures.load() << " Expired: " << shard->expired.load()
+                  << std::endl << "    ";
+        for (uint32_t i = 0; i < conntrack_state_count; i++) {
+            std::cout << conntrack_states[i].name << ": " << shard->states[i].load() << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void conntrack_free()
+{
+    if (shard_capacity == 0) {
+        return;
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callbacks, they have no state of their own.
+    for (const conntrack_callback &callback : callbacks) {
+        rte_eth_remove_rx_callback(callback.port_id, callback.queue_id, callback.callback);
+    }
+    callbacks.clear();
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        free_shard(shards[lcore_id]);
+        shards[lcore_id] = nullptr;
+    }
+    shard_capacity = 0;
+}
@@ -0,0 +1,61 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Connection tracking. Every IPv4 5-tuple seen on a receive queue becomes a connection entry which follows the TCP
+// handshake and teardown, or pairs the two directions of a UDP (or other protocol) pseudo-session. Both directions of
+// a connection share one entry: the key is the 5-tuple with the lower address and port first. This is the state a
+// stateful firewall or NAT needs.
+//
+// TCP: syn_sent -> syn_recv (SYN ACK from the responder) -> established (ACK from the originator) -> fin_wait (first
+// FIN) -> time_wait (FIN from the other side). RST closes the connection from any state. A TCP packet of an unknown
+// connection which is not a SYN is picked up midstream as established.
+// UDP and other protocols: unreplied -> replied (first packet from the responder).
+//
+// Every lcore has its own shard: an rte_hash table and an entry array, and only that lcore inserts and deletes in it.
+// With connection tracking the ports use a symmetric RSS key, which keeps both directions of a connection on one queue
+// and so on one lcore, so no lock is needed on the data path. The tables are created with lock-free reader concurrency
+// (RTE_HASH_EXTRA_FLAGS_RW_CONCURRENCY_LF) and recycle deleted key slots through an RCU defer queue (rte_rcu_qsbr), so
+// other threads can look up a shard without a lock while it changes. The keys of a burst are looked up with one
+// rte_hash_lookup_bulk() call.
+//
+// Aging uses a timer wheel per shard with 1 second slots. A packet only updates the last seen time of its entry. When
+// the wheel reaches the slot of an entry, the entry is deleted if its state timeout passed, otherwise it moves to the
+// slot of its new expiry. A bounded number of entries is processed per poll, so aging never stalls the receive loop.
+// The stage runs in an RX callback on every receive queue, so every mode gets it.
+
+// Creates the shards of all lcores, each for up to `max_flows` connections. Returns false if a table cannot be
+// created.
+bool conntrack_create(uint32_t max_flows);
+
+// Installs the tracking callback on the first `rx_queues` receive queues of a started port.
+bool conntrack_add_port(uint16_t port_id, uint16_t rx_queues);
+
+// Prints the occupancy, insert failures, expired entries and connection states of all shards.
+void conntrack_print_stats();
+
+// Removes the callbacks and frees the shards. Called when no lcore receives any more. Does nothing if connection
+// tracking was not created.
+void conntrack_free();
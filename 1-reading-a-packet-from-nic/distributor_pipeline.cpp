@@ -0,0 +1,259 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "distributor_pipeline.h"
+
+#include <iostream>
+#include <string>
+#include <rte_cycles.h>
+#include <rte_distributor.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_pause.h>
+
+#include "app_telemetry.h"
+#include "flow_key.h"
+#include "packet_metadata.h"
+#include "pcapng_writer.h"
+#include "reorder_stage.h"
+#include "rx_timestamp.h"
+#include "worker_stats.h"
+
+constexpr uint16_t distributor_rx_burst_size = 32;
+constexpr uint16_t distributor_return_burst_size = 128;
+
+struct distributor_worker_context {
+    rte_distributor *distributor;
+    uint32_t worker_id;
+    uint64_t work_cycles;
+    worker_stats *stats;
+    const volatile sig_atomic_t *exit_indicator;
+};
+
+static int distributor_worker(void *arg)
+{
+    const distributor_worker_context *context = static_cast<const distributor_worker_context *>(arg);
+    worker_stats &stats = *context->stats;
+    rte_mbuf *packets[RTE_DIST_BURST_SIZE];
+    int32_t count = 0;
+
+    const uint64_t start = rte_rdtsc();
+    while (!*context->exit_indicator) {
+        // Returns the packets of the previous burst and asks for new ones. rte_distributor_get_pkt() would do the same
+        // but waits for new packets without looking at `exit_indicator`.
+        rte_distributor_request_pkt(context->distributor, context->worker_id, packets, count);
+        while ((count = rte_distributor_poll_pkt(context->distributor, context->worker_id, packets)) < 0) {
+            app_telemetry_poll(0);
+            if (*context->exit_indicator) {
+                break;
+            }
+            rte_pause();
+        }
+        app_telemetry_poll(RTE_MAX(count, 0));
+
+        if (count > 0) {
+            worker_process_burst(stats, packets, count, context->work_cycles);
+        }
+    }
+
+    // Tells the distributor that this worker stops. Packets which were still in flight for this worker are given to the
+    // other workers.
+    rte_distributor_return_pkt(context->distributor, context->worker_id, packets, RTE_MAX(count, 0));
+    stats.total_cycles = rte_rdtsc() - start;
+
+    return 0;
+}
+
+static bool workers_running()
+{
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        if (rte_eal_get_lcore_state(lcore_id) == RUNNING) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct distributor_output_state {
+    distributor_output output;
+    uint16_t tx_port;
+    reorder_stage *reorder;
+    pcapng_writer *capture;
+
+    uint64_t output_packets;
+    uint64_t tx_dropped;
+};
+
+static void output_packets(distributor_output_state &state, rte_mbuf **packets, uint16_t count)
+{
+    state.output_packets += count;
+
+    switch (state.output) {
+    case distributor_output::free:
+        break;
+    case distributor_output::forward: {
+        const uint16_t sent = rte_eth_tx_burst(state.tx_port, 0, packets, count);
+        packets += sent;
+        count -= sent;
+        state.tx_dropped += count;
+        app_telemetry_queue_drop(count);
+        break;
+    }
+    case distributor_output::capture:
+        for (uint16_t i = 0; i < count; i++) {
+            pcapng_write_packet(state.capture, packets[i], pcapng_tsc_to_ns(state.capture, packet_rx_tsc(packets[i])));
+        }
+        break;
+    }
+
+    rte_pktmbuf_free_bulk(packets, count);
+}
+
+// Takes the packets which the workers returned to the distributor and outputs them, in receive order if the reorder
+// stage is enabled. Returns the number of returned packets.
+static uint32_t handle_returned_packets(rte_distributor *distributor, distributor_output_state &state)
+{
+    rte_mbuf *returned[distributor_return_burst_size];
+    const int32_t count = rte_distributor_returned_pkts(distributor, returned, distributor_return_burst_size);
+    if (state.reorder == nullptr) {
+        output_packets(state, returned, count);
+        return count;
+    }
+
+    rte_mbuf *ordered[distributor_rx_burst_size];
+    int32_t inserted = 0;
+    do {
+        inserted += reorder_stage_insert(state.reorder, &returned[inserted], count - inserted);
+        uint16_t drained = 0;
+        while ((drained = reorder_stage_drain(state.reorder, ordered, distributor_rx_burst_size)) > 0) {
+            output_packets(state, ordered, drained);
+        }
+    } while (inserted < count);
+    return count;
+}
+
+bool distributor_loop(uint16_t rx_port, uint16_t tx_port, const distributor_options &options, rx_pipeline &pipeline,
+                      const volatile sig_atomic_t &exit_indicator)
+{
+    const uint32_t workers = rte_lcore_count() - 1;
+    if (workers == 0 || workers > RTE_DISTRIB_MAX_WORKERS) {
+        std::cerr << "Distributor mode needs between 1 and " << RTE_DISTRIB_MAX_WORKERS
+                  << " worker lcores. Pass more lcores with the -l EAL argument." << std::endl;
+        return false;
+    }
+
+    distributor_output_state output = {options.output, tx_port, nullptr, nullptr, 0, 0};
+    if (options.reorder) {
+        output.reorder = reorder_stage_create(options.reorder_buffer_size, rte_socket_id());
+        if (output.reorder == nullptr) {
+            return false;
+        }
+    }
+    if (options.output == distributor_output::capture) {
+        const std::string comment = std::string(options.reorder ? "distributor, reordered" : "distributor") +
+                                    ", RX timestamps: " + rx_timestamp_source_name(rx_port);
+        output.capture = pcapng_open(options.capture_file, comment.c_str(), RTE_MBUF_DEFAULT_DATAROOM);
+        if (output.capture == nullptr) {
+            reorder_stage_free(output.reorder);
+            return false;
+        }
+    }
+
+    // DPDK has no call to free a distributor, so it is created last, when nothing else can fail.
+    rte_distributor *distributor = rte_distributor_create("distributor", rte_socket_id(), workers, RTE_DIST_ALG_BURST);
+    if (distributor == nullptr) {
+        std::cerr << "Unable to create the distributor. Error code: " << rte_errno << std::endl;
+        reorder_stage_free(output.reorder);
+        if (output.capture != nullptr) {
+            pcapng_close(output.capture);
+        }
+        return false;
+    }
+
+    static distributor_worker_context contexts[RTE_MAX_LCORE];
+    uint32_t worker_id = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        contexts[lcore_id] = {distributor, worker_id++, options.work_cycles, &lcore_worker_stats[lcore_id], &exit_indicator};
+        rte_eal_remote_launch(distributor_worker, &contexts[lcore_id], lcore_id);
+    }
+
+    rte_mbuf *packets[distributor_rx_burst_size];
+    uint64_t distributed = 0;
+    uint64_t distributor_cycles = 0;
+
+    std::cout << "Distributing packets received on port Id: " << rx_port << " to " << workers << " workers ... " << std::endl;
+
+    while (!exit_indicator) {
+        const uint16_t rx_packets = rx_pipeline_process(pipeline, packets,
+                                                        rte_eth_rx_burst(rx_port, 0, packets, distributor_rx_burst_size));
+        const uint64_t start_cycles = rte_rdtsc();
+
+        // The distributor uses the `hash.usr` field of the mbuf as flow tag. It shares its memory with the RSS hash.
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            packets[i]->hash.usr = flow_key_packet_hash(packets[i]);
+        }
+        if (output.reorder != nullptr) {
+            reorder_stage_stamp(output.reorder, packets, rx_packets);
+        }
+
+        // rte_distributor_process() is also called without packets: it serves the workers which are waiting for packets
+        // or returning packets.
+        rte_distributor_process(distributor, packets, rx_packets);
+        handle_returned_packets(distributor, output);
+        distributor_cycles += rte_rdtsc() - start_cycles;
+        distributed += rx_packets;
+    }
+
+    // Workers which stop wait until the distributor takes their returned packets, so keep serving them.
+    while (workers_running()) {
+        rte_distributor_process(distributor, nullptr, 0);
+        handle_returned_packets(distributor, output);
+    }
+    rte_eal_mp_wait_lcore();
+    handle_returned_packets(distributor, output);
+    rte_distributor_clear_returns(distributor);
+
+    // No more packets come back, so the packets behind a missing sequence number are output as well.
+    if (output.reorder != nullptr) {
+        rte_mbuf *remaining[distributor_rx_burst_size];
+        uint16_t count = 0;
+        while ((count = reorder_stage_flush(output.reorder, remaining, distributor_rx_burst_size)) > 0) {
+            output_packets(output, remaining, count);
+        }
+        reorder_stage_print_stats(output.reorder);
+        reorder_stage_free(output.reorder);
+    }
+    if (output.capture != nullptr) {
+        pcapng_close(output.capture);
+    }
+
+    rte_eth_stats port_stats = {};
+    rte_eth_stats_get(rx_port, &port_stats);
+    std::cout << "Distributed packets: " << distributed << " RX missed: " << port_stats.imissed
+              << " Distributor cycles per packet: " << (distributed > 0 ? distributor_cycles / distributed : 0)
+              << " Output packets: " << output.output_packets << " TX dropped: " << output.tx_dropped << std::endl;
+    worker_stats_print(lcore_worker_stats, RTE_MAX_LCORE);
+    return true;
+}
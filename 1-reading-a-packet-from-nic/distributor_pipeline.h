@@ -0,0 +1,61 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+
+#include "rx_pipeline.h"
+
+// Distributor mode. The main lcore receives bursts from queue 0 of the RX port and hands them to a packet distributor
+// (rte_distributor). The distributor keeps every flow on the worker which is processing it and gives new flows to the
+// least loaded worker. The workers return the processed packets to the distributor and the main lcore frees,
+// transmits or captures the returned packets in bulk.
+//
+// The workers return the packets in a different order than they were received. The optional reorder stage (see
+// reorder_stage.h) restores the receive order before the packets are transmitted or captured.
+//
+// The distributor is simpler than an event device (see eventdev_pipeline.h): no device and no scheduler service, but
+// all the distribution work runs on the main lcore. The cycles the main lcore spends in the distributor are reported
+// per packet. Compare the worker balance with the RSS mode (see rss_workers.h).
+
+// What the main lcore does with the packets which the workers return.
+enum class distributor_output {
+    free,       // Free the packets.
+    forward,    // Transmit the packets on queue 0 of the TX port.
+    capture     // Write the packets to a pcapng file and free them.
+};
+
+struct distributor_options {
+    uint64_t work_cycles = 0;                               // Emulated processing cycles per packet of the workers.
+    distributor_output output = distributor_output::free;
+    const char *capture_file = "capture.pcapng";            // Capture file of distributor_output::capture.
+    bool reorder = false;                                   // Restore the receive order of the returned packets.
+    uint32_t reorder_buffer_size = 1024;                    // Packets in the reorder buffer. Must be a power of 2.
+};
+
+// Runs the distributor mode until `exit_indicator` is set. The received packets pass `pipeline` on the main lcore before
+// they are distributed. The TX port must have a TX queue if the output is distributor_output::forward. Returns false if
+// the distributor, the reorder stage or the capture file cannot be created.
+bool distributor_loop(uint16_t rx_port, uint16_t tx_port, const distributor_options &options, rx_pipeline &pipeline,
+                      const volatile sig_atomic_t &exit_indicator);
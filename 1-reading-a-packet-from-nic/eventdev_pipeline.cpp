@@ -0,0 +1,237 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "eventdev_pipeline.h"
+
+#include <iostream>
+#include <rte_bus_vdev.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_eventdev.h>
+#include <rte_lcore.h>
+#include <rte_service.h>
+
+#include "app_telemetry.h"
+#include "flow_key.h"
+#include "worker_stats.h"
+
+constexpr uint16_t event_burst_size = 32;
+constexpr uint32_t event_queue_flows = 1024;
+
+struct event_worker_context {
+    uint8_t dev_id;
+    uint8_t port_id;
+    uint64_t work_cycles;
+    worker_stats *stats;
+    const volatile sig_atomic_t *exit_indicator;
+};
+
+static int event_worker(void *arg)
+{
+    const event_worker_context *context = static_cast<const event_worker_context *>(arg);
+    worker_stats &stats = *context->stats;
+    rte_event events[event_burst_size];
+    rte_mbuf *packets[event_burst_size];
+
+    const uint64_t start = rte_rdtsc();
+    while (!*context->exit_indicator) {
+        // The events of the previous dequeue are released implicitly by this dequeue. Only then may the scheduler hand
+        // the next packets of those flows to another worker.
+        const uint16_t count = rte_event_dequeue_burst(context->dev_id, context->port_id, events, event_burst_size, 0);
+        app_telemetry_poll(count);
+        if (count == 0) {
+            continue;
+        }
+
+        for (uint16_t i = 0; i < count; i++) {
+            packets[i] = events[i].mbuf;
+        }
+        worker_process_burst(stats, packets, count, context->work_cycles);
+        rte_pktmbuf_free_bulk(packets, count);
+    }
+    stats.total_cycles = rte_rdtsc() - start;
+
+    return 0;
+}
+
+// Frees the packets which are still in the event device when it is stopped.
+static void free_event_packet(uint8_t dev_id, rte_event event, void *arg)
+{
+    rte_pktmbuf_free(event.mbuf);
+}
+
+// Returns the id of the first event device. Creates the software event device if there is none.
+static int32_t get_event_device()
+{
+    if (rte_event_dev_count() == 0) {
+        std::cout << "No event device found. Creating the software event device event_sw0 ... " << std::endl;
+        if (rte_vdev_init("event_sw0", nullptr) != 0) {
+            std::cerr << "Unable to create event device event_sw0" << std::endl;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Configures the event device with one atomic event queue, one event port per worker and one event port for the RX
+// lcore. Only the worker ports are linked to the queue.
+static bool setup_event_device(uint8_t dev_id, uint8_t workers)
+{
+    rte_event_dev_info info = {};
+    rte_event_dev_info_get(dev_id, &info);
+
+    rte_event_dev_config config = {};
+    config.nb_event_queues = 1;
+    config.nb_event_ports = workers + 1;
+    config.nb_events_limit = info.max_num_events;
+    config.nb_event_queue_flows = event_queue_flows;
+    config.nb_event_port_dequeue_depth = info.max_event_port_dequeue_depth;
+    config.nb_event_port_enqueue_depth = info.max_event_port_enqueue_depth;
+    config.dequeue_timeout_ns = info.min_dequeue_timeout_ns;
+
+    int32_t return_val = rte_event_dev_configure(dev_id, &config);
+    if (return_val != 0) {
+        std::cerr << "Unable to configure event device " << info.driver_name << ". Return code: " << return_val << std::endl;
+        return false;
+    }
+
+    rte_event_queue_conf queue_conf = {};
+    rte_event_queue_default_conf_get(dev_id, 0, &queue_conf);
+    queue_conf.schedule_type = RTE_SCHED_TYPE_ATOMIC;
+    queue_conf.nb_atomic_flows = event_queue_flows;
+    queue_conf.nb_atomic_order_sequences = event_queue_flows;
+    if ((return_val = rte_event_queue_setup(dev_id, 0, &queue_conf)) != 0) {
+        std::cerr << "Unable to setup event queue. Return code: " << return_val << std::endl;
+        return false;
+    }
+
+    for (uint8_t port = 0; port <= workers; port++) {
+        rte_event_port_conf port_conf = {};
+        rte_event_port_default_conf_get(dev_id, port, &port_conf);
+        if ((return_val = rte_event_port_setup(dev_id, port, &port_conf)) != 0) {
+            std::cerr << "Unable to setup event port " << static_cast<uint32_t>(port) << ". Return code: " << return_val << std::endl;
+            return false;
+        }
+
+        const uint8_t queue = 0;
+        if (port < workers && rte_event_port_link(dev_id, port, &queue, nullptr, 1) != 1) {
+            std::cerr << "Unable to link event port " << static_cast<uint32_t>(port) << " to the event queue" << std::endl;
+            return false;
+        }
+    }
+
+    rte_event_dev_stop_flush_callback_register(dev_id, free_event_packet, nullptr);
+
+    std::cout << "Event device " << info.driver_name << " configured with " << static_cast<uint32_t>(workers)
+              << " worker ports" << std::endl;
+    return true;
+}
+
+bool eventdev_loop(uint16_t rx_port, uint64_t work_cycles, rx_pipeline &pipeline,
+                   const volatile sig_atomic_t &exit_indicator)
+{
+    const uint32_t workers = rte_lcore_count() - 1;
+    if (workers == 0 || workers >= RTE_EVENT_MAX_PORTS_PER_DEV) {
+        std::cerr << "Eventdev mode needs between 1 and " << RTE_EVENT_MAX_PORTS_PER_DEV - 1
+                  << " worker lcores. Pass more lcores with the -l EAL argument." << std::endl;
+        return false;
+    }
+
+    const int32_t dev_id = get_event_device();
+    if (dev_id < 0 || !setup_event_device(dev_id, workers)) {
+        return false;
+    }
+
+    // Software event devices schedule the events in a service. No service core is reserved for it, so the RX lcore
+    // runs the scheduler after every burst. Hardware event devices schedule in hardware and have no service.
+    uint32_t service_id = 0;
+    const bool has_service = (rte_event_dev_service_id_get(dev_id, &service_id) == 0);
+    if (has_service) {
+        rte_service_runstate_set(service_id, 1);
+        rte_service_set_runstate_mapped_check(service_id, 0);
+    }
+
+    if (rte_event_dev_start(dev_id) != 0) {
+        std::cerr << "Unable to start event device " << dev_id << std::endl;
+        rte_event_dev_close(dev_id);
+        return false;
+    }
+
+    static event_worker_context contexts[RTE_MAX_LCORE];
+    uint8_t port = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        contexts[lcore_id] = {static_cast<uint8_t>(dev_id), port++, work_cycles, &lcore_worker_stats[lcore_id], &exit_indicator};
+        rte_eal_remote_launch(event_worker, &contexts[lcore_id], lcore_id);
+    }
+
+    // The RX lcore uses the last event port.
+    const uint8_t rx_event_port = workers;
+    rte_mbuf *packets[event_burst_size];
+    rte_event events[event_burst_size];
+    uint64_t injected = 0;
+    uint64_t enqueue_dropped = 0;
+
+    std::cout << "Scheduling packets received on port Id: " << rx_port << " to " << workers << " workers ... " << std::endl;
+
+    while (!exit_indicator) {
+        const uint16_t rx_packets = rx_pipeline_process(pipeline, packets,
+                                                        rte_eth_rx_burst(rx_port, 0, packets, event_burst_size));
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            // The flow id decides the atomic flow.
+            events[i] = {};
+            events[i].flow_id = flow_key_packet_hash(packets[i]) & 0xFFFFF;
+            events[i].op = RTE_EVENT_OP_NEW;
+            events[i].sched_type = RTE_SCHED_TYPE_ATOMIC;
+            events[i].queue_id = 0;
+            events[i].event_type = RTE_EVENT_TYPE_ETHDEV;
+            events[i].priority = RTE_EVENT_DEV_PRIORITY_NORMAL;
+            events[i].mbuf = packets[i];
+        }
+
+        // The device refuses new events when it holds more than the new event threshold of the port. The refused
+        // packets are dropped here, like a full receive ring drops them in the RSS mode.
+        const uint16_t enqueued = rte_event_enqueue_new_burst(dev_id, rx_event_port, events, rx_packets);
+        if (enqueued < rx_packets) {
+            rte_pktmbuf_free_bulk(&packets[enqueued], rx_packets - enqueued);
+            enqueue_dropped += rx_packets - enqueued;
+            app_telemetry_queue_drop(rx_packets - enqueued);
+        }
+        injected += enqueued;
+
+        if (has_service) {
+            rte_service_run_iter_on_app_lcore(service_id, 1);
+        }
+    }
+
+    rte_eal_mp_wait_lcore();
+    rte_event_dev_stop(dev_id);
+    rte_event_dev_close(dev_id);
+
+    rte_eth_stats port_stats = {};
+    rte_eth_stats_get(rx_port, &port_stats);
+    std::cout << "Injected events: " << injected << " Enqueue dropped: " << enqueue_dropped
+              << " RX missed: " << port_stats.imissed << std::endl;
+    worker_stats_print(lcore_worker_stats, RTE_MAX_LCORE);
+    return true;
+}
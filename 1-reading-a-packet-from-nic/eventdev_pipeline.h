@@ -0,0 +1,46 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+
+#include "rx_pipeline.h"
+
+// Eventdev mode. The main lcore receives bursts from queue 0 of the RX port and injects them as events into an event
+// device (rte_eventdev). The worker lcores (-l / --lcores EAL argument) dequeue the events dynamically: a worker which
+// is idle pulls the next event, so a busy worker does not hold back the others.
+//
+// The event queue uses atomic scheduling with the flow hash as flow id. All the packets of a flow are processed by at
+// most one worker at a time, so the order within a flow is kept, while different flows spread over all the workers.
+//
+// If no event device is passed with the --vdev EAL argument, the software event device (event_sw) is created. Its
+// scheduler is a DPDK service which the main lcore runs between the RX bursts.
+//
+// Compare with the RSS mode (see rss_workers.h), where the NIC maps every flow to a fixed worker.
+
+// Runs the eventdev mode until `exit_indicator` is set. Every worker spends `work_cycles` per packet to emulate
+// application processing. The received packets pass `pipeline` on the main lcore before they are injected. Returns
+// false if the event device cannot be set up.
+bool eventdev_loop(uint16_t rx_port, uint64_t work_cycles, rx_pipeline &pipeline,
+                   const volatile sig_atomic_t &exit_indicator);
@@ -0,0 +1,276 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <emmintrin.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_telemetry.h>
+#include <rte_thread.h>
+
+#include "packet_metadata.h"
+#include "pcapng_writer.h"
+
+struct alignas(RTE_CACHE_LINE_SIZE) flight_slot {
+    uint64_t tsc;
+    uint32_t length;        // Length of the packet.
+    uint16_t port;
+    uint16_t captured;      // Bytes in `data`.
+    uint8_t data[flight_recorder_snaplen];
+};
+
+static_assert(sizeof(flight_slot) == 2 * RTE_CACHE_LINE_SIZE, "a flight recorder slot must fill two cache lines");
+
+struct alignas(RTE_CACHE_LINE_SIZE) flight_ring {
+    flight_slot *slots = nullptr;
+    std::atomic<uint64_t> head{0};     // Packets recorded so far. Written by the lcore, read by the dump.
+    std::atomic<uint64_t> reserved{0}; // Packets whose slots the lcore started to write, `head` plus the current burst.
+};
+
+struct flight_callback {
+    uint16_t port_id;
+    uint16_t queue_id;
+    const rte_eth_rxtx_callback *callback;
+};
+
+static flight_ring rings[RTE_MAX_LCORE];
+static uint32_t ring_size = 0;
+static std::string file_prefix;
+static std::vector<flight_callback> callbacks;
+
+static volatile sig_atomic_t dump_requested = 0;
+static std::atomic<bool> thread_stop{false};
+static rte_thread_t dump_thread_id = {};
+static bool thread_started = false;
+static std::mutex dump_mutex;
+static uint32_t dump_count = 0;
+
+// Copies a packet into a slot with non-temporal stores. The copy is rounded up to 16 bytes; the bytes read after the
+// end of a short packet are still inside the data room of its mbuf.
+static inline void record_packet(flight_slot *slot, const rte_mbuf *packet)
+{
+    const uint16_t captured = RTE_MIN(packet->data_len, static_cast<uint16_t>(flight_recorder_snaplen));
+    __m128i *destination = reinterpret_cast<__m128i *>(slot);
+    _mm_stream_si128(destination, _mm_set_epi64x((static_cast<uint64_t>(captured) << 48) |
+                                                 (static_cast<uint64_t>(packet->port) << 32) | packet->pkt_len,
+                                                 packet_rx_tsc(packet)));
+
+    const __m128i *source = rte_pktmbuf_mtod(packet, const __m128i *);
+    for (uint32_t i = 0; i < (captured + 15U) / 16; i++) {
+        _mm_stream_si128(destination + 1 + i, _mm_loadu_si128(source + i));
+    }
+}
+
+static uint16_t record_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                                uint16_t max_packets, void *user_param)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (count == 0 || lcore_id >= RTE_MAX_LCORE) {
+        return count;
+    }
+
+    flight_ring &ring = rings[lcore_id];
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+
+    // The dump must see which slots are being overwritten before any of them changes. Non-temporal stores may pass
+    // earlier stores, so the fence keeps them behind the new reservation.
+    ring.reserved.store(head + count, std::memory_order_relaxed);
+    _mm_sfence();
+    for (uint16_t i = 0; i < count; i++) {
+        record_packet(&ring.slots[head++ & (ring_size - 1)], packets[i]);
+    }
+
+    // Non-temporal stores are weakly ordered, the fence orders them before the new head.
+    _mm_sfence();
+    ring.head.store(head, std::memory_order_release);
+    return count;
+}
+
+// Copies the recorded packets of one lcore. Slots which the lcore overwrote during the copy are left out.
+static void collect_ring(const flight_ring &ring, std::vector<flight_slot> &packets)
+{
+    const uint64_t head = ring.head.load(std::memory_order_acquire);
+    const uint64_t first = (head > ring_size) ? head - ring_size : 0;
+    const size_t start = packets.size();
+    for (uint64_t i = first; i < head; i++) {
+        packets.push_back(ring.slots[i & (ring_size - 1)]);
+    }
+
+    // The lcore may be writing the slots of a whole burst already, up to packet `reserved - 1`. Those slots held the
+    // packets before `reserved - ring_size`.
+    const uint64_t reserved = ring.reserved.load(std::memory_order_acquire);
+    const uint64_t overwritten = (reserved > ring_size) ? reserved - ring_size : 0;
+    if (overwritten > first) {
+        const size_t skip = std::min<uint64_t>(overwritten - first, packets.size() - start);
+        packets.erase(packets.begin() + start, packets.begin() + start + skip);
+    }
+}
+
+// Writes the packets of all lcores to a new pcapng file. Returns the number of packets written, or -1 if the file
+// cannot be created.
+static int64_t dump(std::string &path)
+{
+    const std::lock_guard<std::mutex> lock(dump_mutex);
+
+    std::vector<flight_slot> packets;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        if (rings[lcore_id].slots != nullptr) {
+            collect_ring(rings[lcore_id], packets);
+        }
+    }
+    std::sort(packets.begin(), packets.end(), [](const flight_slot &a, const flight_slot &b) { return a.tsc < b.tsc; });
+
+    path = file_prefix + "-" + std::to_string(++dump_count) + ".pcapng";
+    pcapng_writer *writer = pcapng_open(path.c_str(), "Flight recorder", flight_recorder_snaplen);
+    if (writer == nullptr) {
+        return -1;
+    }
+    for (const flight_slot &packet : packets) {
+        pcapng_write_data(writer, packet.data, packet.captured, packet.length, pcapng_tsc_to_ns(writer, packet.tsc));
+    }
+    pcapng_close(writer);
+    return packets.size();
+}
+
+static void dump_and_report()
+{
+    std::string path;
+    const int64_t packets = dump(path);
+    if (packets < 0) {
+        std::cerr << "Unable to create flight recorder file: " << path << std::endl;
+    } else {
+        std::cout << "Flight recorder: " << packets << " packets written to " << path << std::endl;
+    }
+}
+
+static uint32_t dump_thread(void *arg)
+{
+    while (!thread_stop.load(std::memory_order_relaxed)) {
+        if (dump_requested) {
+            dump_requested = 0;
+            dump_and_report();
+        }
+        rte_delay_us_sleep(100 * 1000);
+    }
+    return 0;
+}
+
+static int dump_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    std::string path;
+    const int64_t packets = dump(path);
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_string(data, "file", path.c_str());
+    rte_tel_data_add_dict_int(data, "packets", packets);
+    return 0;
+}
+
+bool flight_recorder_create(uint32_t packets, const char *dump_prefix)
+{
+    ring_size = packets;
+    file_prefix = dump_prefix;
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rings[lcore_id].slots = static_cast<flight_slot *>(rte_zmalloc_socket("flight_recorder", packets * sizeof(flight_slot),
+                                                                              RTE_CACHE_LINE_SIZE, rte_lcore_to_socket_id(lcore_id)));
+        if (rings[lcore_id].slots == nullptr) {
+            std::cerr << "Unable to allocate the flight recorder buffer of lcore " << lcore_id << std::endl;
+            flight_recorder_free();
+            return false;
+        }
+    }
+
+    if (rte_thread_create_control(&dump_thread_id, "flight-rec", dump_thread, nullptr) != 0) {
+        std::cerr << "Unable to start the flight recorder thread" << std::endl;
+        flight_recorder_free();
+        return false;
+    }
+    thread_started = true;
+
+    if (rte_telemetry_register_cmd("/app/flight_dump", dump_command,
+                                   "Writes the flight recorder buffers to a pcapng file. Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/flight_dump telemetry command. Ignoring ... " << std::endl;
+    }
+
+    std::cout << "Flight recorder: last " << packets << " packets per lcore, send SIGUSR1 to dump them to "
+              << file_prefix << "-N.pcapng" << std::endl;
+    return true;
+}
+
+bool flight_recorder_add_port(uint16_t port_id, uint16_t rx_queues)
+{
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        const rte_eth_rxtx_callback *callback = rte_eth_add_rx_callback(port_id, i, record_callback, nullptr);
+        if (callback == nullptr) {
+            std::cerr << "Unable to add the flight recorder callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+        callbacks.push_back({port_id, i, callback});
+    }
+    return true;
+}
+
+void flight_recorder_trigger()
+{
+    dump_requested = 1;
+}
+
+void flight_recorder_free()
+{
+    if (ring_size == 0) {
+        return;
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callbacks, they have no state of their own.
+    for (const flight_callback &callback : callbacks) {
+        rte_eth_remove_rx_callback(callback.port_id, callback.queue_id, callback.callback);
+    }
+    callbacks.clear();
+
+    if (thread_started) {
+        thread_stop.store(true, std::memory_order_relaxed);
+        rte_thread_join(dump_thread_id, nullptr);
+        thread_started = false;
+    }
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rte_free(rings[lcore_id].slots);
+        rings[lcore_id].slots = nullptr;
+    }
+    ring_size = 0;
+}
@@ -0,0 +1,52 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Flight recorder. Every lcore keeps the last N packets it received in its own circular buffer in hugepage memory, so
+// the packets from just before an incident can be looked at without running a full capture. On SIGUSR1 or the
+// /app/flight_dump telemetry command the buffers of all lcores are written to a pcapng file, sorted by the RX TSC.
+//
+// The packets are recorded in an RX callback on every receive queue, so every mode records without changes to its
+// receive loop. Only the first flight_recorder_snaplen bytes of a packet are kept (the headers), which together with
+// the RX TSC and the length fill two cache lines. The slots are written with non-temporal stores: the buffer is only
+// read when it is dumped, so it would only evict the packets and the data of the poll loop from the cache. One store
+// fence per burst makes the slots visible to the dump.
+
+constexpr uint32_t flight_recorder_snaplen = 112;
+
+// Allocates a buffer of `packets` slots (a power of 2) for every lcore and starts the dump thread. Dump files are
+// named `<dump_prefix>-<N>.pcapng`. Returns false if the memory or the thread cannot be allocated.
+bool flight_recorder_create(uint32_t packets, const char *dump_prefix);
+
+// Installs the recording callback on the first `rx_queues` receive queues of a started port. Called after
+// rx_timestamp_start(), so the recorded packets have their RX timestamp.
+bool flight_recorder_add_port(uint16_t port_id, uint16_t rx_queues);
+
+// Requests a dump. Async signal safe, called from the SIGUSR1 handler. The dump thread writes the file.
+void flight_recorder_trigger();
+
+// Removes the callbacks, stops the dump thread and frees the buffers. Called when no lcore receives any more. Does
+// nothing if the flight recorder was not created.
+void flight_recorder_free();
@@ -0,0 +1,259 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "flow_cardinality.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_telemetry.h>
+#include <rte_thread.h>
+
+#include "flow_key.h"
+
+constexpr uint32_t register_bits = 11;
+constexpr uint32_t register_count = 1U << register_bits;
+
+// Time the reporter waits after switching the sets, so that the lcores finish the burst they were counting into the
+// previous set. A burst takes microseconds.
+constexpr uint32_t switch_grace_us = 10 * 1000;
+
+struct hyperloglog {
+    uint8_t registers[register_count];
+};
+
+// The two sets of sketches of an lcore.
+struct cardinality_lcore {
+    hyperloglog flows[2];
+    hyperloglog sources[2];
+};
+
+struct cardinality_callback {
+    uint16_t port_id;
+    uint16_t queue_id;
+    const rte_eth_rxtx_callback *callback;
+};
+
+static cardinality_lcore *lcores[RTE_MAX_LCORE];
+static std::vector<cardinality_callback> callbacks;
+static std::atomic<uint32_t> active_set{0};
+static uint32_t report_interval_s = 0;
+static rte_thread_t reporter_thread_id = {};
+static bool thread_started = false;
+static std::atomic<bool> thread_stop{false};
+
+// Estimates of the last complete interval, read by the telemetry command.
+static std::atomic<uint64_t> last_flows{0};
+static std::atomic<uint64_t> last_sources{0};
+
+// Adds an item with a 64 bit hash: the first register_bits select the register, the register keeps the position of
+// the first 1 bit in the rest.
+static inline void hyperloglog_add(hyperloglog &sketch, uint64_t hash)
+{
+    const uint32_t index = hash >> (64 - register_bits);
+    const uint64_t rest = (hash << register_bits) | (UINT64_C(1) << (register_bits - 1));
+    const uint8_t rank = __builtin_clzll(rest) + 1;
+    sketch.registers[index] = RTE_MAX(sketch.registers[index], rank);
+}
+
+static double hyperloglog_estimate(const hyperloglog &sketch)
+{
+    double sum = 0;
+    uint32_t zeros = 0;
+    for (uint8_t value : sketch.registers) {
+        sum += std::ldexp(1.0, -value);
+        zeros += (value == 0);
+    }
+
+    const double m = register_count;
+    const double estimate = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+    // Small cardinalities leave registers empty, linear counting is more accurate there.
+    if (estimate <= 2.5 * m && zeros != 0) {
+        return m * std::log(m / zeros);
+    }
+    return estimate;
+}
+
+static uint16_t count_distinct(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                                     uint16_t max_packets, void *user_param)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (lcore_id >= RTE_MAX_LCORE || lcores[lcore_id] == nullptr) {
+        return count;
+    }
+
+    const uint32_t set = active_set.load(std::memory_order_acquire);
+    hyperloglog &flows = lcores[lcore_id]->flows[set];
+    hyperloglog &sources = lcores[lcore_id]->sources[set];
+    for (uint16_t i = 0; i < count; i++) {
+        flow_key key;
+        if (!flow_key_extract(packets[i], key)) {
+            continue;
+        }
+
+        // The register index and the rank need 64 independent bits. Two seeded CRC32 are not independent (see
+        // flow_key_hash()), so the hashes come from the 64 bit mixer.
+        hyperloglog_add(flows, flow_key_hash64(key));
+        hyperloglog_add(sources, hash_mix64(key.src_addr));
+    }
+    return count;
+}
+
+// Switches the lcores to the other set and returns the estimates of the previous set of all lcores.
+static void finish_interval(uint64_t &flows, uint64_t &sources)
+{
+    const uint32_t previous = active_set.load(std::memory_order_relaxed);
+    active_set.store(previous ^ 1, std::memory_order_release);
+    rte_delay_us_sleep(switch_grace_us);
+
+    hyperloglog merged_flows = {};
+    hyperloglog merged_sources = {};
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        cardinality_lcore *lcore = lcores[lcore_id];
+        if (lcore == nullptr) {
+            continue;
+        }
+        for (uint32_t i = 0; i < register_count; i++) {
+            merged_flows.registers[i] = RTE_MAX(merged_flows.registers[i], lcore->flows[previous].registers[i]);
+            merged_sources.registers[i] = RTE_MAX(merged_sources.registers[i], lcore->sources[previous].registers[i]);
+        }
+        memset(&lcore->flows[previous], 0, sizeof(hyperloglog));
+        memset(&lcore->sources[previous], 0, sizeof(hyperloglog));
+    }
+
+    flows = std::llround(hyperloglog_estimate(merged_flows));
+    sources = std::llround(hyperloglog_estimate(merged_sources));
+}
+
+static uint32_t reporter_thread(void *arg)
+{
+    const uint64_t interval_cycles = report_interval_s * rte_get_timer_hz();
+    uint64_t next_report = rte_get_timer_cycles() + interval_cycles;
+
+    // Sleeping in short steps bounds how long flow_cardinality_free() waits for the thread.
+    while (!thread_stop.load(std::memory_order_relaxed)) {
+        rte_delay_us_sleep(100 * 1000);
+        if (rte_get_timer_cycles() < next_report) {
+            continue;
+        }
+
+        uint64_t flows = 0;
+        uint64_t sources = 0;
+        finish_interval(flows, sources);
+        last_flows.store(flows, std::memory_order_relaxed);
+        last_sources.store(sources, std::memory_order_relaxed);
+        std::cout << "Distinct flows: " << flows << " Distinct sources: " << sources << " (last " << report_interval_s
+                  << " s)" << std::endl;
+        next_report += interval_cycles;
+    }
+    return 0;
+}
+
+static int cardinality_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_uint(data, "interval_s", report_interval_s);
+    rte_tel_data_add_dict_uint(data, "distinct_flows", last_flows.load(std::memory_order_relaxed));
+    rte_tel_data_add_dict_uint(data, "distinct_sources", last_sources.load(std::memory_order_relaxed));
+    return 0;
+}
+
+bool flow_cardinality_create(uint32_t interval_s)
+{
+    report_interval_s = interval_s;
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        lcores[lcore_id] = static_cast<cardinality_lcore *>(rte_zmalloc_socket("flow_cardinality",
+                                                                               sizeof(cardinality_lcore),
+                                                                               RTE_CACHE_LINE_SIZE,
+                                                                               rte_lcore_to_socket_id(lcore_id)));
+        if (lcores[lcore_id] == nullptr) {
+            std::cerr << "Unable to allocate the HyperLogLog sketches of lcore " << lcore_id << std::endl;
+            flow_cardinality_free();
+            return false;
+        }
+    }
+
+    if (rte_thread_create_control(&reporter_thread_id, "cardinality", reporter_thread, nullptr) != 0) {
+        std::cerr << "Unable to start the cardinality thread" << std::endl;
+        flow_cardinality_free();
+        return false;
+    }
+    thread_started = true;
+
+    if (rte_telemetry_register_cmd("/app/cardinality", cardinality_command,
+                                   "Returns the distinct flows and sources of the last interval. "
+                                   "Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/cardinality telemetry command. Ignoring ... " << std::endl;
+    }
+    return true;
+}
+
+bool flow_cardinality_add_port(uint16_t port_id, uint16_t rx_queues)
+{
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        const rte_eth_rxtx_callback *callback = rte_eth_add_rx_callback(port_id, i, count_distinct, nullptr);
+        if (callback == nullptr) {
+            std::cerr << "Unable to add the cardinality callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+        callbacks.push_back({port_id, i, callback});
+    }
+    return true;
+}
+
+void flow_cardinality_free()
+{
+    if (report_interval_s == 0) {
+        return;
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callbacks, they have no state of their own.
+    for (const cardinality_callback &callback : callbacks) {
+        rte_eth_remove_rx_callback(callback.port_id, callback.queue_id, callback.callback);
+    }
+    callbacks.clear();
+
+    if (thread_started) {
+        thread_stop.store(true, std::memory_order_relaxed);
+        rte_thread_join(reporter_thread_id, nullptr);
+        thread_started = false;
+    }
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rte_free(lcores[lcore_id]);
+        lcores[lcore_id] = nullptr;
+    }
+    report_interval_s = 0;
+}
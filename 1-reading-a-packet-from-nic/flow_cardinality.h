@@ -0,0 +1,46 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Distinct flow and distinct source counting with HyperLogLog. Counting the distinct 5-tuples and source addresses
+// exactly needs a hash table entry per flow. A HyperLogLog sketch estimates them in fixed memory instead: the hash of
+// every item selects one of 2048 registers, and the register keeps the highest number of leading zero bits seen in the
+// rest of the hash. The estimate has a standard error of 1.04 / sqrt(2048), about 2.3%.
+//
+// Every lcore has one sketch for the 5-tuples and one for the source addresses, 2KB each, and two sets of them: the
+// lcores write one set while the reporter thread reads the other. At the end of an interval the reporter switches the
+// lcores to the other set, merges the previous set of all lcores (the maximum of every register) and clears it. The
+// sketches are updated in an RX callback on every receive queue, so every mode gets them.
+
+// Allocates the sketches and starts the reporter thread, which prints the distinct flows and sources every
+// `interval_s` seconds. Returns false if the memory or the thread cannot be allocated.
+bool flow_cardinality_create(uint32_t interval_s);
+
+// Installs the callback on the first `rx_queues` receive queues of a started port.
+bool flow_cardinality_add_port(uint16_t port_id, uint16_t rx_queues);
+
+// Removes the callbacks, stops the reporter thread and frees the sketches. Called when no lcore receives any more. Does
+// nothing if the counting was not created.
+void flow_cardinality_free();
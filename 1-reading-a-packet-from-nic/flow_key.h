@@ -0,0 +1,122 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <rte_ether.h>
+#include <rte_hash_crc.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+
+#include "packet_metadata.h"
+
+// The 5-tuple of an IPv4 packet. All fields are in network byte order. Packets without ports (e.g. ICMP) and IPv4
+// fragments have port 0. Only the first fragment carries the ports, so all fragments of a datagram use the 3-tuple and
+// hash the same.
+struct flow_key {
+    uint32_t src_addr;
+    uint32_t dst_addr;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t proto;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(flow_key) == 16, "flow_key must stay 16 bytes so it can be hashed and compared as one vector");
+
+// Extracts the 5-tuple of an IPv4 packet. Returns false for non IPv4 packets and for truncated headers.
+static inline bool flow_key_extract(const rte_mbuf *packet, flow_key &key)
+{
+    const rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packet, const rte_ether_hdr *);
+    if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+        packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr)) {
+        return false;
+    }
+
+    const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(eth_hdr + 1);
+    const uint32_t l3_len = rte_ipv4_hdr_len(ipv4_hdr);
+    memset(&key, 0, sizeof(key));
+    key.src_addr = ipv4_hdr->src_addr;
+    key.dst_addr = ipv4_hdr->dst_addr;
+    key.proto = ipv4_hdr->next_proto_id;
+
+    // The source and destination ports are the first 4 bytes of both the TCP and the UDP header.
+    const bool fragment = (ipv4_hdr->fragment_offset &
+                           rte_cpu_to_be_16(RTE_IPV4_HDR_MF_FLAG | RTE_IPV4_HDR_OFFSET_MASK)) != 0;
+    if ((key.proto == IPPROTO_TCP || key.proto == IPPROTO_UDP) && !fragment &&
+        packet->data_len >= sizeof(rte_ether_hdr) + l3_len + 2 * sizeof(uint16_t)) {
+        const uint16_t *ports = reinterpret_cast<const uint16_t *>(reinterpret_cast<const uint8_t *>(ipv4_hdr) + l3_len);
+        key.src_port = ports[0];
+        key.dst_port = ports[1];
+    }
+    return true;
+}
+
+// Hashes the 5-tuple with the CRC32 instruction of SSE4.2 (rte_hash_crc). CRC32 is linear in its seed: the hashes of
+// one key with two seeds differ by the same constant XOR for every key, so a second seed does not give an independent
+// hash. Use flow_key_hash64() when more than one hash of a key is needed.
+static inline uint32_t flow_key_hash(const flow_key &key, uint32_t seed = 0)
+{
+    return rte_hash_crc(&key, sizeof(key), seed);
+}
+
+// The 64 bit finalizer of MurmurHash3 (fmix64). Every input bit changes every output bit with probability about 1/2,
+// so separate bit ranges of the result can be used as independent hashes.
+static inline uint64_t hash_mix64(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+// Hashes the 5-tuple to 64 well mixed bits. Both 8 byte halves of the key go through hash_mix64(), so all 64 bits of
+// the result depend on the whole key.
+static inline uint64_t flow_key_hash64(const flow_key &key)
+{
+    uint64_t words[2];
+    memcpy(words, &key, sizeof(words));
+    return hash_mix64(words[0] ^ hash_mix64(words[1]));
+}
+
+// Returns the flow hash of a packet: the RSS hash of the NIC if it has one, otherwise the hash of the 5-tuple. Non IPv4
+// packets without an RSS hash all hash to 0. The hash is computed once and kept in the flow id of the packet metadata
+// (see packet_metadata.h), later calls read it from there.
+static inline uint32_t flow_key_packet_hash(rte_mbuf *packet)
+{
+    if (packet_has_flow_id(packet)) {
+        return packet_flow_id(packet);
+    }
+
+    uint32_t hash = packet->hash.rss;
+    flow_key key;
+    if (!(packet->ol_flags & RTE_MBUF_F_RX_RSS_HASH)) {
+        hash = flow_key_extract(packet, key) ? flow_key_hash(key) : 0;
+    }
+
+    packet_set_flow_id(packet, hash);
+    return hash;
+}
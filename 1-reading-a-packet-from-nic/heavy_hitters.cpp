@@ -0,0 +1,449 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "heavy_hitters.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <smmintrin.h>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_pause.h>
+#include <rte_telemetry.h>
+#include <rte_thread.h>
+
+#include "flow_key.h"
+
+constexpr uint32_t sketch_rows = 4;
+constexpr uint32_t sketch_width = 2048;
+constexpr uint32_t top_k = 32;
+constexpr uint32_t report_count = 10;
+constexpr uint16_t chunk_size = 64;
+constexpr uint32_t row_index_bits = 11;
+
+static_assert(sketch_width == 1U << row_index_bits, "a row index is one bit range of the flow hash");
+static_assert(sketch_rows * row_index_bits <= 64, "the row indexes must fit in the 64 bit flow hash");
+
+// The counters of all lcores are read by the merge while the lcores write them. A counter read during an update is off
+// by one packet, far below the error of the sketch.
+struct count_min_sketch {
+    uint64_t packets[sketch_rows][sketch_width];
+    uint64_t bytes[sketch_rows][sketch_width];
+};
+
+struct top_entry {
+    flow_key key;
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+// Sketch and Space-Saving table of an lcore. The table is copied by the merge thread, the sequence counter tells it
+// whether the lcore changed the table during the copy (odd while the lcore updates it).
+struct alignas(RTE_CACHE_LINE_SIZE) heavy_lcore {
+    count_min_sketch *sketch = nullptr;
+    std::atomic<uint32_t> sequence{0};
+    uint32_t entries = 0;
+    uint32_t min_index = 0;                 // Entry with the fewest packets, valid when the table is full.
+    alignas(16) uint32_t hashes[top_k];     // table_hash() of every entry, compared 4 at a time.
+    top_entry top[top_k];
+};
+
+struct heavy_callback {
+    uint16_t port_id;
+    uint16_t queue_id;
+    const rte_eth_rxtx_callback *callback;
+};
+
+struct flow_estimate {
+    flow_key key;
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+static heavy_lcore lcores[RTE_MAX_LCORE];
+static std::vector<heavy_callback> callbacks;
+static count_min_sketch *merged = nullptr;
+static std::mutex merge_mutex;
+static uint32_t report_interval_s = 0;
+static rte_thread_t merge_thread_id = {};
+static bool thread_started = false;
+static std::atomic<bool> thread_stop{false};
+
+// Takes the 4 row indexes of a flow from its 64 bit hash: row i uses bits 11 * i to 11 * i + 10.
+static inline void row_indexes(uint64_t hash, uint32_t indexes[sketch_rows])
+{
+    for (uint32_t row = 0; row < sketch_rows; row++) {
+        indexes[row] = (hash >> (row * row_index_bits)) & (sketch_width - 1);
+    }
+}
+
+// The table compares the high 32 bits of the flow hash, which no row index uses in full.
+static inline uint32_t table_hash(uint64_t hash)
+{
+    return static_cast<uint32_t>(hash >> 32);
+}
+
+// Returns the entry of a flow in the table, or -1.
+static inline int32_t find_entry(const heavy_lcore &lcore, const flow_key &key, uint32_t hash)
+{
+    const __m128i needle = _mm_set1_epi32(hash);
+    for (uint32_t i = 0; i < lcore.entries; i += 4) {
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(
+            _mm_cmpeq_epi32(_mm_load_si128(reinterpret_cast<const __m128i *>(&lcore.hashes[i])), needle)));
+        while (mask != 0) {
+            const uint32_t j = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (j < lcore.entries && memcmp(&lcore.top[j].key, &key, sizeof(key)) == 0) {
+                return j;
+            }
+        }
+    }
+    return -1;
+}
+
+// Updates the Space-Saving table with the new estimate of a flow.
+static void update_top(heavy_lcore &lcore, const flow_key &key, uint32_t hash, uint64_t packets, uint64_t bytes)
+{
+    const uint32_t sequence = lcore.sequence.load(std::memory_order_relaxed);
+    lcore.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    int32_t index = find_entry(lcore, key, hash);
+    bool min_changed = (index == static_cast<int32_t>(lcore.min_index));
+    if (index < 0) {
+        // A new flow takes a free entry, or replaces the smallest one.
+        index = (lcore.entries < top_k) ? lcore.entries++ : lcore.min_index;
+        lcore.top[index].key = key;
+        lcore.hashes[index] = hash;
+        min_changed = true;
+    }
+    lcore.top[index].packets = packets;
+    lcore.top[index].bytes = bytes;
+
+    if (min_changed && lcore.entries == top_k) {
+        lcore.min_index = 0;
+        for (uint32_t i = 1; i < top_k; i++) {
+            if (lcore.top[i].packets < lcore.top[lcore.min_index].packets) {
+                lcore.min_index = i;
+            }
+        }
+    }
+
+    lcore.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static inline void count_packet(heavy_lcore &lcore, const flow_key &key, uint32_t hash,
+                                const uint32_t indexes[sketch_rows], uint32_t length)
+{
+    count_min_sketch &sketch = *lcore.sketch;
+    uint64_t packets = UINT64_MAX;
+    uint64_t bytes = UINT64_MAX;
+    for (uint32_t row = 0; row < sketch_rows; row++) {
+        packets = RTE_MIN(packets, ++sketch.packets[row][indexes[row]]);
+        bytes = RTE_MIN(bytes, sketch.bytes[row][indexes[row]] += length);
+    }
+
+    if (lcore.entries == top_k && packets <= lcore.top[lcore.min_index].packets) {
+        return;
+    }
+    update_top(lcore, key, hash, packets, bytes);
+}
+
+static uint16_t count_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                               uint16_t max_packets, void *user_param)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (lcore_id >= RTE_MAX_LCORE || lcores[lcore_id].sketch == nullptr) {
+        return count;
+    }
+
+    heavy_lcore &lcore = lcores[lcore_id];
+    for (uint16_t first = 0; first < count; first += chunk_size) {
+        const uint16_t chunk = RTE_MIN(count - first, chunk_size);
+        flow_key keys[chunk_size];
+        uint32_t lengths[chunk_size];
+        uint16_t flows = 0;
+        for (uint16_t i = 0; i < chunk; i++) {
+            if (flow_key_extract(packets[first + i], keys[flows])) {
+                lengths[flows++] = packets[first + i]->pkt_len;
+            }
+        }
+
+        // The hashes of the burst do not depend on each other, so the multiplications overlap.
+        uint64_t hashes[chunk_size];
+        for (uint16_t i = 0; i < flows; i++) {
+            hashes[i] = flow_key_hash64(keys[i]);
+        }
+
+        for (uint16_t i = 0; i < flows; i++) {
+            uint32_t indexes[sketch_rows];
+            row_indexes(hashes[i], indexes);
+            count_packet(lcore, keys[i], table_hash(hashes[i]), indexes, lengths[i]);
+        }
+    }
+    return count;
+}
+
+// Copies the table of an lcore, retrying while the lcore updates it.
+static uint32_t copy_top(const heavy_lcore &lcore, top_entry top[top_k])
+{
+    while (true) {
+        const uint32_t sequence = lcore.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            rte_pause();
+            continue;
+        }
+
+        const uint32_t entries = RTE_MIN(lcore.entries, top_k);
+        memcpy(top, lcore.top, entries * sizeof(top_entry));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (lcore.sequence.load(std::memory_order_relaxed) == sequence) {
+            return entries;
+        }
+    }
+}
+
+// Adds up the sketches of all lcores and estimates the candidates of all top-K tables in the merged sketch.
+static std::vector<flow_estimate> merge()
+{
+    memset(merged, 0, sizeof(*merged));
+    std::vector<flow_estimate> candidates;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const heavy_lcore &lcore = lcores[lcore_id];
+        if (lcore.sketch == nullptr) {
+            continue;
+        }
+
+        for (uint32_t row = 0; row < sketch_rows; row++) {
+            for (uint32_t i = 0; i < sketch_width; i++) {
+                merged->packets[row][i] += lcore.sketch->packets[row][i];
+                merged->bytes[row][i] += lcore.sketch->bytes[row][i];
+            }
+        }
+
+        top_entry top[top_k];
+        const uint32_t entries = copy_top(lcore, top);
+        for (uint32_t i = 0; i < entries; i++) {
+            const bool known = std::any_of(candidates.begin(), candidates.end(), [&](const flow_estimate &candidate) {
+                return memcmp(&candidate.key, &top[i].key, sizeof(flow_key)) == 0;
+            });
+            if (!known) {
+                candidates.push_back({top[i].key, 0, 0});
+            }
+        }
+    }
+
+    for (flow_estimate &candidate : candidates) {
+        uint32_t indexes[sketch_rows];
+        row_indexes(flow_key_hash64(candidate.key), indexes);
+        candidate.packets = UINT64_MAX;
+        candidate.bytes = UINT64_MAX;
+        for (uint32_t row = 0; row < sketch_rows; row++) {
+            candidate.packets = RTE_MIN(candidate.packets, merged->packets[row][indexes[row]]);
+            candidate.bytes = RTE_MIN(candidate.bytes, merged->bytes[row][indexes[row]]);
+        }
+    }
+    return candidates;
+}
+
+// Sorts the flows by packets or bytes, largest first, and keeps the first report_count.
+static void keep_top(std::vector<flow_estimate> &flows, uint64_t flow_estimate::*field)
+{
+    std::sort(flows.begin(), flows.end(), [field](const flow_estimate &a, const flow_estimate &b) {
+        return a.*field > b.*field;
+    });
+    flows.resize(RTE_MIN(flows.size(), static_cast<size_t>(report_count)));
+}
+
+static std::string format_flow(const flow_key &key)
+{
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(&key.src_addr);
+    const uint8_t *dst = reinterpret_cast<const uint8_t *>(&key.dst_addr);
+    char text[64];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u:%u -> %u.%u.%u.%u:%u proto %u", src[0], src[1], src[2], src[3],
+             rte_be_to_cpu_16(key.src_port), dst[0], dst[1], dst[2], dst[3], rte_be_to_cpu_16(key.dst_port), key.proto);
+    return text;
+}
+
+static void print_top_talkers()
+{
+    const std::lock_guard<std::mutex> lock(merge_mutex);
+    std::vector<flow_estimate> by_packets = merge();
+    std::vector<flow_estimate> by_bytes = by_packets;
+    keep_top(by_packets, &flow_estimate::packets);
+    keep_top(by_bytes, &flow_estimate::bytes);
+
+    std::cout << "Top talkers by packets:" << std::endl;
+    for (const flow_estimate &flow : by_packets) {
+        std::cout << "  " << format_flow(flow.key) << " packets: " << flow.packets << std::endl;
+    }
+    std::cout << "Top talkers by bytes:" << std::endl;
+    for (const flow_estimate &flow : by_bytes) {
+        std::cout << "  " << format_flow(flow.key) << " bytes: " << flow.bytes << std::endl;
+    }
+}
+
+static uint32_t merge_thread(void *arg)
+{
+    const uint64_t interval_cycles = report_interval_s * rte_get_timer_hz();
+    uint64_t next_report = rte_get_timer_cycles() + interval_cycles;
+
+    // Sleeping in short steps bounds how long heavy_hitters_free() waits for the thread.
+    while (!thread_stop.load(std::memory_order_relaxed)) {
+        rte_delay_us_sleep(100 * 1000);
+        if (rte_get_timer_cycles() >= next_report) {
+            print_top_talkers();
+            next_report += interval_cycles;
+        }
+    }
+    return 0;
+}
+
+// Adds a list of flows, largest first, as rank_1, rank_2, ... to `data`.
+static bool add_flows(rte_tel_data *data, const char *name, const std::vector<flow_estimate> &flows)
+{
+    rte_tel_data *list = rte_tel_data_alloc();
+    if (list == nullptr) {
+        return false;
+    }
+
+    rte_tel_data_start_dict(list);
+    for (size_t i = 0; i < flows.size(); i++) {
+        rte_tel_data *flow = rte_tel_data_alloc();
+        if (flow == nullptr) {
+            rte_tel_data_free(list);
+            return false;
+        }
+        rte_tel_data_start_dict(flow);
+        rte_tel_data_add_dict_string(flow, "flow", format_flow(flows[i].key).c_str());
+        rte_tel_data_add_dict_uint(flow, "packets", flows[i].packets);
+        rte_tel_data_add_dict_uint(flow, "bytes", flows[i].bytes);
+        rte_tel_data_add_dict_container(list, ("rank_" + std::to_string(i + 1)).c_str(), flow, 0);
+    }
+    rte_tel_data_add_dict_container(data, name, list, 0);
+    return true;
+}
+
+static int heavy_hitters_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    // The command stays registered after heavy_hitters_free().
+    const std::lock_guard<std::mutex> lock(merge_mutex);
+    if (merged == nullptr) {
+        return -EINVAL;
+    }
+
+    std::vector<flow_estimate> by_packets = merge();
+    std::vector<flow_estimate> by_bytes = by_packets;
+    keep_top(by_packets, &flow_estimate::packets);
+    keep_top(by_bytes, &flow_estimate::bytes);
+
+    rte_tel_data_start_dict(data);
+    return (add_flows(data, "by_packets", by_packets) && add_flows(data, "by_bytes", by_bytes)) ? 0 : -ENOMEM;
+}
+
+bool heavy_hitters_create(uint32_t interval_s)
+{
+    report_interval_s = interval_s;
+    merged = static_cast<count_min_sketch *>(rte_zmalloc("heavy_hitters", sizeof(count_min_sketch), RTE_CACHE_LINE_SIZE));
+    if (merged == nullptr) {
+        std::cerr << "Unable to allocate the heavy hitter sketch" << std::endl;
+        return false;
+    }
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        lcores[lcore_id].sketch = static_cast<count_min_sketch *>(rte_zmalloc_socket("heavy_hitters", sizeof(count_min_sketch),
+                                                                                     RTE_CACHE_LINE_SIZE, rte_lcore_to_socket_id(lcore_id)));
+        if (lcores[lcore_id].sketch == nullptr) {
+            std::cerr << "Unable to allocate the heavy hitter sketch of lcore " << lcore_id << std::endl;
+            heavy_hitters_free();
+            return false;
+        }
+    }
+
+    if (rte_thread_create_control(&merge_thread_id, "heavy-hitters", merge_thread, nullptr) != 0) {
+        std::cerr << "Unable to start the heavy hitter thread" << std::endl;
+        heavy_hitters_free();
+        return false;
+    }
+    thread_started = true;
+
+    if (rte_telemetry_register_cmd("/app/heavy_hitters", heavy_hitters_command,
+                                   "Returns the top talkers by packets and by bytes. Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/heavy_hitters telemetry command. Ignoring ... " << std::endl;
+    }
+    return true;
+}
+
+bool heavy_hitters_add_port(uint16_t port_id, uint16_t rx_queues)
+{
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        const rte_eth_rxtx_callback *callback = rte_eth_add_rx_callback(port_id, i, count_callback, nullptr);
+        if (callback == nullptr) {
+            std::cerr << "Unable to add the heavy hitter callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+        callbacks.push_back({port_id, i, callback});
+    }
+    return true;
+}
+
+void heavy_hitters_free()
+{
+    if (merged == nullptr) {
+        return;
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callbacks, they have no state of their own.
+    for (const heavy_callback &callback : callbacks) {
+        rte_eth_remove_rx_callback(callback.port_id, callback.queue_id, callback.callback);
+    }
+    callbacks.clear();
+
+    if (thread_started) {
+        thread_stop.store(true, std::memory_order_relaxed);
+        rte_thread_join(merge_thread_id, nullptr);
+        thread_started = false;
+        print_top_talkers();
+    }
+
+    const std::lock_guard<std::mutex> lock(merge_mutex);
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rte_free(lcores[lcore_id].sketch);
+        lcores[lcore_id].sketch = nullptr;
+    }
+    rte_free(merged);
+    merged = nullptr;
+}
@@ -0,0 +1,55 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Heavy hitter detection. Exact per flow counters need memory per flow, which an attack with millions of flows
+// exhausts. This stage counts the IPv4 5-tuples of the received packets in fixed memory instead:
+//
+// Count-Min sketch: 4 rows of 2048 counters (packets and bytes). A packet increments one counter per row, chosen by a
+// hash of its 5-tuple. The estimate of a flow is the smallest of its 4 counters: never less than the real count, and
+// more by at most e / 2048 of all packets with probability 1 - e^-4. Every lcore has its own sketch, so there is no
+// sharing between lcores; the sketches are merged by adding them up, which gives the sketch of all traffic.
+//
+// Space-Saving top-K: every lcore keeps the 32 flows with the highest estimates seen so far. A flow replaces the
+// smallest entry when its estimate exceeds it. Only flows with an estimate above the smallest entry look at the table,
+// which most packets of small flows never do.
+//
+// The 5-tuples of a burst are extracted first and then hashed to 64 bits (flow_key_hash64()), so the independent
+// hashes of the burst overlap in the pipeline. The 4 row indexes of a packet are separate 11 bit ranges of its hash,
+// which makes the rows independent. The stage runs in an RX callback on every receive queue, so every mode gets it.
+//
+// A control thread merges the sketches and the top-K tables of all lcores every few seconds and prints the top talkers
+// by packets and by bytes since start. The /app/heavy_hitters telemetry command returns them.
+
+// Allocates the sketches and starts the merge thread, which prints the top talkers every `interval_s` seconds.
+// Returns false if the memory or the thread cannot be allocated.
+bool heavy_hitters_create(uint32_t interval_s);
+
+// Installs the counting callback on the first `rx_queues` receive queues of a started port.
+bool heavy_hitters_add_port(uint16_t port_id, uint16_t rx_queues);
+
+// Removes the callbacks, stops the merge thread, prints the top talkers one last time and frees the sketches. Called
+// when no lcore receives any more. Does nothing if the stage was not created.
+void heavy_hitters_free();
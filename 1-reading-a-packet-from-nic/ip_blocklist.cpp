@@ -0,0 +1,318 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "ip_blocklist.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
+#include <rte_rcu_qsbr.h>
+
+#include "flow_key.h"
+
+constexpr uint16_t max_lookup_burst = 64;
+constexpr uint32_t bits_per_address = 16;
+constexpr uint32_t bits_per_block = 512;
+constexpr uint32_t probe_bits = 7;
+constexpr uint64_t probe_round_constant = 0x9E3779B97F4A7C15ULL;
+
+struct alignas(RTE_CACHE_LINE_SIZE) bloom_block {
+    uint64_t words[bits_per_block / 64];
+};
+
+static_assert(sizeof(bloom_block) == RTE_CACHE_LINE_SIZE, "a Bloom filter block must be one cache line");
+
+// One version of the blocklist. Never changed after it is published, a reload builds a new one.
+struct blocklist_set {
+    bloom_block *blocks;
+    uint32_t block_mask;
+    uint32_t *addresses;        // Sorted, in network byte order.
+    uint32_t address_count;
+};
+
+struct ip_blocklist {
+    int32_t socket_id = 0;
+    std::atomic<blocklist_set *> set{nullptr};
+    rte_rcu_qsbr *qsbr = nullptr;
+    bool reader_online[RTE_MAX_LCORE] = {};
+
+    uint64_t lookup_cycles = 0;
+    uint64_t looked_up_packets = 0;
+    uint64_t filter_hits = 0;
+    uint64_t blocked_packets = 0;
+};
+
+// The hash of an address. Its low bits select the block.
+static inline uint64_t address_hash(uint32_t address)
+{
+    return hash_mix64(address);
+}
+
+// The 7 bit positions of an address inside its block, 9 bits each. The block index and the 63 bits of the positions do
+// not fit in one 64 bit hash, so the positions come from a second round of the mixer, which makes them independent of
+// the block index. Seeded CRCs are not independent of each other (see flow_key_hash()).
+static inline uint64_t probe_positions(uint64_t hash)
+{
+    return hash_mix64(hash + probe_round_constant);
+}
+
+static void free_set(blocklist_set *set)
+{
+    if (set == nullptr) {
+        return;
+    }
+    rte_free(set->blocks);
+    rte_free(set->addresses);
+    rte_free(set);
+}
+
+static bool load_addresses(const char *blocklist_file, std::vector<uint32_t> &addresses)
+{
+    std::ifstream file(blocklist_file);
+    if (!file) {
+        std::cerr << "Unable to open blocklist file: " << blocklist_file << std::endl;
+        return false;
+    }
+
+    std::string text;
+    uint32_t line_number = 0;
+    while (std::getline(file, text)) {
+        line_number++;
+        std::istringstream line(text);
+        std::string address;
+        if (!(line >> address) || address[0] == '#') {
+            continue;
+        }
+
+        uint32_t ip = 0;
+        if (inet_pton(AF_INET, address.c_str(), &ip) != 1) {
+            std::cerr << "Invalid address in blocklist file " << blocklist_file << " line " << line_number << ": "
+                      << text << std::endl;
+            return false;
+        }
+        addresses.push_back(ip);
+    }
+
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+    return true;
+}
+
+// Builds the Bloom filter and the sorted address list from the blocklist file. Returns nullptr if the file is invalid
+// or the memory cannot be allocated.
+static blocklist_set *build_set(const char *blocklist_file, int32_t socket_id)
+{
+    std::vector<uint32_t> addresses;
+    if (!load_addresses(blocklist_file, addresses)) {
+        return nullptr;
+    }
+
+    const uint64_t filter_bits = static_cast<uint64_t>(addresses.size()) * bits_per_address;
+    const uint32_t block_count = rte_align32pow2(RTE_MAX((filter_bits + bits_per_block - 1) / bits_per_block,
+                                                         UINT64_C(1)));
+
+    blocklist_set *set = static_cast<blocklist_set *>(rte_zmalloc_socket("blocklist_set", sizeof(blocklist_set), 0,
+                                                                         socket_id));
+    if (set != nullptr) {
+        set->blocks = static_cast<bloom_block *>(rte_zmalloc_socket("blocklist_filter",
+                                                                    block_count * sizeof(bloom_block),
+                                                                    RTE_CACHE_LINE_SIZE, socket_id));
+        set->addresses = static_cast<uint32_t *>(rte_malloc_socket("blocklist_addresses",
+                                                                   RTE_MAX(addresses.size(), size_t(1)) *
+                                                                   sizeof(uint32_t), 0, socket_id));
+    }
+    if (set == nullptr || set->blocks == nullptr || set->addresses == nullptr) {
+        std::cerr << "Unable to allocate the blocklist of " << addresses.size() << " addresses" << std::endl;
+        free_set(set);
+        return nullptr;
+    }
+
+    set->block_mask = block_count - 1;
+    set->address_count = addresses.size();
+    std::copy(addresses.begin(), addresses.end(), set->addresses);
+
+    for (uint32_t address : addresses) {
+        const uint64_t hash = address_hash(address);
+        bloom_block &block = set->blocks[hash & set->block_mask];
+        const uint64_t positions = probe_positions(hash);
+        for (uint32_t i = 0; i < probe_bits; i++) {
+            const uint32_t bit = (positions >> (9 * i)) & (bits_per_block - 1);
+            block.words[bit / 64] |= UINT64_C(1) << (bit % 64);
+        }
+    }
+    return set;
+}
+
+ip_blocklist *ip_blocklist_create(const char *blocklist_file, int32_t socket_id)
+{
+    ip_blocklist *blocklist = new ip_blocklist();
+    blocklist->socket_id = socket_id;
+
+    const size_t qsbr_size = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+    blocklist->qsbr = static_cast<rte_rcu_qsbr *>(rte_zmalloc_socket("blocklist_qsbr", qsbr_size, RTE_CACHE_LINE_SIZE,
+                                                                      socket_id));
+    if (blocklist->qsbr == nullptr || rte_rcu_qsbr_init(blocklist->qsbr, RTE_MAX_LCORE) != 0) {
+        std::cerr << "Unable to create the RCU variable of the blocklist" << std::endl;
+        ip_blocklist_free(blocklist);
+        return nullptr;
+    }
+
+    blocklist_set *set = build_set(blocklist_file, socket_id);
+    if (set == nullptr) {
+        ip_blocklist_free(blocklist);
+        return nullptr;
+    }
+
+    blocklist->set.store(set);
+    std::cout << "Loaded " << set->address_count << " blocked addresses from " << blocklist_file << ". Bloom filter: "
+              << (set->block_mask + 1) * sizeof(bloom_block) / 1024 << " KB" << std::endl;
+    return blocklist;
+}
+
+void ip_blocklist_free(ip_blocklist *blocklist)
+{
+    if (blocklist == nullptr) {
+        return;
+    }
+    free_set(blocklist->set.load());
+    rte_free(blocklist->qsbr);
+    delete blocklist;
+}
+
+bool ip_blocklist_reload(ip_blocklist *blocklist, const char *blocklist_file)
+{
+    blocklist_set *set = build_set(blocklist_file, blocklist->socket_id);
+    if (set == nullptr) {
+        std::cerr << "Keeping the current blocklist" << std::endl;
+        return false;
+    }
+
+    blocklist_set *old_set = blocklist->set.exchange(set);
+
+    // Every lcore which looked up with the old set reports a quiescent state after its burst. From then on it only
+    // sees the new set.
+    rte_rcu_qsbr_synchronize(blocklist->qsbr, RTE_QSBR_THRID_INVALID);
+
+    free_set(old_set);
+    std::cout << "Reloaded " << set->address_count << " blocked addresses from " << blocklist_file << std::endl;
+    return true;
+}
+
+uint16_t ip_blocklist_lookup_burst(ip_blocklist *blocklist, rte_mbuf **packets, uint16_t count, bool *blocked)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (!blocklist->reader_online[lcore_id]) {
+        rte_rcu_qsbr_thread_register(blocklist->qsbr, lcore_id);
+        rte_rcu_qsbr_thread_online(blocklist->qsbr, lcore_id);
+        blocklist->reader_online[lcore_id] = true;
+    }
+
+    const uint64_t start_cycles = rte_rdtsc();
+    const blocklist_set *set = blocklist->set.load(std::memory_order_acquire);
+    uint16_t blocked_count = 0;
+
+    for (uint16_t first = 0; first < count; first += max_lookup_burst) {
+        const uint16_t chunk = RTE_MIN(static_cast<uint16_t>(count - first), max_lookup_burst);
+        uint32_t addresses[max_lookup_burst];
+        uint64_t hashes[max_lookup_burst];
+        const bloom_block *blocks[max_lookup_burst];
+
+        // First pass: hash the source addresses and prefetch their filter blocks.
+        for (uint16_t i = 0; i < chunk; i++) {
+            rte_mbuf *packet = packets[first + i];
+            blocked[first + i] = false;
+            blocks[i] = nullptr;
+
+            const rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packet, const rte_ether_hdr *);
+            if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+                packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr)) {
+                continue;
+            }
+
+            addresses[i] = reinterpret_cast<const rte_ipv4_hdr *>(eth_hdr + 1)->src_addr;
+            hashes[i] = address_hash(addresses[i]);
+            blocks[i] = &set->blocks[hashes[i] & set->block_mask];
+            rte_prefetch0(blocks[i]);
+        }
+
+        // Second pass: test the bits and confirm the hits in the sorted list.
+        for (uint16_t i = 0; i < chunk; i++) {
+            if (blocks[i] == nullptr) {
+                continue;
+            }
+
+            const uint64_t positions = probe_positions(hashes[i]);
+            uint64_t hit = 1;
+            for (uint32_t j = 0; j < probe_bits; j++) {
+                const uint32_t bit = (positions >> (9 * j)) & (bits_per_block - 1);
+                hit &= blocks[i]->words[bit / 64] >> (bit % 64);
+            }
+            if (!hit) {
+                continue;
+            }
+
+            blocklist->filter_hits++;
+            if (std::binary_search(set->addresses, set->addresses + set->address_count, addresses[i])) {
+                blocked[first + i] = true;
+                blocked_count++;
+            }
+        }
+    }
+
+    // The set is not used after this point, a reload may free it.
+    rte_rcu_qsbr_quiescent(blocklist->qsbr, lcore_id);
+
+    blocklist->lookup_cycles += rte_rdtsc() - start_cycles;
+    blocklist->looked_up_packets += count;
+    blocklist->blocked_packets += blocked_count;
+    return blocked_count;
+}
+
+void ip_blocklist_reader_offline(ip_blocklist *blocklist)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (blocklist->reader_online[lcore_id]) {
+        rte_rcu_qsbr_thread_offline(blocklist->qsbr, lcore_id);
+        rte_rcu_qsbr_thread_unregister(blocklist->qsbr, lcore_id);
+        blocklist->reader_online[lcore_id] = false;
+    }
+}
+
+void ip_blocklist_print_stats(const ip_blocklist *blocklist)
+{
+    const uint64_t packets = blocklist->looked_up_packets;
+    std::cout << "Blocked addresses: " << blocklist->set.load()->address_count << " Looked up packets: " << packets
+              << " Filter hits: " << blocklist->filter_hits << " Blocked packets: " << blocklist->blocked_packets
+              << " False positives: " << blocklist->filter_hits - blocklist->blocked_packets << " Cycles/packet: "
+              << (packets > 0 ? static_cast<double>(blocklist->lookup_cycles) / packets : 0.0) << std::endl;
+}
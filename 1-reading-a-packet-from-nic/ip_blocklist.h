@@ -0,0 +1,65 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mbuf.h>
+
+// Source address blocklist stage. Drops the IPv4 packets whose source address is in a blocklist file, before any other
+// stage looks at them. The blocklist can hold millions of addresses, so the stage first probes a Bloom filter which
+// fits the whole list in 16 bits per address: a 64 byte block (one cache line) is selected by a 64 bit hash of the
+// address and 7 bits within that block by a second round of the hash, so a probe touches a single cache line. Only the addresses the
+// filter reports (the blocked ones and about 0.1% false positives) are confirmed in the sorted list of addresses.
+//
+// A burst is probed in two passes: the first hashes all source addresses and prefetches their blocks, the second tests
+// the bits. The cache misses of the burst overlap instead of being taken one after the other.
+//
+// The blocklist file has one IPv4 address per line. Empty lines and lines starting with '#' are ignored.
+//
+// Reloads build a new filter and list on a control thread and publish them with an atomic pointer swap. The old ones
+// are freed when every lcore which looks up has reported a quiescent state (rte_rcu_qsbr), which it does at the end of
+// every burst, so lookups take no locks and never wait for a reload.
+
+struct ip_blocklist;
+
+// Loads the blocklist file. Returns nullptr and prints the reason if the file is invalid.
+ip_blocklist *ip_blocklist_create(const char *blocklist_file, int32_t socket_id);
+
+void ip_blocklist_free(ip_blocklist *blocklist);
+
+// Loads the blocklist file again and replaces the addresses used by ip_blocklist_lookup_burst(). Waits until no lcore
+// uses the old addresses any more and frees them. Must be called from a control thread, never from an lcore which
+// looks up. Returns false if the file is invalid; the old addresses stay active in that case.
+bool ip_blocklist_reload(ip_blocklist *blocklist, const char *blocklist_file);
+
+// Looks up the source addresses of a burst and sets `blocked[i]` for every blocked packet. Non IPv4 packets are never
+// blocked. Returns the number of blocked packets. Must be called on every poll, also with `count` 0, because the call
+// reports the quiescent state of the lcore. Only one lcore may look up with a blocklist at a time, the statistics are
+// not shared.
+uint16_t ip_blocklist_lookup_burst(ip_blocklist *blocklist, rte_mbuf **packets, uint16_t count, bool *blocked);
+
+// Called by the lcore which looks up when it stops looking up, so that a reload does not wait for it.
+void ip_blocklist_reader_offline(ip_blocklist *blocklist);
+
+// Prints the number of addresses, the filter hits, the false positives and the lookup cycles per packet.
+void ip_blocklist_print_stats(const ip_blocklist *blocklist);
@@ -0,0 +1,111 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "l2_forward.h"
+
+#include <iostream>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include "app_telemetry.h"
+
+constexpr uint16_t forward_burst_size = 32;
+
+// Frees the packets which the NIC did not accept, like rte_eth_tx_buffer_count_callback(), and also records them as
+// software queue drops (see app_telemetry.h).
+static void tx_drop_callback(rte_mbuf **packets, uint16_t unsent, void *userdata)
+{
+    rte_pktmbuf_free_bulk(packets, unsent);
+    *static_cast<uint64_t *>(userdata) += unsent;
+    app_telemetry_queue_drop(unsent);
+}
+
+void l2_forward_loop(uint16_t rx_port, uint16_t tx_port, const l2_forward_options &options, rx_pipeline &pipeline,
+                     const volatile sig_atomic_t &exit_indicator)
+{
+    // A TX buffer collects packets until `forward_burst_size` packets are buffered and then transmits them with a
+    // single rte_eth_tx_burst() call. Transmitting in bursts amortizes the cost of writing the NIC doorbell register.
+    rte_eth_dev_tx_buffer *tx_buffer = static_cast<rte_eth_dev_tx_buffer *>(
+        rte_zmalloc_socket("tx_buffer", RTE_ETH_TX_BUFFER_SIZE(forward_burst_size), 0, rte_eth_dev_socket_id(tx_port)));
+    if (tx_buffer == nullptr) {
+        std::cerr << "Unable to allocate TX buffer for port Id: " << tx_port << std::endl;
+        return;
+    }
+    rte_eth_tx_buffer_init(tx_buffer, forward_burst_size);
+
+    // Packets which the NIC does not accept are freed by the callback and counted in `tx_dropped`.
+    uint64_t tx_dropped = 0;
+    rte_eth_tx_buffer_set_err_callback(tx_buffer, tx_drop_callback, &tx_dropped);
+
+    rte_ether_addr tx_port_mac = {};
+    rte_eth_macaddr_get(tx_port, &tx_port_mac);
+
+    // rte_eth_recycle_mbufs() moves the memory buffers freed by the TX queue directly into the RX queue ring. This
+    // skips the round trip through the memory pool. Not every driver supports it, so we fall back to the normal path.
+    rte_eth_recycle_rxq_info recycle_rxq_info = {};
+    bool recycle_mbufs = options.recycle_mbufs;
+    if (recycle_mbufs && rte_eth_recycle_rx_queue_info_get(rx_port, 0, &recycle_rxq_info) != 0) {
+        std::cout << "Warning: Port Id: " << rx_port << " does not support mbuf recycling. Ignoring ... " << std::endl;
+        recycle_mbufs = false;
+    }
+
+    const uint64_t flush_timeout_cycles = rte_get_tsc_hz() * options.flush_timeout_us / 1000000;
+    uint64_t last_flush_cycles = rte_rdtsc();
+    uint64_t forwarded_packets = 0;
+    rte_mbuf *packets[forward_burst_size];
+
+    std::cout << "Forwarding packets from port Id: " << rx_port << " to port Id: " << tx_port << " ... " << std::endl;
+
+    while (!exit_indicator) {
+        if (recycle_mbufs) {
+            rte_eth_recycle_mbufs(rx_port, 0, tx_port, 0, &recycle_rxq_info);
+        }
+
+        const uint16_t rx_packets = rx_pipeline_process(pipeline, packets,
+                                                        rte_eth_rx_burst(rx_port, 0, packets, forward_burst_size));
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            if (options.rewrite_mac) {
+                rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packets[i], rte_ether_hdr *);
+                rte_ether_addr_copy(&options.dst_mac, &eth_hdr->dst_addr);
+                rte_ether_addr_copy(&tx_port_mac, &eth_hdr->src_addr);
+            }
+            rte_eth_tx_buffer(tx_port, 0, tx_buffer, packets[i]);
+        }
+        forwarded_packets += rx_packets;
+
+        // A partially filled TX buffer is flushed after the timeout so that packets are not held back when the
+        // traffic rate is low.
+        const uint64_t now_cycles = rte_rdtsc();
+        if (now_cycles - last_flush_cycles > flush_timeout_cycles) {
+            rte_eth_tx_buffer_flush(tx_port, 0, tx_buffer);
+            last_flush_cycles = now_cycles;
+        }
+    }
+
+    rte_eth_tx_buffer_flush(tx_port, 0, tx_buffer);
+    rte_free(tx_buffer);
+
+    std::cout << "Forwarded packets: " << forwarded_packets - tx_dropped << " TX dropped: " << tx_dropped << std::endl;
+}
@@ -0,0 +1,43 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <rte_ether.h>
+
+#include "rx_pipeline.h"
+
+// Options of the L2 forwarding mode. In this mode every packet received on the RX port is transmitted on the TX port
+// without copying it: the same memory buffer which the NIC wrote on receive is handed to the NIC for transmit.
+struct l2_forward_options {
+    uint64_t flush_timeout_us = 100;    // Buffered packets are transmitted at the latest after this timeout.
+    bool rewrite_mac = false;           // Rewrite source MAC to the TX port MAC and destination MAC to `dst_mac`.
+    rte_ether_addr dst_mac = {};        // Destination MAC used when `rewrite_mac` is set.
+    bool recycle_mbufs = false;         // Move transmitted memory buffers directly back into the RX ring.
+};
+
+// Forwards packets from queue 0 of `rx_port` to queue 0 of `tx_port` until `exit_indicator` is set. Both ports must
+// be configured with at least one RX and one TX queue and started. The received packets pass `pipeline` first.
+void l2_forward_loop(uint16_t rx_port, uint16_t tx_port, const l2_forward_options &options, rx_pipeline &pipeline,
+                     const volatile sig_atomic_t &exit_indicator);
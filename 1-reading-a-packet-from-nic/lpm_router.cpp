@@ -0,0 +1,344 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "lpm_router.h"
+
+#include <arpa/inet.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_ip.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include "app_telemetry.h"
+
+constexpr uint16_t router_burst_size = 32;
+constexpr uint32_t max_next_hops = 256;
+constexpr uint32_t invalid_next_hop = UINT32_MAX;
+
+struct next_hop {
+    bool valid = false;
+    uint16_t port_id = 0;
+    rte_ether_addr dst_mac = {};
+};
+
+struct lpm_router {
+    rte_lpm *lpm = nullptr;
+    rte_lpm6 *lpm6 = nullptr;
+    next_hop next_hops[max_next_hops];
+    rte_ether_addr port_macs[RTE_MAX_ETHPORTS];
+};
+
+struct router_stats {
+    uint64_t routed = 0;
+    uint64_t no_route = 0;
+    uint64_t ttl_exceeded = 0;
+    uint64_t not_ip = 0;
+    uint64_t truncated = 0;
+    uint64_t tx_dropped = 0;
+};
+
+static bool parse_next_hop(lpm_router *router, std::istringstream &line)
+{
+    uint32_t id = 0;
+    uint32_t port_id = 0;
+    std::string mac;
+    if (!(line >> id >> port_id >> mac) || id >= max_next_hops || !rte_eth_dev_is_valid_port(port_id)) {
+        return false;
+    }
+
+    next_hop &hop = router->next_hops[id];
+    if (rte_ether_unformat_addr(mac.c_str(), &hop.dst_mac) != 0) {
+        return false;
+    }
+    hop.port_id = port_id;
+    hop.valid = true;
+    return true;
+}
+
+static bool parse_route(lpm_router *router, std::istringstream &line)
+{
+    std::string prefix;
+    uint32_t next_hop_id = 0;
+    if (!(line >> prefix >> next_hop_id) || next_hop_id >= max_next_hops || !router->next_hops[next_hop_id].valid) {
+        return false;
+    }
+
+    const size_t slash = prefix.find('/');
+    if (slash == std::string::npos) {
+        return false;
+    }
+    const std::string address = prefix.substr(0, slash);
+    const uint32_t depth = strtoul(prefix.c_str() + slash + 1, nullptr, 10);
+
+    if (address.find(':') == std::string::npos) {
+        uint32_t ip = 0;
+        if (depth < 1 || depth > 32 || inet_pton(AF_INET, address.c_str(), &ip) != 1) {
+            return false;
+        }
+        // rte_lpm works with IPv4 addresses in host byte order.
+        return rte_lpm_add(router->lpm, rte_be_to_cpu_32(ip), depth, next_hop_id) == 0;
+    }
+
+    uint8_t ip6[RTE_LPM6_IPV6_ADDR_SIZE];
+    if (depth < 1 || depth > 128 || inet_pton(AF_INET6, address.c_str(), ip6) != 1) {
+        return false;
+    }
+    return rte_lpm6_add(router->lpm6, ip6, depth, next_hop_id) == 0;
+}
+
+lpm_router *lpm_router_create(const lpm_router_options &options, int32_t socket_id)
+{
+    std::ifstream file(options.route_file);
+    if (!file) {
+        std::cerr << "Unable to open route file: " << options.route_file << std::endl;
+        return nullptr;
+    }
+
+    lpm_router *router = static_cast<lpm_router *>(rte_zmalloc_socket("lpm_router", sizeof(lpm_router), RTE_CACHE_LINE_SIZE, socket_id));
+    if (router == nullptr) {
+        std::cerr << "Unable to allocate the router" << std::endl;
+        return nullptr;
+    }
+
+    // The IPv4 table is a DIR-24-8 table: the first 24 bits of the address index a 16M entry table directly and only
+    // routes longer than /24 need a second (tbl8) lookup. So the lookup cost does not depend on the number of routes.
+    rte_lpm_config lpm_config = {};
+    lpm_config.max_rules = options.max_rules;
+    lpm_config.number_tbl8s = options.number_tbl8s;
+    router->lpm = rte_lpm_create("router_lpm", socket_id, &lpm_config);
+
+    rte_lpm6_config lpm6_config = {};
+    lpm6_config.max_rules = options.max_rules;
+    lpm6_config.number_tbl8s = options.number_tbl8s;
+    router->lpm6 = rte_lpm6_create("router_lpm6", socket_id, &lpm6_config);
+
+    if (router->lpm == nullptr || router->lpm6 == nullptr) {
+        std::cerr << "Unable to create the LPM tables. Error code: " << rte_errno << std::endl;
+        lpm_router_free(router);
+        return nullptr;
+    }
+
+    uint16_t port_id = 0;
+    RTE_ETH_FOREACH_DEV(port_id) {
+        rte_eth_macaddr_get(port_id, &router->port_macs[port_id]);
+    }
+
+    std::string text;
+    uint32_t line_number = 0;
+    uint32_t routes = 0;
+    while (std::getline(file, text)) {
+        line_number++;
+        std::istringstream line(text);
+        std::string keyword;
+        if (!(line >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        bool valid = false;
+        if (keyword == "nh") {
+            valid = parse_next_hop(router, line);
+        } else if (keyword == "route") {
+            valid = parse_route(router, line);
+            routes++;
+        }
+
+        if (!valid) {
+            std::cerr << "Invalid entry in route file " << options.route_file << " line " << line_number << ": " << text << std::endl;
+            lpm_router_free(router);
+            return nullptr;
+        }
+    }
+
+    std::cout << "Loaded " << routes << " routes from " << options.route_file << std::endl;
+    return router;
+}
+
+void lpm_router_free(lpm_router *router)
+{
+    if (router == nullptr) {
+        return;
+    }
+    rte_lpm_free(router->lpm);
+    rte_lpm6_free(router->lpm6);
+    rte_free(router);
+}
+
+// Decrements the TTL and updates the header checksum incrementally (RFC 1624). The TTL is the high byte of a 16 bit
+// word, so decrementing it by one decrements the word by 0x0100 and the checksum grows by 0x0100. The ones' complement
+// addition is independent of the byte order, so the value is added in network byte order with the carry folded back.
+static inline void decrement_ttl(rte_ipv4_hdr *ipv4_hdr)
+{
+    ipv4_hdr->time_to_live--;
+    uint32_t checksum = ipv4_hdr->hdr_checksum + rte_cpu_to_be_16(0x0100);
+    ipv4_hdr->hdr_checksum = static_cast<uint16_t>((checksum & 0xffff) + (checksum >> 16));
+}
+
+// Looks up the next hop of every packet of the burst. IPv4 addresses are looked up four at a time with
+// rte_lpm_lookupx4() and IPv6 addresses with one rte_lpm6_lookup_bulk_func() call. Packets which must not be routed
+// get `invalid_next_hop`.
+static void lookup_burst(const lpm_router *router, rte_mbuf **packets, uint16_t count, uint32_t *hops, router_stats &stats)
+{
+    uint32_t ipv4_addresses[router_burst_size + 3];
+    uint16_t ipv4_index[router_burst_size];
+    uint16_t ipv4_count = 0;
+
+    uint8_t ipv6_addresses[router_burst_size][RTE_LPM6_IPV6_ADDR_SIZE];
+    uint16_t ipv6_index[router_burst_size];
+    uint16_t ipv6_count = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        hops[i] = invalid_next_hop;
+        const rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packets[i], const rte_ether_hdr *);
+
+        if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+            if (packets[i]->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr)) {
+                stats.truncated++;
+                continue;
+            }
+            const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(eth_hdr + 1);
+            if (ipv4_hdr->time_to_live <= 1) {
+                stats.ttl_exceeded++;
+                continue;
+            }
+            ipv4_addresses[ipv4_count] = rte_be_to_cpu_32(ipv4_hdr->dst_addr);
+            ipv4_index[ipv4_count++] = i;
+        } else if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6)) {
+            if (packets[i]->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv6_hdr)) {
+                stats.truncated++;
+                continue;
+            }
+            const rte_ipv6_hdr *ipv6_hdr = reinterpret_cast<const rte_ipv6_hdr *>(eth_hdr + 1);
+            if (ipv6_hdr->hop_limits <= 1) {
+                stats.ttl_exceeded++;
+                continue;
+            }
+            memcpy(ipv6_addresses[ipv6_count], ipv6_hdr->dst_addr, RTE_LPM6_IPV6_ADDR_SIZE);
+            ipv6_index[ipv6_count++] = i;
+        } else {
+            stats.not_ip++;
+        }
+    }
+
+    // The last group of four is padded with copies of address 0, the extra results are ignored.
+    for (uint16_t i = ipv4_count; i < RTE_ALIGN_CEIL(ipv4_count, 4); i++) {
+        ipv4_addresses[i] = ipv4_addresses[0];
+    }
+
+    for (uint16_t i = 0; i < ipv4_count; i += 4) {
+        uint32_t group_hops[4];
+        const xmm_t ips = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&ipv4_addresses[i]));
+        rte_lpm_lookupx4(router->lpm, ips, group_hops, invalid_next_hop);
+
+        for (uint16_t j = 0; j < 4 && i + j < ipv4_count; j++) {
+            hops[ipv4_index[i + j]] = group_hops[j];
+            stats.no_route += (group_hops[j] == invalid_next_hop);
+        }
+    }
+
+    if (ipv6_count > 0) {
+        int32_t ipv6_hops[router_burst_size];
+        rte_lpm6_lookup_bulk_func(router->lpm6, ipv6_addresses, ipv6_hops, ipv6_count);
+
+        for (uint16_t i = 0; i < ipv6_count; i++) {
+            hops[ipv6_index[i]] = (ipv6_hops[i] >= 0) ? static_cast<uint32_t>(ipv6_hops[i]) : invalid_next_hop;
+            stats.no_route += (ipv6_hops[i] < 0);
+        }
+    }
+}
+
+void lpm_router_loop(lpm_router *router, const uint16_t *port_ids, uint16_t port_count, rx_pipeline &pipeline,
+                     const volatile sig_atomic_t &exit_indicator)
+{
+    rte_mbuf *packets[router_burst_size];
+    uint32_t hops[router_burst_size];
+
+    // Packets are grouped per egress port so that every port gets a single rte_eth_tx_burst() call per burst.
+    rte_mbuf *tx_packets[RTE_MAX_ETHPORTS][router_burst_size];
+    uint16_t tx_counts[RTE_MAX_ETHPORTS] = {0};
+    uint16_t tx_ports[router_burst_size];
+
+    router_stats stats;
+
+    std::cout << "Routing packets received on " << port_count << " ports ... " << std::endl;
+
+    // Any port can be an ingress port, so one port is polled per iteration, in turn.
+    uint16_t next_port = 0;
+    while (!exit_indicator) {
+        const uint16_t rx_port = port_ids[next_port];
+        next_port = (next_port + 1 == port_count) ? 0 : next_port + 1;
+        const uint16_t rx_packets = rx_pipeline_process(pipeline, packets,
+                                                        rte_eth_rx_burst(rx_port, 0, packets, router_burst_size));
+        if (rx_packets == 0) {
+            continue;
+        }
+
+        lookup_burst(router, packets, rx_packets, hops, stats);
+        uint16_t tx_port_count = 0;
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            if (hops[i] == invalid_next_hop) {
+                rte_pktmbuf_free(packets[i]);
+                continue;
+            }
+
+            const next_hop &hop = router->next_hops[hops[i]];
+            rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packets[i], rte_ether_hdr *);
+
+            if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+                decrement_ttl(reinterpret_cast<rte_ipv4_hdr *>(eth_hdr + 1));
+            } else {
+                reinterpret_cast<rte_ipv6_hdr *>(eth_hdr + 1)->hop_limits--;
+            }
+
+            rte_ether_addr_copy(&hop.dst_mac, &eth_hdr->dst_addr);
+            rte_ether_addr_copy(&router->port_macs[hop.port_id], &eth_hdr->src_addr);
+            if (tx_counts[hop.port_id] == 0) {
+                tx_ports[tx_port_count++] = hop.port_id;
+            }
+            tx_packets[hop.port_id][tx_counts[hop.port_id]++] = packets[i];
+        }
+
+        for (uint16_t j = 0; j < tx_port_count; j++) {
+            const uint16_t port_id = tx_ports[j];
+            const uint16_t count = tx_counts[port_id];
+            const uint16_t sent = rte_eth_tx_burst(port_id, 0, tx_packets[port_id], count);
+            if (sent < count) {
+                rte_pktmbuf_free_bulk(&tx_packets[port_id][sent], count - sent);
+                stats.tx_dropped += count - sent;
+                app_telemetry_queue_drop(count - sent);
+            }
+            stats.routed += sent;
+            tx_counts[port_id] = 0;
+        }
+    }
+
+    std::cout << "Routed packets: " << stats.routed << " No route: " << stats.no_route << " TTL exceeded: "
+              << stats.ttl_exceeded << " Not IP: " << stats.not_ip << " Truncated: " << stats.truncated
+              << " TX dropped: " << stats.tx_dropped << std::endl;
+}
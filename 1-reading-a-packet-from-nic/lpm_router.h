@@ -0,0 +1,57 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+
+#include "rx_pipeline.h"
+
+// Routing mode. The destination address of every received IPv4 / IPv6 packet is looked up in a longest prefix match
+// (LPM) table. The lookup gives a next hop which tells the egress port and the destination MAC address. The packet
+// is then rewritten (MAC addresses, TTL / hop limit) and transmitted on the egress port.
+//
+// The route file has one entry per line. Empty lines and lines starting with '#' are ignored.
+//   nh <next hop id> <egress port id> <destination MAC>     e.g. nh 0 1 DE:AD:BE:EF:AB:12
+//   route <prefix>/<depth> <next hop id>                     e.g. route 10.0.0.0/8 0 or route 2001:db8::/32 0
+// Every next hop must be defined before the routes which use it.
+
+struct lpm_router_options {
+    const char *route_file = nullptr;
+    uint32_t max_rules = 1 << 20;       // Maximum number of routes per address family.
+    uint32_t number_tbl8s = 1 << 16;    // Number of second level tables, used by routes longer than /24 (IPv4).
+};
+
+struct lpm_router;
+
+// Creates the LPM tables and loads the route file. Returns nullptr and prints the reason if the file is invalid or
+// the tables cannot be created.
+lpm_router *lpm_router_create(const lpm_router_options &options, int32_t socket_id);
+
+void lpm_router_free(lpm_router *router);
+
+// Routes the packets received on queue 0 of the `port_count` ports in `port_ids` until `exit_indicator` is set. The
+// ports are polled in turn. Every egress port used by a next hop must be configured with at least one TX queue and
+// started. The received packets pass `pipeline` first.
+void lpm_router_loop(lpm_router *router, const uint16_t *port_ids, uint16_t port_count, rx_pipeline &pipeline,
+                     const volatile sig_atomic_t &exit_indicator);
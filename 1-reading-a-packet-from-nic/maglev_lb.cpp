@@ -0,0 +1,437 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "maglev_lb.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_tcp.h>
+#include <rte_telemetry.h>
+#include <rte_udp.h>
+
+#include "app_telemetry.h"
+#include "checksum_update.h"
+#include "flow_key.h"
+
+constexpr uint16_t lb_burst_size = 32;
+constexpr uint8_t tunnel_ttl = 64;
+
+// A lookup table: the backend address of every slot, in network byte order.
+struct maglev_table {
+    uint32_t *slots;
+    uint32_t backend_count;
+};
+
+struct maglev_lb {
+    lb_options options;
+    const char *backends_file = nullptr;
+    maglev_table tables[2] = {};
+    std::atomic<uint32_t> active{0};
+    rte_rcu_qsbr *qsbr = nullptr;
+};
+
+struct alignas(RTE_CACHE_LINE_SIZE) lb_worker {
+    maglev_lb *lb;
+    uint16_t rx_port;
+    uint16_t tx_port;
+    uint16_t queue_id;
+    rte_ether_addr tx_port_mac;
+    const volatile sig_atomic_t *exit_indicator;
+
+    // Written only by the worker, read by the telemetry thread.
+    std::atomic<uint64_t> balanced;
+    std::atomic<uint64_t> not_vip;          // Non IPv4 packets and packets to other addresses, dropped.
+    std::atomic<uint64_t> no_headroom;      // Packets without room for the outer header, dropped.
+    std::atomic<uint64_t> tx_dropped;
+    uint64_t total_cycles;
+};
+
+static lb_worker workers[RTE_MAX_LCORE];
+
+static bool is_prime(uint32_t value)
+{
+    if (value < 2) {
+        return false;
+    }
+    for (uint32_t divisor = 2; static_cast<uint64_t>(divisor) * divisor <= value; divisor++) {
+        if (value % divisor == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool load_backends(const char *backends_file, std::vector<uint32_t> &backends)
+{
+    std::ifstream file(backends_file);
+    if (!file) {
+        std::cerr << "Unable to open backends file: " << backends_file << std::endl;
+        return false;
+    }
+
+    std::string text;
+    uint32_t line_number = 0;
+    while (std::getline(file, text)) {
+        line_number++;
+        std::istringstream line(text);
+        std::string address;
+        if (!(line >> address) || address[0] == '#') {
+            continue;
+        }
+
+        uint32_t ip = 0;
+        if (inet_pton(AF_INET, address.c_str(), &ip) != 1) {
+            std::cerr << "Invalid address in backends file " << backends_file << " line " << line_number << ": "
+                      << text << std::endl;
+            return false;
+        }
+        backends.push_back(ip);
+    }
+
+    if (backends.empty()) {
+        std::cerr << "No backends in backends file: " << backends_file << std::endl;
+        return false;
+    }
+
+    // A repeated backend would get a second, identical permutation and twice the share of the slots.
+    std::sort(backends.begin(), backends.end());
+    backends.erase(std::unique(backends.begin(), backends.end()), backends.end());
+    return true;
+}
+
+// Fills the table with the Maglev population: every backend has the permutation offset + j * skip (mod size) of the
+// slots, derived from the two halves of a 64 bit hash of its address. The backends take turns to claim the next free slot of their
+// permutation until every slot is claimed.
+static void populate(maglev_table &table, uint32_t size, const std::vector<uint32_t> &backends)
+{
+    const uint32_t count = backends.size();
+    std::vector<uint32_t> offsets(count);
+    std::vector<uint32_t> skips(count);
+    std::vector<uint32_t> next(count, 0);
+    std::vector<bool> claimed(size, false);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint64_t hash = hash_mix64(backends[i]);
+        offsets[i] = static_cast<uint32_t>(hash) % size;
+        skips[i] = static_cast<uint32_t>(hash >> 32) % (size - 1) + 1;
+    }
+
+    uint32_t filled = 0;
+    while (filled < size) {
+        for (uint32_t i = 0; i < count && filled < size; i++) {
+            uint32_t slot = 0;
+            do {
+                slot = (offsets[i] + static_cast<uint64_t>(next[i]++) * skips[i]) % size;
+            } while (claimed[slot]);
+            claimed[slot] = true;
+            table.slots[slot] = backends[i];
+            filled++;
+        }
+    }
+    table.backend_count = count;
+}
+
+// Prints the smallest and the largest share of the slots of a backend.
+static void print_balance(const maglev_table &table, uint32_t size, const std::vector<uint32_t> &backends)
+{
+    uint32_t min_slots = UINT32_MAX;
+    uint32_t max_slots = 0;
+    for (uint32_t backend : backends) {
+        uint32_t slots = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            slots += (table.slots[i] == backend);
+        }
+        min_slots = RTE_MIN(min_slots, slots);
+        max_slots = RTE_MAX(max_slots, slots);
+    }
+    std::cout << "Maglev table: " << size << " slots, " << backends.size() << " backends. Slots per backend: "
+              << min_slots << " - " << max_slots << std::endl;
+}
+
+maglev_lb *maglev_lb_create(const lb_options &options)
+{
+    if (!is_prime(options.table_size)) {
+        std::cerr << "The Maglev table size must be a prime: " << options.table_size << std::endl;
+        return nullptr;
+    }
+
+    std::vector<uint32_t> backends;
+    if (!load_backends(options.backends_file, backends)) {
+        return nullptr;
+    }
+
+    maglev_lb *lb = new maglev_lb();
+    lb->options = options;
+    lb->qsbr = static_cast<rte_rcu_qsbr *>(rte_zmalloc("lb_qsbr", rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE),
+                                                       RTE_CACHE_LINE_SIZE));
+    bool allocated = (lb->qsbr != nullptr && rte_rcu_qsbr_init(lb->qsbr, RTE_MAX_LCORE) == 0);
+    for (maglev_table &table : lb->tables) {
+        table.slots = static_cast<uint32_t *>(rte_malloc("lb_table", options.table_size * sizeof(uint32_t),
+                                                         RTE_CACHE_LINE_SIZE));
+        allocated = allocated && table.slots != nullptr;
+    }
+    if (!allocated) {
+        std::cerr << "Unable to allocate the Maglev tables" << std::endl;
+        maglev_lb_free(lb);
+        return nullptr;
+    }
+
+    populate(lb->tables[0], options.table_size, backends);
+    print_balance(lb->tables[0], options.table_size, backends);
+    return lb;
+}
+
+void maglev_lb_free(maglev_lb *lb)
+{
+    if (lb == nullptr) {
+        return;
+    }
+    for (maglev_table &table : lb->tables) {
+        rte_free(table.slots);
+    }
+    rte_free(lb->qsbr);
+    delete lb;
+}
+
+bool maglev_lb_reload(maglev_lb *lb, const char *backends_file)
+{
+    std::vector<uint32_t> backends;
+    if (!load_backends(backends_file, backends)) {
+        std::cerr << "Keeping the current backends" << std::endl;
+        return false;
+    }
+
+    // The previous reload waited until no worker used the inactive table, so it can be written.
+    const uint32_t inactive = lb->active.load() ^ 1;
+    populate(lb->tables[inactive], lb->options.table_size, backends);
+    lb->active.store(inactive, std::memory_order_release);
+
+    // Every worker which looked up in the old table reports a quiescent state after its burst. From then on it only
+    // sees the new table.
+    rte_rcu_qsbr_synchronize(lb->qsbr, RTE_QSBR_THRID_INVALID);
+
+    std::cout << "Reloaded the backends from " << backends_file << std::endl;
+    print_balance(lb->tables[inactive], lb->options.table_size, backends);
+    return true;
+}
+
+// Moves the Ethernet header to the front of the new headroom and writes an IPv4 header to `backend` in between.
+// Returns false if the packet has no headroom left.
+static inline bool encapsulate(rte_mbuf *packet, uint32_t source, uint32_t backend)
+{
+    const rte_ipv4_hdr *inner = rte_pktmbuf_mtod_offset(packet, const rte_ipv4_hdr *, sizeof(rte_ether_hdr));
+    const uint16_t inner_length = rte_be_to_cpu_16(inner->total_length);
+    const uint8_t tos = inner->type_of_service;
+
+    uint8_t *data = reinterpret_cast<uint8_t *>(rte_pktmbuf_prepend(packet, sizeof(rte_ipv4_hdr)));
+    if (data == nullptr) {
+        return false;
+    }
+    memmove(data, data + sizeof(rte_ipv4_hdr), sizeof(rte_ether_hdr));
+
+    rte_ipv4_hdr *outer = reinterpret_cast<rte_ipv4_hdr *>(data + sizeof(rte_ether_hdr));
+    memset(outer, 0, sizeof(rte_ipv4_hdr));
+    outer->version_ihl = RTE_IPV4_VHL_DEF;
+    outer->type_of_service = tos;
+    outer->total_length = rte_cpu_to_be_16(inner_length + sizeof(rte_ipv4_hdr));
+    outer->time_to_live = tunnel_ttl;
+    outer->next_proto_id = IPPROTO_IPIP;
+    outer->src_addr = source;
+    outer->dst_addr = backend;
+    outer->hdr_checksum = rte_ipv4_cksum(outer);
+    return true;
+}
+
+// Rewrites the destination address to `backend` and patches the IPv4 and the TCP / UDP checksum.
+static inline void rewrite_destination(rte_mbuf *packet, uint32_t backend)
+{
+    rte_ipv4_hdr *ipv4_hdr = rte_pktmbuf_mtod_offset(packet, rte_ipv4_hdr *, sizeof(rte_ether_hdr));
+    const uint32_t l4_offset = sizeof(rte_ether_hdr) + rte_ipv4_hdr_len(ipv4_hdr);
+    const bool first_fragment = (ipv4_hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0;
+
+    uint16_t *l4_checksum = nullptr;
+    if (first_fragment && ipv4_hdr->next_proto_id == IPPROTO_TCP &&
+        packet->data_len >= l4_offset + sizeof(rte_tcp_hdr)) {
+        l4_checksum = &rte_pktmbuf_mtod_offset(packet, rte_tcp_hdr *, l4_offset)->cksum;
+    } else if (first_fragment && ipv4_hdr->next_proto_id == IPPROTO_UDP &&
+               packet->data_len >= l4_offset + sizeof(rte_udp_hdr)) {
+        l4_checksum = &rte_pktmbuf_mtod_offset(packet, rte_udp_hdr *, l4_offset)->dgram_cksum;
+    }
+
+    // The destination address is part of the pseudo header of the L4 checksum. A UDP checksum of 0 means no checksum.
+    if (l4_checksum != nullptr && !(ipv4_hdr->next_proto_id == IPPROTO_UDP && *l4_checksum == 0)) {
+        uint16_t checksum = checksum_replace32(*l4_checksum, ipv4_hdr->dst_addr, backend);
+        if (ipv4_hdr->next_proto_id == IPPROTO_UDP && checksum == 0) {
+            checksum = 0xFFFF;
+        }
+        *l4_checksum = checksum;
+    }
+    ipv4_hdr->hdr_checksum = checksum_replace32(ipv4_hdr->hdr_checksum, ipv4_hdr->dst_addr, backend);
+    ipv4_hdr->dst_addr = backend;
+}
+
+static int lb_worker_loop(void *arg)
+{
+    lb_worker &worker = *static_cast<lb_worker *>(arg);
+    maglev_lb &lb = *worker.lb;
+    const lb_options &options = lb.options;
+    const uint32_t lcore_id = rte_lcore_id();
+    rte_mbuf *packets[lb_burst_size];
+
+    rte_rcu_qsbr_thread_register(lb.qsbr, lcore_id);
+    rte_rcu_qsbr_thread_online(lb.qsbr, lcore_id);
+
+    const uint64_t start = rte_rdtsc();
+    while (!*worker.exit_indicator) {
+        const uint16_t count = rte_eth_rx_burst(worker.rx_port, worker.queue_id, packets, lb_burst_size);
+        app_telemetry_poll(count);
+        if (count == 0) {
+            rte_rcu_qsbr_quiescent(lb.qsbr, lcore_id);
+            continue;
+        }
+
+        const maglev_table &table = lb.tables[lb.active.load(std::memory_order_acquire)];
+        uint16_t kept = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            flow_key key;
+            if (!flow_key_extract(packets[i], key) || key.dst_addr != options.vip) {
+                rte_pktmbuf_free(packets[i]);
+                telemetry_counter_add(worker.not_vip, 1);
+                continue;
+            }
+
+            // Multiply and shift maps the 32 bit hash to a slot without a division.
+            const uint32_t slot = (static_cast<uint64_t>(flow_key_hash(key)) * options.table_size) >> 32;
+            const uint32_t backend = table.slots[slot];
+            if (options.encapsulation == lb_encapsulation::ipip) {
+                if (!encapsulate(packets[i], options.tunnel_source, backend)) {
+                    rte_pktmbuf_free(packets[i]);
+                    telemetry_counter_add(worker.no_headroom, 1);
+                    continue;
+                }
+            } else {
+                rewrite_destination(packets[i], backend);
+            }
+
+            if (options.rewrite_mac) {
+                rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packets[i], rte_ether_hdr *);
+                rte_ether_addr_copy(&options.dst_mac, &eth_hdr->dst_addr);
+                rte_ether_addr_copy(&worker.tx_port_mac, &eth_hdr->src_addr);
+            }
+            packets[kept++] = packets[i];
+        }
+
+        // The table is not used after this point, a reload may write it again after the next switch.
+        rte_rcu_qsbr_quiescent(lb.qsbr, lcore_id);
+        app_telemetry_drop(count - kept);
+        telemetry_counter_add(worker.balanced, kept);
+
+        const uint16_t sent = rte_eth_tx_burst(worker.tx_port, worker.queue_id, packets, kept);
+        if (sent < kept) {
+            rte_pktmbuf_free_bulk(&packets[sent], kept - sent);
+            telemetry_counter_add(worker.tx_dropped, kept - sent);
+            app_telemetry_queue_drop(kept - sent);
+        }
+    }
+    worker.total_cycles = rte_rdtsc() - start;
+
+    // A reload after this point must not wait for this worker.
+    rte_rcu_qsbr_thread_offline(lb.qsbr, lcore_id);
+    rte_rcu_qsbr_thread_unregister(lb.qsbr, lcore_id);
+    return 0;
+}
+
+static int lb_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    uint64_t balanced = 0, not_vip = 0, no_headroom = 0, tx_dropped = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        balanced += workers[lcore_id].balanced.load(std::memory_order_relaxed);
+        not_vip += workers[lcore_id].not_vip.load(std::memory_order_relaxed);
+        no_headroom += workers[lcore_id].no_headroom.load(std::memory_order_relaxed);
+        tx_dropped += workers[lcore_id].tx_dropped.load(std::memory_order_relaxed);
+    }
+
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_uint(data, "balanced", balanced);
+    rte_tel_data_add_dict_uint(data, "not_vip", not_vip);
+    rte_tel_data_add_dict_uint(data, "no_headroom", no_headroom);
+    rte_tel_data_add_dict_uint(data, "tx_dropped", tx_dropped);
+    return 0;
+}
+
+bool maglev_lb_loop(maglev_lb *lb, uint16_t rx_port, uint16_t tx_port, const volatile sig_atomic_t &exit_indicator)
+{
+    const uint32_t worker_count = rte_lcore_count() - 1;
+    if (worker_count == 0) {
+        std::cerr << "Load balancer mode needs at least one worker lcore. Pass more lcores with the -l EAL argument."
+                  << std::endl;
+        return false;
+    }
+
+    if (rte_telemetry_register_cmd("/app/lb", lb_command,
+                                   "Returns the load balancer counters. Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/lb telemetry command. Ignoring ... " << std::endl;
+    }
+
+    rte_ether_addr tx_port_mac = {};
+    rte_eth_macaddr_get(tx_port, &tx_port_mac);
+
+    uint16_t queue_id = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        lb_worker &worker = workers[lcore_id];
+        worker.lb = lb;
+        worker.rx_port = rx_port;
+        worker.tx_port = tx_port;
+        worker.queue_id = queue_id++;
+        worker.tx_port_mac = tx_port_mac;
+        worker.exit_indicator = &exit_indicator;
+        rte_eal_remote_launch(lb_worker_loop, &worker, lcore_id);
+    }
+
+    std::cout << "Balancing packets from port Id: " << rx_port << " to port Id: " << tx_port << " with " << worker_count
+              << " workers (" << (lb->options.encapsulation == lb_encapsulation::ipip ? "IP in IP" : "DNAT") << ") ... "
+              << std::endl;
+    rte_eal_mp_wait_lcore();
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const lb_worker &worker = workers[lcore_id];
+        const double seconds = static_cast<double>(worker.total_cycles) / rte_get_tsc_hz();
+        std::cout << "LB lcore " << lcore_id << ": Balanced: " << worker.balanced.load()
+                  << " Mpps: " << (seconds > 0 ? worker.balanced.load() / seconds / 1e6 : 0.0)
+                  << " Not VIP: " << worker.not_vip.load() << " No headroom: " << worker.no_headroom.load()
+                  << " TX dropped: " << worker.tx_dropped.load() << std::endl;
+    }
+    return true;
+}
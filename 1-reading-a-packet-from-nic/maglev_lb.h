@@ -0,0 +1,80 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <rte_ether.h>
+
+// L4 load balancer mode. Every IPv4 packet to the virtual IP (VIP) goes to one of the backends of a backends file,
+// chosen with Maglev consistent hashing: the hash of the parsed 5-tuple selects a slot of a lookup table, and the slot
+// holds the backend. The table is filled from one permutation of the slots per backend, taking turns, so every backend
+// gets an almost equal share of the slots, and adding or removing a backend moves few slots of the other backends.
+// The table size must be a prime. IPv4 fragments are hashed on the 3-tuple (see flow_key.h), so all fragments of a
+// datagram reach the same backend.
+//
+// The packet is then either rewritten to the backend address (DNAT, with an incremental checksum update) or
+// encapsulated in an outer IPv4 header to the backend (IP in IP), which keeps the VIP for direct server return.
+//
+// Like the RSS mode, the RX port has one receive queue and the TX port one transmit queue per worker lcore.
+//
+// There are two tables. A reload of the backends file (SIGHUP) fills the table the workers do not use and switches
+// them over with an atomic store, so forwarding never pauses. The workers report a quiescent state (rte_rcu_qsbr) after
+// every burst; the reload waits for it, so the next reload never writes a table which a worker still reads.
+//
+// The backends file has one IPv4 address per line. Empty lines, lines starting with '#' and repeated addresses are
+// ignored.
+//
+// The ACL and the blocklist stage are not supported in this mode as they allow only one lcore.
+
+enum class lb_encapsulation {
+    dnat,
+    ipip
+};
+
+struct lb_options {
+    const char *backends_file = nullptr;
+    uint32_t vip = 0;                                   // Network byte order.
+    lb_encapsulation encapsulation = lb_encapsulation::dnat;
+    uint32_t tunnel_source = 0;                         // Outer source address of IP in IP, network byte order.
+    uint32_t table_size = 65537;                        // Slots of the lookup table. Must be a prime.
+    bool rewrite_mac = false;                           // Rewrite source MAC to the TX port MAC and destination MAC to
+    rte_ether_addr dst_mac = {};                        // `dst_mac`.
+};
+
+struct maglev_lb;
+
+// Loads the backends file and fills the first table. Returns nullptr and prints the reason if the file or the table
+// size is invalid.
+maglev_lb *maglev_lb_create(const lb_options &options);
+
+void maglev_lb_free(maglev_lb *lb);
+
+// Loads the backends file again, fills the table the workers do not use and switches them to it. Waits until no worker
+// uses the old table any more. Must be called from a control thread. Returns false if the file is invalid; the old
+// backends stay active in that case.
+bool maglev_lb_reload(maglev_lb *lb, const char *backends_file);
+
+// Runs the load balancer mode until `exit_indicator` is set. `rx_port` must have one receive queue and `tx_port` one
+// transmit queue per worker lcore, both started. Returns false if there is no worker lcore.
+bool maglev_lb_loop(maglev_lb *lb, uint16_t rx_port, uint16_t tx_port, const volatile sig_atomic_t &exit_indicator);
@@ -20,21 +20,603 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <arpa/inet.h>
 #include <iostream>
 #include <thread>
+#include <vector>
 #include <csignal>
+#include <cstring>
+#include <getopt.h>
 #include <rte_eal.h>
 #include <rte_errno.h>
 #include <rte_ethdev.h>
 #include <rte_mbuf.h>
+#include <rte_thread.h>
+
+#include "app_telemetry.h"
+#include "conntrack.h"
+#include "distributor_pipeline.h"
+#include "event_log.h"
+#include "eventdev_pipeline.h"
+#include "flight_recorder.h"
+#include "flow_cardinality.h"
+#include "heavy_hitters.h"
+#include "ip_blocklist.h"
+#include "l2_forward.h"
+#include "lpm_router.h"
+#include "maglev_lb.h"
+#include "mempool_ops.h"
+#include "metrics_exporter.h"
+#include "packet_metadata.h"
+#include "packet_sampler.h"
+#include "perf_counters.h"
+#include "reflector.h"
+#include "rss_workers.h"
+#include "rx_graph.h"
+#include "rx_pipeline.h"
+#include "rx_timestamp.h"
+#include "sflow_exporter.h"
+#include "snat.h"
+#include "worker_stats.h"
+#include "xstats_sampler.h"
 
 static volatile sig_atomic_t exit_indicator = 0;
+static volatile sig_atomic_t reload_indicator = 0;
+
+// Written to the event log (see event_log.h) instead of std::cout, so that printing never delays the next poll.
+static const uint32_t packet_received_event = event_log_define("Packet received. Length: {}");
 
 void terminate(int signal) 
 {
     exit_indicator = 1;
 }
 
+void reload(int signal)
+{
+    reload_indicator = 1;
+}
+
+void dump_flight_recorder(int signal)
+{
+    flight_recorder_trigger();
+}
+
+// What the program does with the received packets.
+enum class app_mode {
+    receive,     // Print and free every received packet.
+    forward,     // Transmit every received packet on the TX port (see l2_forward.h).
+    reflect,     // Send every received packet back with swapped addresses (see reflector.h).
+    route,       // Route every received IPv4 / IPv6 packet with a longest prefix match table (see lpm_router.h).
+    graph,       // Process the received packets with a packet graph (see rx_graph.h).
+    eventdev,    // Schedule the received packets to the worker lcores with an event device (see eventdev_pipeline.h).
+    distributor, // Distribute the received packets to the worker lcores with a distributor (see distributor_pipeline.h).
+    rss,         // Receive on one RSS queue per worker lcore (see rss_workers.h).
+    nat,         // Translate the source address and port of the packets on one RSS queue per worker lcore (see snat.h).
+    lb           // Balance the packets to a VIP over backends on one RSS queue per worker lcore (see maglev_lb.h).
+};
+
+// Application arguments. These are the arguments passed after `--` on the command line.
+struct app_options {
+    const char *mempool_ops = default_mempool_ops;  // Mempool driver used by the packet memory pool.
+    app_mode mode = app_mode::receive;
+    int32_t rx_port = -1;                           // Port to receive from. -1 means the first detected port.
+    int32_t tx_port = -1;                           // Port to transmit on. -1 means the RX port.
+    l2_forward_options forward;
+    lpm_router_options router;
+    rx_graph_options graph;
+    const char *acl_rules_file = nullptr;           // Enables the ACL stage (see acl_classifier.h).
+    const char *blocklist_file = nullptr;           // Enables the source address blocklist stage (see ip_blocklist.h).
+    bool hardware_timestamps = true;                // Use NIC RX timestamps when supported (see rx_timestamp.h).
+    uint16_t metrics_port = 0;                      // TCP port of the Prometheus exporter. 0 disables it.
+    uint32_t xstats_interval_s = 0;                 // Print the drops by layer every N seconds. 0 disables.
+    bool perf_counters = false;                     // Profile the bursts with hardware counters (see perf_counters.h).
+    const char *event_log_file = nullptr;           // File of the event log (see event_log.h). nullptr writes to stdout.
+    uint32_t flight_packets = 0;                    // Packets kept per lcore by the flight recorder. 0 disables it.
+    const char *flight_prefix = "flight";           // Prefix of the flight recorder dump files.
+    packet_sample_mode sample_mode = packet_sample_mode::count;
+    uint32_t sample_rate = 0;                       // Sample 1 in N packets (see packet_sampler.h). 0 disables it.
+    const char *sample_output = "samples.sflow";    // File or udp:ADDRESS:PORT of the sFlow exporter.
+    uint32_t heavy_hitters_interval_s = 0;          // Print the top talkers every N seconds (see heavy_hitters.h). 0 disables.
+    uint32_t cardinality_interval_s = 0;            // Print the distinct flows and sources every N seconds. 0 disables.
+    uint32_t conntrack_flows = 0;                   // Connections tracked per lcore (see conntrack.h). 0 disables.
+    uint64_t work_cycles = 0;                       // Emulated processing cycles per packet of the worker lcores.
+    distributor_options distributor;
+    snat_options nat;
+    lb_options lb;
+};
+
+void print_usage(const char *program_name)
+{
+    std::cerr << "Usage: " << program_name << " [EAL arguments] -- [--mempool-ops=";
+    print_supported_mempool_ops(std::cerr);
+    std::cerr << "] [--mode=receive|forward|reflect|route|graph|eventdev|distributor|rss|nat|lb] [--rx-port=ID] [--tx-port=ID] [--acl-rules=PATH] [--blocklist=PATH]" << std::endl
+              << "    [--rx-timestamp=auto|software] [--metrics-port=PORT] [--xstats-interval=S] [--perf-counters] [--event-log=PATH]" << std::endl
+              << "    [--flight-recorder=N] [--flight-prefix=PATH] [--sample=count|random|flow:N] [--sample-output=PATH|udp:ADDRESS:PORT]" << std::endl
+              << "    [--heavy-hitters=S] [--cardinality=S] [--conntrack=N]" << std::endl
+              << "    Forward mode: [--flush-us=N] [--dst-mac=XX:XX:XX:XX:XX:XX] [--recycle-mbufs]" << std::endl
+              << "    Route mode: --route-file=PATH [--lpm-max-rules=N]" << std::endl
+              << "    Graph mode: [--graph-nodes=parse,classify,count|capture|forward] [--capture-file=PATH] [--stats-interval=S]" << std::endl
+              << "    Eventdev, distributor and RSS mode: [--work-cycles=N]" << std::endl
+              << "    Distributor mode: [--dist-output=free|forward|capture] [--capture-file=PATH] [--reorder] [--reorder-size=N]" << std::endl
+              << "    NAT mode: --nat-address=A.B.C.D [--nat-ports=LOW-HIGH] [--nat-timeout=S] [--nat-checksum-offload] [--dst-mac=XX:XX:XX:XX:XX:XX]" << std::endl
+              << "    LB mode: --lb-backends=PATH --lb-vip=A.B.C.D [--lb-encap=dnat|ipip] [--lb-address=A.B.C.D] [--lb-table-size=N]"
+              << " [--dst-mac=XX:XX:XX:XX:XX:XX]" << std::endl;
+}
+
+// Parses the application arguments with getopt_long(). Returns false if an argument is invalid.
+bool parse_app_args(int argc, char **argv, app_options &options)
+{
+    enum { OPT_MEMPOOL_OPS = 256, OPT_MODE, OPT_RX_PORT, OPT_TX_PORT, OPT_FLUSH_US, OPT_DST_MAC, OPT_RECYCLE_MBUFS,
+           OPT_ROUTE_FILE, OPT_LPM_MAX_RULES, OPT_ACL_RULES,
+           OPT_GRAPH_NODES, OPT_CAPTURE_FILE, OPT_STATS_INTERVAL, OPT_WORK_CYCLES,
+           OPT_DIST_OUTPUT, OPT_REORDER, OPT_REORDER_SIZE, OPT_RX_TIMESTAMP,
+           OPT_METRICS_PORT, OPT_XSTATS_INTERVAL, OPT_PERF_COUNTERS,
+           OPT_EVENT_LOG, OPT_FLIGHT_RECORDER, OPT_FLIGHT_PREFIX, OPT_SAMPLE, OPT_SAMPLE_OUTPUT,
+           OPT_HEAVY_HITTERS, OPT_CARDINALITY, OPT_BLOCKLIST, OPT_CONNTRACK,
+           OPT_NAT_ADDRESS, OPT_NAT_PORTS, OPT_NAT_TIMEOUT, OPT_NAT_CHECKSUM_OFFLOAD,
+           OPT_LB_BACKENDS, OPT_LB_VIP, OPT_LB_ENCAP, OPT_LB_ADDRESS, OPT_LB_TABLE_SIZE };
+    static const option long_options[] = {
+        {"mempool-ops", required_argument, nullptr, OPT_MEMPOOL_OPS},
+        {"mode", required_argument, nullptr, OPT_MODE},
+        {"rx-port", required_argument, nullptr, OPT_RX_PORT},
+        {"tx-port", required_argument, nullptr, OPT_TX_PORT},
+        {"flush-us", required_argument, nullptr, OPT_FLUSH_US},
+        {"dst-mac", required_argument, nullptr, OPT_DST_MAC},
+        {"recycle-mbufs", no_argument, nullptr, OPT_RECYCLE_MBUFS},
+        {"route-file", required_argument, nullptr, OPT_ROUTE_FILE},
+        {"lpm-max-rules", required_argument, nullptr, OPT_LPM_MAX_RULES},
+        {"acl-rules", required_argument, nullptr, OPT_ACL_RULES},
+        {"graph-nodes", required_argument, nullptr, OPT_GRAPH_NODES},
+        {"capture-file", required_argument, nullptr, OPT_CAPTURE_FILE},
+        {"stats-interval", required_argument, nullptr, OPT_STATS_INTERVAL},
+        {"work-cycles", required_argument, nullptr, OPT_WORK_CYCLES},
+        {"dist-output", required_argument, nullptr, OPT_DIST_OUTPUT},
+        {"reorder", no_argument, nullptr, OPT_REORDER},
+        {"reorder-size", required_argument, nullptr, OPT_REORDER_SIZE},
+        {"rx-timestamp", required_argument, nullptr, OPT_RX_TIMESTAMP},
+        {"metrics-port", required_argument, nullptr, OPT_METRICS_PORT},
+        {"xstats-interval", required_argument, nullptr, OPT_XSTATS_INTERVAL},
+        {"perf-counters", no_argument, nullptr, OPT_PERF_COUNTERS},
+        {"event-log", required_argument, nullptr, OPT_EVENT_LOG},
+        {"flight-recorder", required_argument, nullptr, OPT_FLIGHT_RECORDER},
+        {"flight-prefix", required_argument, nullptr, OPT_FLIGHT_PREFIX},
+        {"sample", required_argument, nullptr, OPT_SAMPLE},
+        {"sample-output", required_argument, nullptr, OPT_SAMPLE_OUTPUT},
+        {"heavy-hitters", required_argument, nullptr, OPT_HEAVY_HITTERS},
+        {"cardinality", required_argument, nullptr, OPT_CARDINALITY},
+        {"blocklist", required_argument, nullptr, OPT_BLOCKLIST},
+        {"conntrack", required_argument, nullptr, OPT_CONNTRACK},
+        {"nat-address", required_argument, nullptr, OPT_NAT_ADDRESS},
+        {"nat-ports", required_argument, nullptr, OPT_NAT_PORTS},
+        {"nat-timeout", required_argument, nullptr, OPT_NAT_TIMEOUT},
+        {"nat-checksum-offload", no_argument, nullptr, OPT_NAT_CHECKSUM_OFFLOAD},
+        {"lb-backends", required_argument, nullptr, OPT_LB_BACKENDS},
+        {"lb-vip", required_argument, nullptr, OPT_LB_VIP},
+        {"lb-encap", required_argument, nullptr, OPT_LB_ENCAP},
+        {"lb-address", required_argument, nullptr, OPT_LB_ADDRESS},
+        {"lb-table-size", required_argument, nullptr, OPT_LB_TABLE_SIZE},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt = 0;
+    optind = 1;     // rte_eal_init() has already used getopt, so we reset its state.
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_MEMPOOL_OPS:
+            if (!is_supported_mempool_ops(optarg)) {
+                std::cerr << "Unsupported mempool ops: " << optarg << std::endl;
+                return false;
+            }
+            options.mempool_ops = optarg;
+            break;
+        case OPT_MODE:
+            if (strcmp(optarg, "receive") == 0) {
+                options.mode = app_mode::receive;
+            } else if (strcmp(optarg, "forward") == 0) {
+                options.mode = app_mode::forward;
+            } else if (strcmp(optarg, "reflect") == 0) {
+                options.mode = app_mode::reflect;
+            } else if (strcmp(optarg, "route") == 0) {
+                options.mode = app_mode::route;
+            } else if (strcmp(optarg, "graph") == 0) {
+                options.mode = app_mode::graph;
+            } else if (strcmp(optarg, "eventdev") == 0) {
+                options.mode = app_mode::eventdev;
+            } else if (strcmp(optarg, "distributor") == 0) {
+                options.mode = app_mode::distributor;
+            } else if (strcmp(optarg, "rss") == 0) {
+                options.mode = app_mode::rss;
+            } else if (strcmp(optarg, "nat") == 0) {
+                options.mode = app_mode::nat;
+            } else if (strcmp(optarg, "lb") == 0) {
+                options.mode = app_mode::lb;
+            } else {
+                std::cerr << "Unknown mode: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_RX_PORT:
+            options.rx_port = strtol(optarg, nullptr, 10);
+            break;
+        case OPT_TX_PORT:
+            options.tx_port = strtol(optarg, nullptr, 10);
+            break;
+        case OPT_FLUSH_US:
+            options.forward.flush_timeout_us = strtoull(optarg, nullptr, 10);
+            break;
+        case OPT_DST_MAC:
+            // Passing a destination MAC enables the MAC rewrite of the forwarded (or translated, or balanced) packets.
+            if (rte_ether_unformat_addr(optarg, &options.forward.dst_mac) != 0) {
+                std::cerr << "Invalid MAC address: " << optarg << std::endl;
+                return false;
+            }
+            options.forward.rewrite_mac = true;
+            options.nat.rewrite_mac = true;
+            options.nat.dst_mac = options.forward.dst_mac;
+            options.lb.rewrite_mac = true;
+            options.lb.dst_mac = options.forward.dst_mac;
+            break;
+        case OPT_RECYCLE_MBUFS:
+            options.forward.recycle_mbufs = true;
+            break;
+        case OPT_ROUTE_FILE:
+            options.router.route_file = optarg;
+            break;
+        case OPT_LPM_MAX_RULES:
+            options.router.max_rules = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_ACL_RULES:
+            options.acl_rules_file = optarg;
+            break;
+        case OPT_GRAPH_NODES:
+            if (!rx_graph_parse_nodes(optarg, options.graph)) {
+                return false;
+            }
+            break;
+        case OPT_CAPTURE_FILE:
+            options.graph.capture_file = optarg;
+            options.distributor.capture_file = optarg;
+            break;
+        case OPT_STATS_INTERVAL:
+            options.graph.stats_interval_s = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_WORK_CYCLES:
+            options.work_cycles = strtoull(optarg, nullptr, 10);
+            options.distributor.work_cycles = options.work_cycles;
+            break;
+        case OPT_DIST_OUTPUT:
+            if (strcmp(optarg, "free") == 0) {
+                options.distributor.output = distributor_output::free;
+            } else if (strcmp(optarg, "forward") == 0) {
+                options.distributor.output = distributor_output::forward;
+            } else if (strcmp(optarg, "capture") == 0) {
+                options.distributor.output = distributor_output::capture;
+            } else {
+                std::cerr << "Unknown distributor output: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_REORDER:
+            options.distributor.reorder = true;
+            break;
+        case OPT_REORDER_SIZE:
+            // The reorder buffer uses the sequence number as index, so its size must be a power of 2.
+            options.distributor.reorder_buffer_size = strtoul(optarg, nullptr, 10);
+            if (!rte_is_power_of_2(options.distributor.reorder_buffer_size)) {
+                std::cerr << "Reorder buffer size must be a power of 2: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_RX_TIMESTAMP:
+            if (strcmp(optarg, "auto") == 0) {
+                options.hardware_timestamps = true;
+            } else if (strcmp(optarg, "software") == 0) {
+                options.hardware_timestamps = false;
+            } else {
+                std::cerr << "Unknown RX timestamp source: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_METRICS_PORT:
+            options.metrics_port = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_XSTATS_INTERVAL:
+            options.xstats_interval_s = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_PERF_COUNTERS:
+            options.perf_counters = true;
+            break;
+        case OPT_EVENT_LOG:
+            options.event_log_file = optarg;
+            break;
+        case OPT_FLIGHT_RECORDER:
+            options.flight_packets = strtoul(optarg, nullptr, 10);
+            if (!rte_is_power_of_2(options.flight_packets)) {
+                std::cerr << "Flight recorder size must be a power of 2: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_FLIGHT_PREFIX:
+            options.flight_prefix = optarg;
+            break;
+        case OPT_SAMPLE:
+            if (!packet_sampler_parse(optarg, options.sample_mode, options.sample_rate)) {
+                std::cerr << "Invalid sampling: " << optarg << ". Expected count:N, random:N or flow:N" << std::endl;
+                return false;
+            }
+            break;
+        case OPT_SAMPLE_OUTPUT:
+            options.sample_output = optarg;
+            break;
+        case OPT_HEAVY_HITTERS:
+            options.heavy_hitters_interval_s = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_CARDINALITY:
+            options.cardinality_interval_s = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_BLOCKLIST:
+            options.blocklist_file = optarg;
+            break;
+        case OPT_CONNTRACK:
+            options.conntrack_flows = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_NAT_ADDRESS:
+            if (inet_pton(AF_INET, optarg, &options.nat.public_addr) != 1) {
+                std::cerr << "Invalid NAT address: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_NAT_PORTS:
+            if (!snat_parse_ports(optarg, options.nat)) {
+                std::cerr << "Invalid NAT port range: " << optarg << ". Expected LOW-HIGH, e.g. 1024-65535" << std::endl;
+                return false;
+            }
+            break;
+        case OPT_NAT_TIMEOUT:
+            options.nat.timeout_s = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_NAT_CHECKSUM_OFFLOAD:
+            options.nat.checksum_offload = true;
+            break;
+        case OPT_LB_BACKENDS:
+            options.lb.backends_file = optarg;
+            break;
+        case OPT_LB_VIP:
+            if (inet_pton(AF_INET, optarg, &options.lb.vip) != 1) {
+                std::cerr << "Invalid VIP: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_LB_ENCAP:
+            if (strcmp(optarg, "dnat") == 0) {
+                options.lb.encapsulation = lb_encapsulation::dnat;
+            } else if (strcmp(optarg, "ipip") == 0) {
+                options.lb.encapsulation = lb_encapsulation::ipip;
+            } else {
+                std::cerr << "Unknown LB encapsulation: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_LB_ADDRESS:
+            if (inet_pton(AF_INET, optarg, &options.lb.tunnel_source) != 1) {
+                std::cerr << "Invalid LB address: " << optarg << std::endl;
+                return false;
+            }
+            break;
+        case OPT_LB_TABLE_SIZE:
+            options.lb.table_size = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    // In these modes the worker lcores free the packets while the main lcore (or every worker) allocates them.
+    const bool multi_lcore_mode = (options.mode == app_mode::eventdev || options.mode == app_mode::distributor ||
+                                   options.mode == app_mode::rss || options.mode == app_mode::nat ||
+                                   options.mode == app_mode::lb);
+    if (multi_lcore_mode && is_single_lcore_mempool_ops(options.mempool_ops)) {
+        std::cerr << "Mempool ops " << options.mempool_ops << " is not safe with the worker lcores of this mode" << std::endl;
+        return false;
+    }
+
+    if (options.mode == app_mode::route && options.router.route_file == nullptr) {
+        std::cerr << "Route mode needs a route file (--route-file)" << std::endl;
+        return false;
+    }
+
+    if (options.mode == app_mode::nat && options.nat.public_addr == 0) {
+        std::cerr << "NAT mode needs a public address (--nat-address)" << std::endl;
+        return false;
+    }
+
+    if (options.mode == app_mode::lb && (options.lb.backends_file == nullptr || options.lb.vip == 0)) {
+        std::cerr << "LB mode needs a backends file (--lb-backends) and a VIP (--lb-vip)" << std::endl;
+        return false;
+    }
+
+    if (options.mode == app_mode::lb && options.lb.encapsulation == lb_encapsulation::ipip &&
+        options.lb.tunnel_source == 0) {
+        std::cerr << "IP in IP encapsulation needs the outer source address (--lb-address)" << std::endl;
+        return false;
+    }
+
+    if ((options.mode == app_mode::rss || options.mode == app_mode::nat || options.mode == app_mode::lb) &&
+        options.acl_rules_file != nullptr) {
+        std::cerr << "RSS, NAT and LB mode do not support the ACL stage (--acl-rules)" << std::endl;
+        return false;
+    }
+
+    if ((options.mode == app_mode::rss || options.mode == app_mode::graph || options.mode == app_mode::nat ||
+         options.mode == app_mode::lb) && options.blocklist_file != nullptr) {
+        std::cerr << "RSS, graph, NAT and LB mode do not support the blocklist stage (--blocklist)" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Prints the length of every packet received on queue 0 of `port_id` and frees it, until `exit_indicator` is set.
+// The received packets pass `pipeline` first.
+void receive_loop(uint16_t port_id, rx_pipeline &pipeline)
+{
+    std::cout << "Waiting for incoming packets on the ethernet port ... " << std::endl;
+    
+    rte_mbuf *received_packats[32];
+    uint16_t rx_packets = 0;
+
+    // Now we go into a loop to continously check the port (ethernet interface) for any incoming packets. This process is called polling.
+    while (!exit_indicator) {
+        rx_packets = rx_pipeline_process(pipeline, received_packats, rte_eth_rx_burst(port_id, 0, received_packats, 32));
+
+        if (rx_packets == 0) {
+            using namespace std::literals;
+            std::this_thread::sleep_for(10us);
+            continue;
+        }
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            event_log_write(packet_received_event, received_packats[i]->data_len);
+        }
+
+        // Free all the received packets.
+        rte_pktmbuf_free_bulk(received_packats, rx_packets);
+    }
+}
+
+struct reload_context {
+    acl_classifier *classifier;
+    const char *rules_file;
+    ip_blocklist *blocklist;
+    const char *blocklist_file;
+    maglev_lb *lb;
+    const char *backends_file;
+};
+
+// Control thread which rebuilds the ACL rules, the blocklist and the Maglev table when the program receives SIGHUP.
+// The rebuild runs here and not on the lcores which receive packets, so packet processing continues with the old rules
+// until the new ones are swapped in.
+uint32_t reload_thread(void *arg)
+{
+    reload_context *context = static_cast<reload_context *>(arg);
+
+    while (!exit_indicator) {
+        if (reload_indicator) {
+            reload_indicator = 0;
+            if (context->classifier != nullptr) {
+                acl_classifier_reload(context->classifier, context->rules_file);
+            }
+            if (context->blocklist != nullptr) {
+                ip_blocklist_reload(context->blocklist, context->blocklist_file);
+            }
+            if (context->lb != nullptr) {
+                maglev_lb_reload(context->lb, context->backends_file);
+            }
+        }
+
+        using namespace std::literals;
+        std::this_thread::sleep_for(100ms);
+    }
+
+    return 0;
+}
+
+// Configures `port_id` with `rx_queues` receive queues and `tx_queues` transmit queues and starts it. The receive queues
+// take their memory buffers from `memory_pool`. With more than one receive queue the NIC spreads the flows over the
+// queues with RSS (receive side scaling). With `symmetric_rss` both directions of a connection go to the same queue.
+// Every received packet gets an RX timestamp, from the NIC if `hardware_timestamps` is set and the NIC supports it (see
+// rx_timestamp.h). The transmit queues use `tx_offloads`. Returns false if any step fails.
+bool setup_port(uint16_t port_id, uint16_t rx_queues, uint16_t tx_queues, rte_mempool *memory_pool, bool hardware_timestamps,
+                uint64_t tx_offloads, bool symmetric_rss)
+{
+    rte_eth_conf portConf = {
+        .rxmode = {
+            .mq_mode = RTE_ETH_MQ_RX_NONE
+        },
+        .txmode = {
+            .mq_mode = RTE_ETH_MQ_TX_NONE
+        }
+    };
+
+    // The Toeplitz hash of RSS gives the same result for swapped addresses and ports when the key repeats every 16 bits.
+    // The default key of the NIC does not, so the replies of a connection may land on another queue.
+    std::vector<uint8_t> symmetric_key;
+    if (rx_queues > 1) {
+        // Hash the IP addresses and the TCP / UDP ports, limited to the hash types the NIC supports.
+        rte_eth_dev_info dev_info = {};
+        rte_eth_dev_info_get(port_id, &dev_info);
+        portConf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+        portConf.rx_adv_conf.rss_conf.rss_key = nullptr;
+        portConf.rx_adv_conf.rss_conf.rss_hf = (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+        if (symmetric_rss) {
+            symmetric_key.resize(dev_info.hash_key_size != 0 ? dev_info.hash_key_size : 40);
+            for (size_t i = 0; i < symmetric_key.size(); i++) {
+                symmetric_key[i] = (i % 2 == 0) ? 0x6d : 0x5a;
+            }
+            portConf.rx_adv_conf.rss_conf.rss_key = symmetric_key.data();
+            portConf.rx_adv_conf.rss_conf.rss_key_len = symmetric_key.size();
+        }
+    }
+    portConf.rxmode.offloads |= rx_timestamp_offloads(port_id, hardware_timestamps);
+    portConf.txmode.offloads |= tx_offloads;
+
+    // Configure the port (ethernet interface).
+    int32_t return_val = 0;
+    if ((return_val = rte_eth_dev_configure(port_id, rx_queues, tx_queues, &portConf)) != 0) {
+        std::cerr << "Unable to configure port. port Id: " << port_id << " Return code: "  << return_val << std::endl;
+        return false;
+    }
+
+    const int16_t portSocketId = rte_eth_dev_socket_id(port_id);
+    const int16_t coreSocketId = rte_socket_id();
+
+    // Configure the queue(s) of the port.
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        return_val = rte_eth_rx_queue_setup(port_id, i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr, memory_pool);
+        
+        if (return_val < 0) {
+            std::cerr << "Unable to setup RX queue " << i << " Port Id: " << port_id << "Return code: " << return_val << std::endl;
+            return false;
+        }
+
+        std::cout << "Port Id: " << port_id << " Rx Queue: " << i << " setup successful. Socket id: "   
+                  << ((portSocketId >= 0) ? portSocketId : coreSocketId) << std::endl;
+    }
+
+    for (uint16_t i = 0; i < tx_queues; i++) {
+        return_val = rte_eth_tx_queue_setup(port_id, i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr);
+
+        if (return_val < 0) {
+            std::cerr << "Unable to setup TX queue " << i << " Port Id: " << port_id << "Return code: " << return_val << std::endl;
+            return false;
+        }
+
+        std::cout << "Port Id: " << port_id << " Tx Queue: " << i << " setup successful. Socket id: "
+                  << ((portSocketId >= 0) ? portSocketId : coreSocketId) << std::endl;
+    }
+
+    // Enable promiscuous mode on the port. Not all the DPDK drivers provide the functionality to enable promiscuous mode. So we are going to 
+    // ignore the result if the API fails.
+    return_val = rte_eth_promiscuous_enable(port_id);
+    if (return_val < 0) {
+        std::cout << "Warning: Unable to set the promiscuous mode for port Id: " << port_id << " Return code: " << return_val << " Ignoring ... " << std::endl;
+    }
+
+    // All the configuration is done. Finally starting the port (ethernet interface) so that we can start receiving the packets.
+    return_val = rte_eth_dev_start(port_id);
+    if (return_val < 0) {
+        std::cout << "Unable to start port Id: " << port_id << " Return code: " << return_val << std::endl;
+        return false;
+    }
+
+    if (!rx_timestamp_start(port_id, rx_queues)) {
+        return false;
+    }
+
+    std::cout << "Port configuration successful. Port Id: " << port_id << std::endl;
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     // Setting up signals to catch TERM and INT signal.
@@ -44,6 +626,14 @@ int main(int argc, char **argv)
     sigaction(SIGTERM, &action, nullptr);
     sigaction(SIGINT, &action, nullptr);
 
+    // SIGHUP reloads the ACL rules file and the blocklist file.
+    action.sa_handler = reload;
+    sigaction(SIGHUP, &action, nullptr);
+
+    // SIGUSR1 dumps the flight recorder.
+    action.sa_handler = dump_flight_recorder;
+    sigaction(SIGUSR1, &action, nullptr);
+
     std::cout << "Starting DPDK program ... " << std::endl;
 
     // Initializing the DPDK EAL (Environment Abstraction Layer). This is the first step of a DPDK program before we 
@@ -72,6 +662,35 @@ int main(int argc, char **argv)
     argc -= return_val;
     argv += return_val;
 
+    app_options options;
+    if (!parse_app_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    // Registers the mbuf dynamic fields which carry the per packet metadata between the stages (see packet_metadata.h).
+    if (!packet_metadata_register()) {
+        std::cerr << "Unable to register the packet metadata fields. Error code: " << rte_errno << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    // Registers the /app telemetry commands (see app_telemetry.h). The application works without them.
+    if (!app_telemetry_register()) {
+        std::cout << "Warning: Unable to register the telemetry commands. Ignoring ... " << std::endl;
+    }
+
+    // Hardware counters per burst (see perf_counters.h). The lcores open them on their first poll.
+    if (options.perf_counters) {
+        perf_counters_enable();
+    }
+
+    // Without the event log the program still works, but the per packet messages are not shown.
+    if (!event_log_start(options.event_log_file)) {
+        std::cout << "Warning: Unable to start the event log. Ignoring ... " << std::endl;
+    }
+
     uint16_t port_ids[RTE_MAX_ETHPORTS] = {0};
     int16_t id = 0;
     int16_t total_port_count = 0;
@@ -99,87 +718,262 @@ int main(int argc, char **argv)
     // Creating memory pool which contains the memory buffers. A memory buffer is the buffer where DPDK driver will write an 
     // incoming packet. Below memory pool has name "mempool_1" and has 1023 available memory buffer. A single memory buffer 
     // has a size of RTE_MBUF_DEFAULT_BUF_SIZE (2048Bytes + 128Bytes).
-    rte_mempool *memory_pool = rte_pktmbuf_pool_create("mempool_1", 1023, 512, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+    // In route mode every detected port has a 256 entry receive ring and a 256 entry transmit ring, so the pool grows
+    // with the number of ports to keep all the rings filled.
+    // In eventdev, distributor and RSS mode the worker lcores free the packets, so every lcore can keep up to 512 buffers in its
+    // mempool cache, and in RSS mode every worker has its own 256 entry receive ring. In NAT mode every worker has a
+    // 256 entry receive and transmit ring on both ports. In LB mode every worker has a 256 entry receive ring on the RX
+    // port and a 256 entry transmit ring on the TX port.
+    // The free memory buffers are kept by the mempool driver selected with `--mempool-ops` (see mempool_ops.h).
+    uint32_t mbuf_count = 1023U;
+    if (options.mode == app_mode::route) {
+        mbuf_count = RTE_MAX(1023U, total_port_count * 512U + 1023U);
+    } else if (options.mode == app_mode::eventdev || options.mode == app_mode::distributor || options.mode == app_mode::rss) {
+        mbuf_count = rte_lcore_count() * (512U + 256U) + 1023U;
+    } else if (options.mode == app_mode::nat) {
+        mbuf_count = rte_lcore_count() * (512U + 4 * 256U) + 1023U;
+    } else if (options.mode == app_mode::lb) {
+        mbuf_count = rte_lcore_count() * (512U + 2 * 256U) + 1023U;
+    }
+    // The reorder buffer holds up to twice its size in packets: the packets waiting for a missing packet and the packets
+    // ready to be drained.
+    if (options.mode == app_mode::distributor && options.distributor.reorder) {
+        mbuf_count += 2 * options.distributor.reorder_buffer_size;
+    }
+    rte_mempool *memory_pool = create_packet_pool("mempool_1", mbuf_count, 512, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id(),
+                                                  options.mempool_ops);
+    if (memory_pool == nullptr) {
+        std::cerr << "Unable to create memory pool with mempool ops " << options.mempool_ops << ". Error code: " << rte_errno << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    const uint16_t rx_port = (options.rx_port >= 0) ? options.rx_port : port_ids[0];
+    const uint16_t tx_port = (options.tx_port >= 0) ? options.tx_port : rx_port;
+    if (!rte_eth_dev_is_valid_port(rx_port) || !rte_eth_dev_is_valid_port(tx_port)) {
+        std::cerr << "Invalid port Id. RX port: " << rx_port << " TX port: " << tx_port << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
 
     // Configuring the port (ethernet interface). An ethernet interface can have multiple receive queues and transmit queues. 
-    // Currently we are setting up only one receive queue and no transmit queue as we are not sending packets in this tutorial.
-    const uint16_t rx_queues = 1;
-    const uint16_t tx_queues = 0;
+    // In receive mode we are setting up only one receive queue and no transmit queue as we are not sending packets.
+    // The same holds for eventdev and RSS mode, where the worker lcores free the packets.
+    // In the other modes every used port gets one receive queue and one transmit queue.
+    // In route mode any port can be an egress port, so every detected port gets one receive and one transmit queue.
+    // In RSS mode the RX port gets one receive queue per worker lcore.
+    // In NAT mode both ports get one receive and one transmit queue per worker lcore, and the checksum offloads if they
+    // are requested and supported. In LB mode the RX port gets one receive queue and the TX port one transmit queue per
+    // worker lcore.
+    const bool per_worker_queues = (options.mode == app_mode::rss || options.mode == app_mode::nat ||
+                                    options.mode == app_mode::lb);
+    const uint16_t rx_queues = per_worker_queues ? RTE_MAX(1U, rte_lcore_count() - 1) : 1;
+    const uint16_t tx_queues = (options.mode == app_mode::receive || options.mode == app_mode::eventdev ||
+                                options.mode == app_mode::rss) ? 0 : (per_worker_queues ? rx_queues : 1);
+    const uint16_t tx_port_rx_queues = (options.mode == app_mode::nat) ? rx_queues : 1;
+    // Connection tracking shares one entry between both directions of a connection, which must therefore reach the same
+    // lcore (see conntrack.h).
+    const bool symmetric_rss = (options.conntrack_flows != 0);
+    auto tx_offloads = [&](uint16_t port_id) {
+        return (options.mode == app_mode::nat) ? snat_tx_offloads(port_id, options.nat) : 0;
+    };
+    if (options.mode == app_mode::route) {
+        for (int16_t i = 0; i < total_port_count; i++) {
+            if (!setup_port(port_ids[i], 1, tx_queues, memory_pool, options.hardware_timestamps, 0, false)) {
+                rte_eal_cleanup();
+                exit(1);
+            }
+        }
+    } else if (!setup_port(rx_port, rx_queues, tx_queues, memory_pool, options.hardware_timestamps, tx_offloads(rx_port),
+                           symmetric_rss) ||
+               (tx_port != rx_port && !setup_port(tx_port, tx_port_rx_queues, tx_queues, memory_pool,
+                                                  options.hardware_timestamps, tx_offloads(tx_port), symmetric_rss))) {
+        rte_eal_cleanup();
+        exit(1);
+    }
 
-    rte_eth_conf portConf = {
-        .rxmode = {
-            .mq_mode = RTE_ETH_MQ_RX_NONE
-        },
-        .txmode = {
-            .mq_mode = RTE_ETH_MQ_TX_NONE
+    // Adds RX callbacks to the queues the lcores receive from. In route mode every port receives. The callbacks are
+    // added after the RX timestamp callbacks of setup_port(), so the packets have their timestamps.
+    auto add_rx_callbacks = [&](bool (*add_port)(uint16_t port_id, uint16_t rx_queues)) {
+        if (options.mode != app_mode::route) {
+            return add_port(rx_port, rx_queues);
+        }
+        for (int16_t i = 0; i < total_port_count; i++) {
+            if (!add_port(port_ids[i], 1)) {
+                return false;
+            }
         }
+        return true;
     };
 
-    // Configure the port (ethernet interface).
-    if ((return_val = rte_eth_dev_configure(port_ids[0], rx_queues, tx_queues, &portConf)) != 0) {
-        std::cerr << "Unable to configure port. port Id: " << port_ids[0] << " Return code: "  << return_val << std::endl;
+    if (options.flight_packets != 0 &&
+        (!flight_recorder_create(options.flight_packets, options.flight_prefix) || !add_rx_callbacks(flight_recorder_add_port))) {
         rte_eal_cleanup();
         exit(1);
     }
 
-    const int16_t portSocketId = rte_eth_dev_socket_id(port_ids[0]);
-    const int16_t coreSocketId = rte_socket_id();
+    if (options.heavy_hitters_interval_s != 0 &&
+        (!heavy_hitters_create(options.heavy_hitters_interval_s) || !add_rx_callbacks(heavy_hitters_add_port))) {
+        rte_eal_cleanup();
+        exit(1);
+    }
 
-    // Configure the queue(s) of the port.
-    for (uint16_t i = 0; i < rx_queues; i++) {
-        return_val = rte_eth_rx_queue_setup(port_ids[0], i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr, memory_pool);
-        
-        if (return_val < 0) {
-            std::cerr << "Unable to setup RX queue " << i << " Port Id: " << port_ids[0] << "Return code: " << return_val << std::endl;
+    if (options.cardinality_interval_s != 0 &&
+        (!flow_cardinality_create(options.cardinality_interval_s) || !add_rx_callbacks(flow_cardinality_add_port))) {
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    if (options.conntrack_flows != 0 &&
+        (!conntrack_create(options.conntrack_flows) || !add_rx_callbacks(conntrack_add_port))) {
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    sflow_exporter *sflow = nullptr;
+    if (options.sample_rate != 0) {
+        if (!packet_sampler_create(options.sample_mode, options.sample_rate) ||
+            (sflow = sflow_exporter_start(packet_sampler_ring(), options.sample_output)) == nullptr ||
+            !add_rx_callbacks(packet_sampler_add_port)) {
             rte_eal_cleanup();
             exit(1);
         }
-
-        std::cout << "Port Id: " << port_ids[0] << " Rx Queue: " << i << " setup successful. Socket id: "   
-                  << ((portSocketId >= 0) ? portSocketId : coreSocketId) << std::endl;
     }
 
-    // Enable promiscuous mode on the port. Not all the DPDK drivers provide the functionality to enable promiscuous mode. So we are going to 
-    // ignore the result if the API fails.
-    return_val = rte_eth_promiscuous_enable(port_ids[0]);
-    if (return_val < 0) {
-        std::cout << "Warning: Unable to set the promiscuous mode for port Id: " << port_ids[0] << " Return code: " << return_val << " Ignoring ... " << std::endl;
+    // The route table is loaded after the ports are started so that the MAC addresses of the egress ports are known.
+    lpm_router *router = nullptr;
+    if (options.mode == app_mode::route) {
+        router = lpm_router_create(options.router, rte_socket_id());
+        if (router == nullptr) {
+            rte_eal_cleanup();
+            exit(1);
+        }
     }
 
-    // All the configuration is done. Finally starting the port (ethernet interface) so that we can start receiving the packets.
-    return_val = rte_eth_dev_start(port_ids[0]);
-    if (return_val < 0) {
-        std::cout << "Unable to start port Id: " << port_ids[0] << " Return code: " << return_val << std::endl;
-        rte_eal_cleanup();
-        exit(1);
+    rx_pipeline pipeline;
+    if (options.acl_rules_file != nullptr) {
+        pipeline.acl = acl_classifier_create(options.acl_rules_file, rte_socket_id());
+        if (pipeline.acl == nullptr) {
+            rte_eal_cleanup();
+            exit(1);
+        }
     }
 
-    std::cout << "Port configuration successful. Port Id: " << port_ids[0] << std::endl;
-
-    std::cout << "Waiting for incoming packets on the ethernet port ... " << std::endl;
-    
-    rte_mbuf *received_packats[32];
-    uint16_t rx_packets = 0;
+    if (options.blocklist_file != nullptr) {
+        pipeline.blocklist = ip_blocklist_create(options.blocklist_file, rte_socket_id());
+        if (pipeline.blocklist == nullptr) {
+            acl_classifier_free(pipeline.acl);
+            rte_eal_cleanup();
+            exit(1);
+        }
+    }
 
-    // Now we go into a loop to continously check the port (ethernet interface) for any incoming packets. This process is called polling.
-    while (!exit_indicator) {
-        rx_packets = rte_eth_rx_burst(port_ids[0], 0, received_packats, 32);
+    maglev_lb *lb = nullptr;
+    if (options.mode == app_mode::lb) {
+        lb = maglev_lb_create(options.lb);
+        if (lb == nullptr) {
+            rte_eal_cleanup();
+            exit(1);
+        }
+    }
 
-        if (rx_packets == 0) {
-            using namespace std::literals;
-            std::this_thread::sleep_for(10us);
-            continue;
+    reload_context reload_state = {pipeline.acl, options.acl_rules_file, pipeline.blocklist, options.blocklist_file,
+                                   lb, options.lb.backends_file};
+    rte_thread_t reload_thread_id = {};
+    bool reload_started = false;
+    if (pipeline.acl != nullptr || pipeline.blocklist != nullptr || lb != nullptr) {
+        reload_started = (rte_thread_create_control(&reload_thread_id, "reload", reload_thread, &reload_state) == 0);
+        if (!reload_started) {
+            std::cout << "Warning: Unable to start the reload thread. SIGHUP will not reload the rules ... " << std::endl;
         }
+    }
 
-        for (uint16_t i = 0; i < rx_packets; i++) {
-            std::cout << "Packet received. Length: " << received_packats[i]->data_len << std::endl;
+    // The exporter thread only reads counters, so the program keeps running if it cannot be started.
+    metrics_exporter *exporter = nullptr;
+    if (options.metrics_port != 0) {
+        exporter = metrics_exporter_create(options.metrics_port);
+        if (exporter != nullptr) {
+            metrics_exporter_add_collector(exporter, worker_stats_collect_metrics, nullptr);
+            if (!metrics_exporter_start(exporter)) {
+                metrics_exporter_stop(exporter);
+                exporter = nullptr;
+            }
         }
+    }
 
-        // Free all the received packets.
-        rte_pktmbuf_free_bulk(received_packats, rx_packets);
+    // Like the exporter, the sampler only reads counters. The program keeps running without it.
+    xstats_sampler *sampler = nullptr;
+    if (options.xstats_interval_s != 0) {
+        sampler = xstats_sampler_start(port_ids, total_port_count, memory_pool, options.xstats_interval_s);
     }
 
+    // Modes which cannot start print the reason, the program then exits with an error after the cleanup.
+    bool mode_started = true;
+    switch (options.mode) {
+    case app_mode::receive:
+        receive_loop(rx_port, pipeline);
+        break;
+    case app_mode::forward:
+        l2_forward_loop(rx_port, tx_port, options.forward, pipeline, exit_indicator);
+        break;
+    case app_mode::reflect:
+        reflector_loop(rx_port, pipeline, exit_indicator);
+        break;
+    case app_mode::route:
+        lpm_router_loop(router, port_ids, total_port_count, pipeline, exit_indicator);
+        lpm_router_free(router);
+        break;
+    case app_mode::graph:
+        mode_started = rx_graph_loop(rx_port, tx_port, options.graph, pipeline, exit_indicator);
+        break;
+    case app_mode::eventdev:
+        mode_started = eventdev_loop(rx_port, options.work_cycles, pipeline, exit_indicator);
+        break;
+    case app_mode::distributor:
+        mode_started = distributor_loop(rx_port, tx_port, options.distributor, pipeline, exit_indicator);
+        break;
+    case app_mode::rss:
+        mode_started = rss_workers_loop(rx_port, options.work_cycles, exit_indicator);
+        break;
+    case app_mode::nat:
+        mode_started = snat_loop(rx_port, tx_port, options.nat, exit_indicator);
+        break;
+    case app_mode::lb:
+        mode_started = maglev_lb_loop(lb, rx_port, tx_port, exit_indicator);
+        break;
+    }
+
+    // The lcore stopped receiving, a blocklist reload must not wait for it.
+    if (pipeline.blocklist != nullptr) {
+        ip_blocklist_reader_offline(pipeline.blocklist);
+    }
+
+    rx_pipeline_print_stats(pipeline);
+    perf_counters_print();
+    event_log_stop();
+    flight_recorder_free();
+    packet_sampler_print_stats();
+    sflow_exporter_stop(sflow);
+    packet_sampler_free();
+    heavy_hitters_free();
+    flow_cardinality_free();
+    conntrack_print_stats();
+    conntrack_free();
+    xstats_sampler_stop(sampler);
+    for (int16_t i = 0; i < total_port_count; i++) {
+        rx_timestamp_print_stats(port_ids[i]);
+        rx_timestamp_stop(port_ids[i]);
+    }
+    if (reload_started) {
+        rte_thread_join(reload_thread_id, nullptr);
+    }
+    acl_classifier_free(pipeline.acl);
+    ip_blocklist_free(pipeline.blocklist);
+    maglev_lb_free(lb);
+
+    metrics_exporter_stop(exporter);
+
     std::cout << "Exiting DPDK program ... " << std::endl;
     rte_eal_cleanup();
-    return 0;
+    return mode_started ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_sampler.h"
+
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_random.h>
+#include <rte_ring_elem.h>
+
+#include "flow_key.h"
+#include "packet_metadata.h"
+
+constexpr uint32_t sample_ring_size = 4096;
+
+struct alignas(RTE_CACHE_LINE_SIZE) sampler_lcore {
+    uint64_t skip = 0;      // Packets until the next sample of count and random sampling.
+    uint64_t pool = 0;      // Packets seen.
+    uint64_t samples = 0;
+    uint64_t drops = 0;
+};
+
+struct sampler_callback {
+    uint16_t port_id;
+    uint16_t queue_id;
+    const rte_eth_rxtx_callback *callback;
+};
+
+static packet_sample_mode sample_mode = packet_sample_mode::count;
+static uint32_t sampling_rate = 0;
+static uint64_t flow_threshold = 0;
+static rte_ring *sample_ring = nullptr;
+static sampler_lcore lcores[RTE_MAX_LCORE];
+static std::vector<sampler_callback> callbacks;
+
+bool packet_sampler_parse(const char *arg, packet_sample_mode &mode, uint32_t &rate)
+{
+    const char *separator = strchr(arg, ':');
+    if (separator == nullptr) {
+        return false;
+    }
+
+    const std::string name(arg, separator - arg);
+    if (name == "count") {
+        mode = packet_sample_mode::count;
+    } else if (name == "random") {
+        mode = packet_sample_mode::random;
+    } else if (name == "flow") {
+        mode = packet_sample_mode::flow;
+    } else {
+        return false;
+    }
+
+    char *end = nullptr;
+    rate = strtoul(separator + 1, &end, 10);
+    return *end == '\0' && rate != 0;
+}
+
+// Returns the distance to the next sample.
+static inline uint64_t next_skip()
+{
+    if (sample_mode == packet_sample_mode::random) {
+        return 1 + rte_rand_max(2 * static_cast<uint64_t>(sampling_rate) - 1);
+    }
+    return sampling_rate;
+}
+
+// Returns the sampled packets of up to 64 packets as a bit mask.
+static inline uint64_t select_packets(sampler_lcore &lcore, rte_mbuf **packets, uint16_t count)
+{
+    uint64_t mask = 0;
+    if (sample_mode == packet_sample_mode::flow) {
+        uint32_t hashes[64];
+        for (uint16_t i = 0; i < count; i++) {
+            hashes[i] = flow_key_packet_hash(packets[i]);
+        }
+        for (uint16_t i = 0; i < count; i++) {
+            mask |= static_cast<uint64_t>(hashes[i] < flow_threshold) << i;
+        }
+        return mask;
+    }
+
+    // One iteration per sample, not per packet.
+    while (lcore.skip < count) {
+        mask |= UINT64_C(1) << lcore.skip;
+        lcore.skip += next_skip();
+    }
+    lcore.skip -= count;
+    return mask;
+}
+
+// `pool` is the number of packets seen up to and including this one.
+static inline void copy_sample(packet_sample &sample, const rte_mbuf *packet, uint64_t pool, uint64_t drops)
+{
+    sample.tsc = packet_rx_tsc(packet);
+    sample.frame_length = packet->pkt_len;
+    sample.sample_pool = pool;
+    sample.drops = drops;
+    sample.sampling_rate = sampling_rate;
+    sample.port = packet->port;
+    sample.header_length = RTE_MIN(packet->data_len, static_cast<uint16_t>(packet_sample_header_size));
+    sample.reserved = 0;
+    memcpy(sample.header, rte_pktmbuf_mtod(packet, const uint8_t *), sample.header_length);
+}
+
+static uint16_t sample_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                                uint16_t max_packets, void *user_param)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (lcore_id >= RTE_MAX_LCORE) {
+        return count;
+    }
+
+    sampler_lcore &lcore = lcores[lcore_id];
+    packet_sample samples[64];
+    for (uint16_t first = 0; first < count; first += 64) {
+        const uint16_t chunk = RTE_MIN(count - first, 64);
+        uint64_t mask = select_packets(lcore, packets + first, chunk);
+
+        uint32_t sampled = 0;
+        while (mask != 0) {
+            const uint32_t i = __builtin_ctzll(mask);
+            mask &= mask - 1;
+            copy_sample(samples[sampled++], packets[first + i], lcore.pool + i + 1, lcore.drops);
+        }
+        lcore.pool += chunk;
+
+        if (sampled != 0) {
+            const uint32_t enqueued = rte_ring_mp_enqueue_burst_elem(sample_ring, samples, sizeof(packet_sample),
+                                                                     sampled, nullptr);
+            lcore.samples += enqueued;
+            lcore.drops += sampled - enqueued;
+        }
+    }
+    return count;
+}
+
+bool packet_sampler_create(packet_sample_mode mode, uint32_t rate)
+{
+    sample_mode = mode;
+    sampling_rate = rate;
+    // A flow is sampled if its hash is below 2^32 / N.
+    flow_threshold = (UINT64_C(1) << 32) / rate;
+
+    // The first sample of an lcore comes after a random distance, so the lcores do not sample in lockstep.
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        lcores[lcore_id] = {};
+        lcores[lcore_id].skip = rte_rand_max(rate);
+    }
+
+    sample_ring = rte_ring_create_elem("packet_samples", sizeof(packet_sample), sample_ring_size, rte_socket_id(),
+                                       RING_F_SC_DEQ);
+    if (sample_ring == nullptr) {
+        std::cerr << "Unable to create the sample ring. Error code: " << rte_errno << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool packet_sampler_add_port(uint16_t port_id, uint16_t rx_queues)
+{
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        const rte_eth_rxtx_callback *callback = rte_eth_add_rx_callback(port_id, i, sample_callback, nullptr);
+        if (callback == nullptr) {
+            std::cerr << "Unable to add the sampling callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+        callbacks.push_back({port_id, i, callback});
+    }
+    return true;
+}
+
+rte_ring *packet_sampler_ring()
+{
+    return sample_ring;
+}
+
+void packet_sampler_print_stats()
+{
+    if (sample_ring == nullptr) {
+        return;
+    }
+
+    sampler_lcore total;
+    for (const sampler_lcore &lcore : lcores) {
+        total.pool += lcore.pool;
+        total.samples += lcore.samples;
+        total.drops += lcore.drops;
+    }
+    std::cout << "Sampled packets: " << total.samples << " of " << total.pool << " (1 in " << sampling_rate
+              << ") Sample ring full: " << total.drops << std::endl;
+}
+
+void packet_sampler_free()
+{
+    if (sample_ring == nullptr) {
+        return;
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callbacks, they have no state of their own.
+    for (const sampler_callback &callback : callbacks) {
+        rte_eth_remove_rx_callback(callback.port_id, callback.queue_id, callback.callback);
+    }
+    callbacks.clear();
+
+    rte_ring_free(sample_ring);
+    sample_ring = nullptr;
+}
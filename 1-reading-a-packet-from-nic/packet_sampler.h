@@ -0,0 +1,83 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_ring.h>
+
+// Packet sampling. Instead of inspecting every packet, one in N packets is copied to the sample ring, from where the
+// sFlow exporter (see sflow_exporter.h) or any other analysis reads them. Three ways to choose the packets:
+//
+//   count  : every N-th packet of an lcore. Deterministic, but can alias with periodic traffic.
+//   random : the gaps between samples are random in [1, 2N - 1] (mean N), like sFlow agents do.
+//   flow   : all packets of 1 in N flows, chosen by the flow hash (see flow_key.h). Keeps whole flows, e.g. to follow
+//            TCP sessions, but the sampled share depends on the flow sizes.
+//
+// The sampling runs in an RX callback on every receive queue, so every mode samples without changes to its receive
+// loop. The decisions are made for the whole burst at once as a bit mask, without a branch per packet: for count and
+// random sampling the lcore keeps the distance to the next sample and sets one bit per sample, for flow sampling the
+// flow hashes are compared with a threshold in a loop the compiler vectorizes. Only the selected packets are touched
+// afterwards. A sample is a copy of the packet headers, so the mbuf is freed as usual.
+
+enum class packet_sample_mode {
+    count,
+    random,
+    flow
+};
+
+constexpr uint32_t packet_sample_header_size = 128;
+
+// One sampled packet in the sample ring.
+struct packet_sample {
+    uint64_t tsc;           // RX TSC of the packet.
+    uint32_t frame_length;  // Length of the packet.
+    uint32_t sample_pool;   // Packets the lcore saw until this sample, sampled or not.
+    uint32_t drops;         // Samples the lcore dropped because the sample ring was full.
+    uint32_t sampling_rate; // N.
+    uint16_t port;
+    uint16_t header_length; // Bytes in `header`.
+    uint32_t reserved;
+    uint8_t header[packet_sample_header_size];
+};
+
+static_assert(sizeof(packet_sample) % 4 == 0, "rte_ring elements must be a multiple of 4 bytes");
+
+// Parses "count:N", "random:N" or "flow:N". Returns false if the argument is invalid.
+bool packet_sampler_parse(const char *arg, packet_sample_mode &mode, uint32_t &rate);
+
+// Creates the sample ring. Returns false if the ring cannot be created.
+bool packet_sampler_create(packet_sample_mode mode, uint32_t rate);
+
+// Installs the sampling callback on the first `rx_queues` receive queues of a started port. Called after
+// rx_timestamp_start(), so the samples have the RX timestamp.
+bool packet_sampler_add_port(uint16_t port_id, uint16_t rx_queues);
+
+// Returns the ring of packet_sample elements. Multiple producers (the lcores), single consumer.
+rte_ring *packet_sampler_ring();
+
+// Prints the packets seen, sampled and dropped.
+void packet_sampler_print_stats();
+
+// Removes the callbacks and frees the ring. Called when no lcore receives and the consumer stopped. Does nothing if the
+// sampler was not created.
+void packet_sampler_free();
@@ -0,0 +1,145 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "pcapng_writer.h"
+
+#include <cstring>
+#include <ctime>
+#include <rte_cycles.h>
+
+constexpr uint32_t section_header_block = 0x0A0D0D0A;
+constexpr uint32_t interface_description_block = 0x00000001;
+constexpr uint32_t enhanced_packet_block = 0x00000006;
+constexpr uint32_t byte_order_magic = 0x1A2B3C4D;
+constexpr uint16_t linktype_ethernet = 1;
+constexpr uint16_t option_end = 0;
+constexpr uint16_t option_comment = 1;
+constexpr uint16_t option_if_tsresol = 9;
+
+static inline uint32_t pad4(uint32_t length)
+{
+    return (length + 3) & ~3U;
+}
+
+static void write_option(FILE *file, uint16_t code, const void *value, uint16_t length)
+{
+    static const uint8_t padding[4] = {0};
+    fwrite(&code, sizeof(code), 1, file);
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(value, 1, length, file);
+    fwrite(padding, 1, pad4(length) - length, file);
+}
+
+pcapng_writer *pcapng_open(const char *path, const char *comment, uint32_t snaplen)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        return nullptr;
+    }
+
+    // Section header block without options.
+    const uint32_t shb_length = 28;
+    const uint16_t version[2] = {1, 0};
+    const int64_t section_length = -1;
+    fwrite(&section_header_block, sizeof(uint32_t), 1, file);
+    fwrite(&shb_length, sizeof(uint32_t), 1, file);
+    fwrite(&byte_order_magic, sizeof(uint32_t), 1, file);
+    fwrite(version, sizeof(version), 1, file);
+    fwrite(&section_length, sizeof(section_length), 1, file);
+    fwrite(&shb_length, sizeof(uint32_t), 1, file);
+
+    // Interface description block with nanosecond timestamps (if_tsresol = 9) and an optional comment.
+    const uint16_t comment_length = (comment != nullptr) ? strlen(comment) : 0;
+    const uint32_t idb_length = 20 + 4 + 4 + (comment_length > 0 ? 4 + pad4(comment_length) : 0) + 4;
+    const uint16_t linktype[2] = {linktype_ethernet, 0};
+    const uint8_t tsresol = 9;
+    fwrite(&interface_description_block, sizeof(uint32_t), 1, file);
+    fwrite(&idb_length, sizeof(uint32_t), 1, file);
+    fwrite(linktype, sizeof(linktype), 1, file);
+    fwrite(&snaplen, sizeof(snaplen), 1, file);
+    write_option(file, option_if_tsresol, &tsresol, sizeof(tsresol));
+    if (comment_length > 0) {
+        write_option(file, option_comment, comment, comment_length);
+    }
+    write_option(file, option_end, nullptr, 0);
+    fwrite(&idb_length, sizeof(uint32_t), 1, file);
+
+    pcapng_writer *writer = new pcapng_writer();
+    writer->file = file;
+    writer->snaplen = snaplen;
+
+    timespec now = {};
+    clock_gettime(CLOCK_REALTIME, &now);
+    writer->base_tsc = rte_rdtsc();
+    writer->base_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+    return writer;
+}
+
+uint64_t pcapng_tsc_to_ns(const pcapng_writer *writer, uint64_t tsc)
+{
+    const uint64_t delta = tsc - writer->base_tsc;
+    const uint64_t hz = rte_get_tsc_hz();
+    return writer->base_ns + (delta / hz) * 1000000000ULL + (delta % hz) * 1000000000ULL / hz;
+}
+
+void pcapng_write_data(pcapng_writer *writer, const void *data, uint32_t length, uint32_t original_length, uint64_t timestamp_ns)
+{
+    static const uint8_t padding[4] = {0};
+    const uint32_t captured = RTE_MIN(length, writer->snaplen);
+    const uint32_t block_length = 32 + pad4(captured);
+    const uint32_t header[7] = {
+        enhanced_packet_block,
+        block_length,
+        0,                                              // Interface id.
+        static_cast<uint32_t>(timestamp_ns >> 32),
+        static_cast<uint32_t>(timestamp_ns),
+        captured,
+        original_length
+    };
+
+    fwrite(header, sizeof(header), 1, writer->file);
+    fwrite(data, 1, captured, writer->file);
+    fwrite(padding, 1, pad4(captured) - captured, writer->file);
+    fwrite(&block_length, sizeof(block_length), 1, writer->file);
+    writer->packets++;
+}
+
+void pcapng_write_packet(pcapng_writer *writer, const rte_mbuf *packet, uint64_t timestamp_ns)
+{
+    // rte_pktmbuf_read() returns a pointer into the packet if the bytes are in the first segment and copies them
+    // into `buffer` otherwise.
+    uint8_t buffer[RTE_MBUF_DEFAULT_DATAROOM];
+    const uint32_t length = RTE_MIN(RTE_MIN(packet->pkt_len, writer->snaplen), static_cast<uint32_t>(sizeof(buffer)));
+    const void *data = rte_pktmbuf_read(packet, 0, length, buffer);
+    if (data != nullptr) {
+        pcapng_write_data(writer, data, length, packet->pkt_len, timestamp_ns);
+    }
+}
+
+void pcapng_close(pcapng_writer *writer)
+{
+    if (writer == nullptr) {
+        return;
+    }
+    fclose(writer->file);
+    delete writer;
+}
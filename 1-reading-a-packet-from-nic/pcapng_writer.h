@@ -0,0 +1,55 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <rte_mbuf.h>
+
+// Minimal writer for pcapng capture files (https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html). A file
+// has one section header block, one Ethernet interface with nanosecond timestamps and one enhanced packet block per
+// packet. The files can be opened with Wireshark and tcpdump.
+struct pcapng_writer {
+    FILE *file = nullptr;
+    uint32_t snaplen = 0;
+    uint64_t packets = 0;
+
+    // TSC and wall clock time (ns since epoch) when the file was opened. Used to convert TSC values to timestamps.
+    uint64_t base_tsc = 0;
+    uint64_t base_ns = 0;
+};
+
+// Creates the capture file and writes the file headers. `comment` is stored in the interface description and can be
+// nullptr. Packets are truncated to `snaplen` bytes. Returns nullptr if the file cannot be created.
+pcapng_writer *pcapng_open(const char *path, const char *comment, uint32_t snaplen);
+
+// Converts a TSC value to nanoseconds since epoch.
+uint64_t pcapng_tsc_to_ns(const pcapng_writer *writer, uint64_t tsc);
+
+// Writes one packet (all segments, truncated to snaplen) with the given timestamp in nanoseconds since epoch.
+void pcapng_write_packet(pcapng_writer *writer, const rte_mbuf *packet, uint64_t timestamp_ns);
+
+// Writes one packet from a plain buffer. `original_length` is the length of the packet on the wire.
+void pcapng_write_data(pcapng_writer *writer, const void *data, uint32_t length, uint32_t original_length, uint64_t timestamp_ns);
+
+void pcapng_close(pcapng_writer *writer);
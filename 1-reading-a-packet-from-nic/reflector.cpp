@@ -0,0 +1,108 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "reflector.h"
+
+#include <iostream>
+#include <tmmintrin.h>
+#include <rte_ethdev.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+
+#include "app_telemetry.h"
+
+constexpr uint16_t reflector_burst_size = 32;
+
+// Offset of the IPv4 source address from the start of the packet. The 16 bytes starting here are the IPv4 source and
+// destination addresses followed by the first 8 bytes of the L4 header (source and destination port for UDP and TCP).
+constexpr uint16_t ipv4_addresses_offset = sizeof(rte_ether_hdr) + offsetof(rte_ipv4_hdr, src_addr);
+
+// The swaps below only exchange 16 bit words inside a header, so the ones' complement sums over the IPv4 header and
+// over the UDP/TCP pseudo header stay the same. That is why the checksums are still valid after the swap.
+static inline void swap_headers(rte_mbuf *packet)
+{
+    uint8_t *data = rte_pktmbuf_mtod(packet, uint8_t *);
+
+    // Ethernet: bytes 0-5 are the destination MAC and 6-11 the source MAC. Bytes 12-15 (ether type and first bytes
+    // of the next header) stay where they are. A single shuffle swaps both addresses.
+    const __m128i mac_swap = _mm_setr_epi8(6, 7, 8, 9, 10, 11, 0, 1, 2, 3, 4, 5, 12, 13, 14, 15);
+    __m128i eth = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data), _mm_shuffle_epi8(eth, mac_swap));
+
+    const rte_ether_hdr *eth_hdr = reinterpret_cast<const rte_ether_hdr *>(data);
+    const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(data + sizeof(rte_ether_hdr));
+    if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+        packet->data_len < ipv4_addresses_offset + sizeof(__m128i) ||
+        ipv4_hdr->ihl != RTE_IPV4_MIN_IHL) {
+        return;
+    }
+
+    // IPv4 + UDP/TCP: bytes 0-3 are the source address, 4-7 the destination address, 8-9 the source port and 10-11
+    // the destination port. For other protocols and for non-first fragments, whose bytes 8-11 are payload, only the
+    // addresses are swapped.
+    const __m128i l4_swap = _mm_setr_epi8(4, 5, 6, 7, 0, 1, 2, 3, 10, 11, 8, 9, 12, 13, 14, 15);
+    const __m128i ip_swap = _mm_setr_epi8(4, 5, 6, 7, 0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15);
+    const bool first_fragment = (ipv4_hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0;
+    const bool has_ports = first_fragment &&
+                           (ipv4_hdr->next_proto_id == IPPROTO_UDP || ipv4_hdr->next_proto_id == IPPROTO_TCP);
+
+    __m128i *addresses = reinterpret_cast<__m128i *>(data + ipv4_addresses_offset);
+    __m128i value = _mm_loadu_si128(addresses);
+    _mm_storeu_si128(addresses, _mm_shuffle_epi8(value, has_ports ? l4_swap : ip_swap));
+}
+
+void reflector_loop(uint16_t port_id, rx_pipeline &pipeline, const volatile sig_atomic_t &exit_indicator)
+{
+    rte_mbuf *packets[reflector_burst_size];
+    uint64_t reflected_packets = 0;
+    uint64_t dropped_packets = 0;
+
+    std::cout << "Reflecting packets on port Id: " << port_id << " ... " << std::endl;
+
+    // The loop never sleeps: an idle reflector would add the sleep time to the measured round trip time.
+    while (!exit_indicator) {
+        const uint16_t rx_packets = rx_pipeline_process(pipeline, packets,
+                                                        rte_eth_rx_burst(port_id, 0, packets, reflector_burst_size));
+        if (rx_packets == 0) {
+            continue;
+        }
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            if (i + 1 < rx_packets) {
+                rte_prefetch0(rte_pktmbuf_mtod(packets[i + 1], void *));
+            }
+            swap_headers(packets[i]);
+        }
+
+        // The packets go back on the same queue they came from. Whatever the NIC does not accept is freed.
+        const uint16_t tx_packets = rte_eth_tx_burst(port_id, 0, packets, rx_packets);
+        if (tx_packets < rx_packets) {
+            rte_pktmbuf_free_bulk(&packets[tx_packets], rx_packets - tx_packets);
+            dropped_packets += rx_packets - tx_packets;
+            app_telemetry_queue_drop(rx_packets - tx_packets);
+        }
+        reflected_packets += tx_packets;
+    }
+
+    std::cout << "Reflected packets: " << reflected_packets << " TX dropped: " << dropped_packets << std::endl;
+}
@@ -0,0 +1,134 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "reorder_stage.h"
+
+#include <cerrno>
+#include <iostream>
+#include <rte_errno.h>
+#include <rte_malloc.h>
+#include <rte_reorder.h>
+
+#include "app_telemetry.h"
+#include "packet_metadata.h"
+
+struct reorder_stage {
+    rte_reorder_buffer *buffer;
+    uint32_t buffer_size;
+    uint32_t next_seqn;
+    bool retry_pending;             // The first packet of the next insert did not fit before the buffer was drained.
+
+    uint64_t inserted;
+    uint64_t drained;
+    uint64_t late_dropped;          // Came back after the buffer moved past them.
+    uint64_t overflow_dropped;      // Too far ahead of the oldest missing packet.
+};
+
+reorder_stage *reorder_stage_create(uint32_t buffer_size, int32_t socket_id)
+{
+    reorder_stage *stage = static_cast<reorder_stage *>(rte_zmalloc_socket("reorder_stage", sizeof(reorder_stage), 0, socket_id));
+    if (stage == nullptr) {
+        std::cerr << "Unable to allocate the reorder stage" << std::endl;
+        return nullptr;
+    }
+
+    // rte_reorder_create() also registers the sequence number dynamic field of the mbuf.
+    stage->buffer = rte_reorder_create("reorder_buffer", socket_id, buffer_size);
+    if (stage->buffer == nullptr) {
+        std::cerr << "Unable to create a reorder buffer of " << buffer_size << " packets. Error code: " << rte_errno << std::endl;
+        rte_free(stage);
+        return nullptr;
+    }
+
+    // Without an explicit start the buffer starts at the sequence number of the first inserted packet, which is not
+    // necessarily the first received packet.
+    rte_reorder_min_seqn_set(stage->buffer, 0);
+    stage->buffer_size = buffer_size;
+    return stage;
+}
+
+void reorder_stage_free(reorder_stage *stage)
+{
+    if (stage == nullptr) {
+        return;
+    }
+
+    // rte_reorder_free() also frees the packets which are still in the buffer.
+    rte_reorder_free(stage->buffer);
+    rte_free(stage);
+}
+
+void reorder_stage_stamp(reorder_stage *stage, rte_mbuf **packets, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        packet_set_sequence(packets[i], stage->next_seqn++);
+    }
+}
+
+uint16_t reorder_stage_insert(reorder_stage *stage, rte_mbuf **packets, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++) {
+        if (rte_reorder_insert(stage->buffer, packets[i]) == 0) {
+            stage->inserted++;
+            stage->retry_pending = false;
+            continue;
+        }
+
+        // ENOSPC means the packets in sequence order fill the buffer. Draining them makes room, so the packet is handed
+        // back once and only dropped if it still does not fit after the drain.
+        if (rte_errno == ENOSPC && !stage->retry_pending) {
+            stage->retry_pending = true;
+            return i;
+        }
+
+        if (rte_errno == ERANGE) {
+            stage->late_dropped++;
+        } else {
+            stage->overflow_dropped++;
+        }
+        app_telemetry_queue_drop(1);
+        rte_pktmbuf_free(packets[i]);
+        stage->retry_pending = false;
+    }
+    return count;
+}
+
+uint16_t reorder_stage_drain(reorder_stage *stage, rte_mbuf **packets, uint16_t max_count)
+{
+    const uint16_t count = rte_reorder_drain(stage->buffer, packets, max_count);
+    stage->drained += count;
+    return count;
+}
+
+uint16_t reorder_stage_flush(reorder_stage *stage, rte_mbuf **packets, uint16_t max_count)
+{
+    const uint16_t count = rte_reorder_drain_up_to_seqn(stage->buffer, packets, max_count, stage->next_seqn);
+    stage->drained += count;
+    return count;
+}
+
+void reorder_stage_print_stats(const reorder_stage *stage)
+{
+    std::cout << "Reorder buffer size: " << stage->buffer_size << " Inserted: " << stage->inserted
+              << " Drained: " << stage->drained << " Late dropped: " << stage->late_dropped
+              << " Overflow dropped: " << stage->overflow_dropped << std::endl;
+}
@@ -0,0 +1,61 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mbuf.h>
+
+// Reorder stage. When the packets of a burst are processed by several worker lcores, they come back in a different
+// order than they were received. The RX lcore stamps every packet with a sequence number (the sequence field of the
+// packet metadata, which rte_reorder reads as well) and the reorder stage puts the packets back into sequence order with a reorder buffer (rte_reorder)
+// before they are transmitted or captured.
+//
+// The reorder buffer holds `buffer_size` packets. A packet which comes back after the buffer has already moved past
+// its sequence number is late and dropped. A packet which is too far ahead of the oldest missing packet is dropped
+// when the buffer cannot make room for it, even after the packets in sequence order were drained.
+
+struct reorder_stage;
+
+// Creates a reorder stage with a buffer of `buffer_size` packets. `buffer_size` must be a power of 2. Returns nullptr
+// if the buffer cannot be created.
+reorder_stage *reorder_stage_create(uint32_t buffer_size, int32_t socket_id);
+
+void reorder_stage_free(reorder_stage *stage);
+
+// Stamps the packets with consecutive sequence numbers. Called on the RX lcore in receive order.
+void reorder_stage_stamp(reorder_stage *stage, rte_mbuf **packets, uint16_t count);
+
+// Inserts packets which came back from the workers. Late packets and packets which do not fit are freed and counted.
+// Returns the number of packets consumed. If it is less than `count` the buffer is full of packets in sequence order:
+// the caller drains it and passes the remaining packets again.
+uint16_t reorder_stage_insert(reorder_stage *stage, rte_mbuf **packets, uint16_t count);
+
+// Moves up to `max_count` packets which are in sequence order to `packets`. Returns the number of packets.
+uint16_t reorder_stage_drain(reorder_stage *stage, rte_mbuf **packets, uint16_t max_count);
+
+// Moves up to `max_count` of all the packets still in the buffer to `packets`, skipping the missing sequence numbers.
+// Used at exit when no more packets come back.
+uint16_t reorder_stage_flush(reorder_stage *stage, rte_mbuf **packets, uint16_t max_count);
+
+// Prints the buffer size and the inserted, drained, late and overflow dropped packets.
+void reorder_stage_print_stats(const reorder_stage *stage);
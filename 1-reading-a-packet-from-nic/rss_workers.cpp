@@ -0,0 +1,90 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "rss_workers.h"
+
+#include <iostream>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+
+#include "app_telemetry.h"
+#include "worker_stats.h"
+
+constexpr uint16_t rss_burst_size = 32;
+
+struct rss_worker_context {
+    uint16_t port_id;
+    uint16_t queue_id;
+    uint64_t work_cycles;
+    worker_stats *stats;
+    const volatile sig_atomic_t *exit_indicator;
+};
+
+static int rss_worker(void *arg)
+{
+    const rss_worker_context *context = static_cast<const rss_worker_context *>(arg);
+    worker_stats &stats = *context->stats;
+    rte_mbuf *packets[rss_burst_size];
+
+    const uint64_t start = rte_rdtsc();
+    while (!*context->exit_indicator) {
+        const uint16_t count = rte_eth_rx_burst(context->port_id, context->queue_id, packets, rss_burst_size);
+        app_telemetry_poll(count);
+        if (count == 0) {
+            continue;
+        }
+
+        // With software RX timestamps the time the packets waited in the receive ring is not part of the latency;
+        // packets which did not fit into the ring show up as RX missed. Hardware RX timestamps include it.
+        worker_process_burst(stats, packets, count, context->work_cycles);
+        rte_pktmbuf_free_bulk(packets, count);
+    }
+    stats.total_cycles = rte_rdtsc() - start;
+
+    return 0;
+}
+
+bool rss_workers_loop(uint16_t port_id, uint64_t work_cycles, const volatile sig_atomic_t &exit_indicator)
+{
+    if (rte_lcore_count() < 2) {
+        std::cerr << "RSS mode needs at least one worker lcore. Pass more lcores with the -l EAL argument." << std::endl;
+        return false;
+    }
+
+    static rss_worker_context contexts[RTE_MAX_LCORE];
+    uint16_t queue_id = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        contexts[lcore_id] = {port_id, queue_id++, work_cycles, &lcore_worker_stats[lcore_id], &exit_indicator};
+        rte_eal_remote_launch(rss_worker, &contexts[lcore_id], lcore_id);
+    }
+
+    std::cout << "Receiving packets on port Id: " << port_id << " with " << queue_id << " RSS queues ... " << std::endl;
+    rte_eal_mp_wait_lcore();
+
+    rte_eth_stats port_stats = {};
+    rte_eth_stats_get(port_id, &port_stats);
+    std::cout << "RX missed: " << port_stats.imissed << std::endl;
+    worker_stats_print(lcore_worker_stats, RTE_MAX_LCORE);
+    return true;
+}
@@ -0,0 +1,38 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+
+// RSS mode. The port has one receive queue per worker lcore and the NIC spreads the flows over the queues with receive
+// side scaling (RSS). Every worker polls its own queue. The mapping of a flow to a worker is static: a few large
+// (elephant) flows which hash to the same queue overload that worker while the other workers stay idle.
+//
+// This is the baseline for the eventdev mode (see eventdev_pipeline.h). The ACL stage is not supported in this mode
+// as the ACL classifier allows only one classifying lcore.
+
+// Runs the RSS mode until `exit_indicator` is set. `port_id` must be configured with one receive queue per worker
+// lcore and started. Every worker spends `work_cycles` per packet to emulate application processing. Returns false if
+// there is no worker lcore.
+bool rss_workers_loop(uint16_t port_id, uint64_t work_cycles, const volatile sig_atomic_t &exit_indicator);
@@ -0,0 +1,392 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "rx_graph.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_graph.h>
+#include <rte_graph_worker.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_mbuf_ptype.h>
+#include <rte_prefetch.h>
+
+#include "app_telemetry.h"
+#include "packet_metadata.h"
+#include "pcapng_writer.h"
+#include "rx_timestamp.h"
+
+// Edges of the nodes which can drop packets. Edge 0 is always the next processing node.
+enum : rte_edge_t {
+    next_edge = 0,
+    drop_edge = 1
+};
+
+// The nodes are process functions without a context argument, so the state they share lives here. There is only one
+// graph per process.
+static struct {
+    uint16_t rx_port = 0;
+    uint16_t tx_port = 0;
+    acl_classifier *acl = nullptr;
+    pcapng_writer *capture = nullptr;
+
+    uint64_t counted_packets = 0;
+    uint64_t counted_bytes = 0;
+    uint64_t dropped_packets = 0;
+    uint64_t tx_dropped = 0;
+} graph_state;
+
+// Hands the burst to the next nodes. Runs of packets with the same next node are enqueued with a single call. If the
+// whole burst goes to the same node, the burst is moved to that node without copying the object pointers.
+static inline void enqueue_by_next(rte_graph *graph, rte_node *node, void **objs, const rte_edge_t *nexts, uint16_t count)
+{
+    uint16_t start = 0;
+    for (uint16_t i = 1; i <= count; i++) {
+        if (i < count && nexts[i] == nexts[start]) {
+            continue;
+        }
+        if (start == 0 && i == count) {
+            rte_node_next_stream_move(graph, node, nexts[0]);
+            return;
+        }
+        rte_node_enqueue(graph, node, nexts[start], &objs[start], i - start);
+        start = i;
+    }
+}
+
+static uint16_t rx_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    RTE_SET_USED(objs);
+    RTE_SET_USED(nb_objs);
+
+    // The source node receives directly into its own object array and moves it to the next node.
+    const uint16_t rx_packets = rte_eth_rx_burst(graph_state.rx_port, 0, reinterpret_cast<rte_mbuf **>(node->objs), RTE_GRAPH_BURST_SIZE);
+    app_telemetry_poll(rx_packets);
+    if (rx_packets == 0) {
+        return 0;
+    }
+
+    node->idx = rx_packets;
+    rte_node_next_stream_move(graph, node, next_edge);
+    return rx_packets;
+}
+
+static uint16_t parse_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    rte_edge_t nexts[RTE_GRAPH_BURST_SIZE];
+    rte_mbuf **packets = reinterpret_cast<rte_mbuf **>(objs);
+
+    for (uint16_t i = 0; i < nb_objs; i++) {
+        if (i + 4 < nb_objs) {
+            rte_prefetch0(rte_pktmbuf_mtod(packets[i + 4], void *));
+        }
+
+        rte_mbuf *packet = packets[i];
+        const rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packet, const rte_ether_hdr *);
+        nexts[i] = next_edge;
+        packet->l2_len = sizeof(rte_ether_hdr);
+
+        if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+            const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(eth_hdr + 1);
+            if (packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) ||
+                packet->data_len < sizeof(rte_ether_hdr) + rte_ipv4_hdr_len(ipv4_hdr)) {
+                nexts[i] = drop_edge;
+                continue;
+            }
+            packet->l3_len = rte_ipv4_hdr_len(ipv4_hdr);
+            packet->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4_EXT_UNKNOWN;
+        } else if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6)) {
+            if (packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv6_hdr)) {
+                nexts[i] = drop_edge;
+                continue;
+            }
+            packet->l3_len = sizeof(rte_ipv6_hdr);
+            packet->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV6_EXT_UNKNOWN;
+        } else {
+            packet->packet_type = RTE_PTYPE_L2_ETHER;
+        }
+    }
+
+    enqueue_by_next(graph, node, objs, nexts, nb_objs);
+    return nb_objs;
+}
+
+static uint16_t classify_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    if (graph_state.acl == nullptr) {
+        rte_node_next_stream_move(graph, node, next_edge);
+        return nb_objs;
+    }
+
+    uint32_t actions[RTE_GRAPH_BURST_SIZE];
+    rte_edge_t nexts[RTE_GRAPH_BURST_SIZE];
+    acl_classify_burst(graph_state.acl, reinterpret_cast<rte_mbuf **>(objs), nb_objs, actions);
+
+    for (uint16_t i = 0; i < nb_objs; i++) {
+        packet_set_class_id(reinterpret_cast<rte_mbuf *>(objs[i]), actions[i]);
+        nexts[i] = (actions[i] == acl_deny) ? drop_edge : next_edge;
+    }
+
+    enqueue_by_next(graph, node, objs, nexts, nb_objs);
+    return nb_objs;
+}
+
+static uint16_t count_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    RTE_SET_USED(graph);
+    RTE_SET_USED(node);
+
+    rte_mbuf **packets = reinterpret_cast<rte_mbuf **>(objs);
+    for (uint16_t i = 0; i < nb_objs; i++) {
+        graph_state.counted_bytes += packets[i]->pkt_len;
+    }
+    graph_state.counted_packets += nb_objs;
+
+    rte_pktmbuf_free_bulk(packets, nb_objs);
+    return nb_objs;
+}
+
+static uint16_t capture_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    RTE_SET_USED(graph);
+    RTE_SET_USED(node);
+
+    // The packets are written with the time they were received, not the time they reached this node.
+    rte_mbuf **packets = reinterpret_cast<rte_mbuf **>(objs);
+    for (uint16_t i = 0; i < nb_objs; i++) {
+        pcapng_write_packet(graph_state.capture, packets[i], pcapng_tsc_to_ns(graph_state.capture, packet_rx_tsc(packets[i])));
+    }
+
+    rte_pktmbuf_free_bulk(packets, nb_objs);
+    return nb_objs;
+}
+
+static uint16_t forward_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    RTE_SET_USED(graph);
+    RTE_SET_USED(node);
+
+    rte_mbuf **packets = reinterpret_cast<rte_mbuf **>(objs);
+    uint16_t sent = 0;
+    while (sent < nb_objs) {
+        const uint16_t tx_packets = rte_eth_tx_burst(graph_state.tx_port, 0, &packets[sent], nb_objs - sent);
+        if (tx_packets == 0) {
+            break;
+        }
+        sent += tx_packets;
+    }
+
+    if (sent < nb_objs) {
+        rte_pktmbuf_free_bulk(&packets[sent], nb_objs - sent);
+        graph_state.tx_dropped += nb_objs - sent;
+        app_telemetry_queue_drop(nb_objs - sent);
+    }
+    return nb_objs;
+}
+
+static uint16_t drop_node_process(rte_graph *graph, rte_node *node, void **objs, uint16_t nb_objs)
+{
+    RTE_SET_USED(graph);
+    RTE_SET_USED(node);
+
+    graph_state.dropped_packets += nb_objs;
+    rte_pktmbuf_free_bulk(reinterpret_cast<rte_mbuf **>(objs), nb_objs);
+    return nb_objs;
+}
+
+// Registers a node. The nodes are registered at run time (instead of with RTE_NODE_REGISTER) because their edges
+// depend on which nodes the user enabled. rte_graph copies the registration, so it is freed again.
+static bool register_node(const char *name, uint64_t flags, rte_node_process_t process,
+                          std::initializer_list<const char *> next_nodes)
+{
+    const size_t size = sizeof(rte_node_register) + next_nodes.size() * sizeof(const char *);
+    rte_node_register *reg = static_cast<rte_node_register *>(calloc(1, size));
+    if (reg == nullptr) {
+        return false;
+    }
+
+    snprintf(reg->name, sizeof(reg->name), "%s", name);
+    reg->flags = flags;
+    reg->process = process;
+    reg->nb_edges = next_nodes.size();
+    rte_edge_t edge = 0;
+    for (const char *next_node : next_nodes) {
+        reg->next_nodes[edge++] = next_node;
+    }
+
+    const rte_node_t id = __rte_node_register(reg);
+    free(reg);
+    if (id == RTE_NODE_ID_INVALID) {
+        std::cerr << "Unable to register graph node " << name << ". Error code: " << rte_errno << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Registers the enabled nodes and connects them in the order rx -> parse -> classify -> action.
+static bool register_nodes(const rx_graph_options &options)
+{
+    const char *action_node = "app_count";
+    rte_node_process_t action_process = count_node_process;
+    if (options.action == rx_graph_action::capture) {
+        action_node = "app_capture";
+        action_process = capture_node_process;
+    } else if (options.action == rx_graph_action::forward) {
+        action_node = "app_forward";
+        action_process = forward_node_process;
+    }
+
+    const char *classify_next = action_node;
+    const char *parse_next = options.classify ? "app_classify" : classify_next;
+    const char *rx_next = options.parse ? "app_parse" : parse_next;
+
+    return register_node("app_drop", 0, drop_node_process, {}) &&
+           register_node(action_node, 0, action_process, {}) &&
+           (!options.classify || register_node("app_classify", 0, classify_node_process, {classify_next, "app_drop"})) &&
+           (!options.parse || register_node("app_parse", 0, parse_node_process, {parse_next, "app_drop"})) &&
+           register_node("app_rx", RTE_NODE_SOURCE_FLAG, rx_node_process, {rx_next});
+}
+
+bool rx_graph_parse_nodes(const char *list, rx_graph_options &options)
+{
+    options.parse = false;
+    options.classify = false;
+    uint32_t actions = 0;
+
+    std::string nodes(list);
+    size_t start = 0;
+    while (start <= nodes.size()) {
+        size_t end = nodes.find(',', start);
+        if (end == std::string::npos) {
+            end = nodes.size();
+        }
+        const std::string node = nodes.substr(start, end - start);
+        start = end + 1;
+
+        if (node == "parse") {
+            options.parse = true;
+        } else if (node == "classify") {
+            options.classify = true;
+        } else if (node == "count") {
+            options.action = rx_graph_action::count;
+            actions++;
+        } else if (node == "capture") {
+            options.action = rx_graph_action::capture;
+            actions++;
+        } else if (node == "forward") {
+            options.action = rx_graph_action::forward;
+            actions++;
+        } else if (!node.empty()) {
+            std::cerr << "Unknown graph node: " << node << std::endl;
+            return false;
+        }
+    }
+
+    if (actions > 1) {
+        std::cerr << "Only one of count, capture and forward can be enabled" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool rx_graph_loop(uint16_t rx_port, uint16_t tx_port, const rx_graph_options &options, rx_pipeline &pipeline,
+                   const volatile sig_atomic_t &exit_indicator)
+{
+    graph_state.rx_port = rx_port;
+    graph_state.tx_port = tx_port;
+    graph_state.acl = pipeline.acl;
+
+    if (options.action == rx_graph_action::capture) {
+        const std::string comment = std::string("RX timestamps: ") + rx_timestamp_source_name(rx_port);
+        graph_state.capture = pcapng_open(options.capture_file, comment.c_str(), RTE_MBUF_DEFAULT_DATAROOM);
+        if (graph_state.capture == nullptr) {
+            std::cerr << "Unable to create capture file: " << options.capture_file << std::endl;
+            return false;
+        }
+    }
+
+    if (!register_nodes(options)) {
+        pcapng_close(graph_state.capture);
+        return false;
+    }
+
+    // Nodes reachable over the edges of app_rx are added to the graph automatically.
+    const char *node_patterns[] = {"app_rx"};
+    rte_graph_param graph_param = {};
+    graph_param.socket_id = rte_socket_id();
+    graph_param.nb_node_patterns = 1;
+    graph_param.node_patterns = node_patterns;
+
+    const rte_graph_t graph_id = rte_graph_create("app_graph", &graph_param);
+    rte_graph *graph = (graph_id != RTE_GRAPH_ID_INVALID) ? rte_graph_lookup("app_graph") : nullptr;
+    if (graph == nullptr) {
+        std::cerr << "Unable to create the graph. Error code: " << rte_errno << std::endl;
+        pcapng_close(graph_state.capture);
+        return false;
+    }
+
+    // rte_graph collects the calls, objects and cycles of every node. The cluster statistics print them as a table.
+    const char *graph_patterns[] = {"app_graph"};
+    rte_graph_cluster_stats_param stats_param = {};
+    stats_param.socket_id = rte_socket_id();
+    stats_param.f = stdout;
+    stats_param.nb_graph_patterns = 1;
+    stats_param.graph_patterns = graph_patterns;
+    rte_graph_cluster_stats *stats = rte_graph_cluster_stats_create(&stats_param);
+
+    std::cout << "Walking the packet graph for port Id: " << rx_port << " ... " << std::endl;
+    rte_graph_dump(stdout, graph_id);
+
+    const uint64_t stats_interval_cycles = rte_get_tsc_hz() * options.stats_interval_s;
+    uint64_t last_stats_cycles = rte_rdtsc();
+
+    while (!exit_indicator) {
+        rte_graph_walk(graph);
+
+        if (stats != nullptr && stats_interval_cycles > 0 && rte_rdtsc() - last_stats_cycles > stats_interval_cycles) {
+            rte_graph_cluster_stats_get(stats, false);
+            last_stats_cycles = rte_rdtsc();
+        }
+    }
+
+    if (stats != nullptr) {
+        rte_graph_cluster_stats_get(stats, false);
+        rte_graph_cluster_stats_destroy(stats);
+    }
+    rte_graph_destroy(graph_id);
+
+    std::cout << "Counted packets: " << graph_state.counted_packets << " bytes: " << graph_state.counted_bytes
+              << " Dropped packets: " << graph_state.dropped_packets << " TX dropped: " << graph_state.tx_dropped << std::endl;
+    if (graph_state.capture != nullptr) {
+        std::cout << "Captured packets: " << graph_state.capture->packets << " to " << options.capture_file << std::endl;
+        pcapng_close(graph_state.capture);
+        graph_state.capture = nullptr;
+    }
+    return true;
+}
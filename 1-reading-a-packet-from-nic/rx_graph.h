@@ -0,0 +1,70 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+
+#include "rx_pipeline.h"
+
+// Graph mode. The receive processing is split into nodes of a DPDK packet graph (rte_graph):
+//
+//   app_rx -> app_parse -> app_classify -> app_count | app_capture | app_forward
+//                  \              \
+//                   +--------------+-----> app_drop
+//
+// app_rx      : receives a burst from queue 0 of the RX port.
+// app_parse   : checks the Ethernet / IPv4 / IPv6 headers and fills l2_len, l3_len and packet_type of the mbuf.
+//               Truncated packets go to app_drop.
+// app_classify: classifies the packets with the ACL rules (--acl-rules). Denied packets go to app_drop.
+// app_count   : counts and frees the packets.
+// app_capture : writes the packets to a pcapng file and frees them.
+// app_forward : transmits the packets on queue 0 of the TX port.
+// app_drop    : counts and frees the packets.
+//
+// Every node processes a whole burst per call. A node sends runs of packets with the same next node with a single
+// enqueue, and when the whole burst goes to the same node the burst is handed over without copying. A new stage is
+// added by registering a new node and putting it on an edge, the batching stays the same.
+
+enum class rx_graph_action {
+    count,
+    capture,
+    forward
+};
+
+struct rx_graph_options {
+    bool parse = true;                                  // Include the app_parse node.
+    bool classify = true;                               // Include the app_classify node.
+    rx_graph_action action = rx_graph_action::count;    // The node which handles the accepted packets.
+    const char *capture_file = "capture.pcapng";
+    uint32_t stats_interval_s = 5;                      // Print the node statistics every N seconds. 0 disables.
+};
+
+// Parses a comma separated list of nodes, e.g. "parse,classify,forward". app_rx and app_drop are always included.
+// Returns false if a node is unknown or more than one of count, capture and forward is given.
+bool rx_graph_parse_nodes(const char *list, rx_graph_options &options);
+
+// Builds the graph and walks it until `exit_indicator` is set. The classify node uses the ACL classifier of
+// `pipeline`. Returns false if the graph cannot be built.
+bool rx_graph_loop(uint16_t rx_port, uint16_t tx_port, const rx_graph_options &options, rx_pipeline &pipeline,
+                   const volatile sig_atomic_t &exit_indicator);
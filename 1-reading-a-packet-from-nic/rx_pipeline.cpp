@@ -0,0 +1,83 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "rx_pipeline.h"
+
+#include <iostream>
+
+#include "app_telemetry.h"
+#include "packet_metadata.h"
+
+uint16_t rx_pipeline_process(rx_pipeline &pipeline, rte_mbuf **packets, uint16_t count)
+{
+    app_telemetry_poll(count);
+
+    // Called on every poll, also without packets, so that the lcore reports its quiescent state to blocklist reloads.
+    if (pipeline.blocklist != nullptr) {
+        bool blocked[rx_pipeline_max_burst];
+        if (ip_blocklist_lookup_burst(pipeline.blocklist, packets, count, blocked) > 0) {
+            uint16_t kept = 0;
+            for (uint16_t i = 0; i < count; i++) {
+                if (blocked[i]) {
+                    rte_pktmbuf_free(packets[i]);
+                    pipeline.blocklist_dropped++;
+                    continue;
+                }
+                packets[kept++] = packets[i];
+            }
+            app_telemetry_drop(count - kept);
+            count = kept;
+        }
+    }
+
+    if (pipeline.acl != nullptr && count > 0) {
+        uint32_t actions[rx_pipeline_max_burst];
+        acl_classify_burst(pipeline.acl, packets, count, actions);
+
+        uint16_t kept = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            packet_set_class_id(packets[i], actions[i]);
+            if (actions[i] == acl_deny) {
+                rte_pktmbuf_free(packets[i]);
+                pipeline.acl_denied++;
+                continue;
+            }
+            packets[kept++] = packets[i];
+        }
+        app_telemetry_drop(count - kept);
+        count = kept;
+    }
+
+    return count;
+}
+
+void rx_pipeline_print_stats(const rx_pipeline &pipeline)
+{
+    if (pipeline.blocklist != nullptr) {
+        ip_blocklist_print_stats(pipeline.blocklist);
+        std::cout << "Blocklist dropped packets: " << pipeline.blocklist_dropped << std::endl;
+    }
+    if (pipeline.acl != nullptr) {
+        acl_classifier_print_stats(pipeline.acl);
+        std::cout << "ACL denied packets: " << pipeline.acl_denied << std::endl;
+    }
+}
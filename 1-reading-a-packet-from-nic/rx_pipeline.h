@@ -0,0 +1,51 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mbuf.h>
+
+#include "acl_classifier.h"
+#include "ip_blocklist.h"
+
+constexpr uint16_t rx_pipeline_max_burst = 64;
+
+// The processing stages which every mode runs on the received packets before it handles them. A stage can drop
+// packets from the burst. Stages which are not enabled (nullptr) cost nothing. The stages store their results in the
+// packet metadata (see packet_metadata.h), e.g. the ACL action. The RX TSC is already set by the RX timestamp
+// callback (see rx_timestamp.h).
+struct rx_pipeline {
+    ip_blocklist *blocklist = nullptr;  // Drops the packets from blocked source addresses. Runs first.
+    acl_classifier *acl = nullptr;      // Drops the packets denied by the ACL rules.
+
+    uint64_t blocklist_dropped = 0;
+    uint64_t acl_denied = 0;
+};
+
+// Runs the enabled stages on a burst of received packets. Dropped packets are freed and the remaining packets are
+// moved to the front of `packets`, keeping their order. Returns the number of remaining packets. `count` must not
+// exceed rx_pipeline_max_burst.
+uint16_t rx_pipeline_process(rx_pipeline &pipeline, rte_mbuf **packets, uint16_t count);
+
+// Prints the statistics of the enabled stages.
+void rx_pipeline_print_stats(const rx_pipeline &pipeline);
@@ -0,0 +1,232 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "rx_timestamp.h"
+
+#include <iostream>
+#include <rte_cycles.h>
+#include <rte_errno.h>
+#include <rte_ethdev.h>
+#include <rte_malloc.h>
+#include <rte_mbuf_dyn.h>
+
+#include "packet_metadata.h"
+
+// Counters of one receive queue. Only the lcore which polls the queue writes them.
+struct alignas(RTE_CACHE_LINE_SIZE) rx_timestamp_queue {
+    const struct rx_timestamp_port *port;
+    const rte_eth_rxtx_callback *callback;
+    uint64_t hardware_packets;
+    uint64_t software_packets;
+};
+
+struct rx_timestamp_port {
+    rx_timestamp_source source = rx_timestamp_source::software;
+    uint16_t rx_queues = 0;
+    rx_timestamp_queue *queues = nullptr;
+
+    // Timestamp field which the NIC driver writes.
+    int32_t hardware_offset = -1;
+    uint64_t hardware_flag = 0;
+
+    // Calibration: NIC clock value `base_clock` was read at TSC `base_tsc`, one NIC clock tick is `tsc_per_tick` cycles.
+    uint64_t base_clock = 0;
+    uint64_t base_tsc = 0;
+    double tsc_per_tick = 0;
+    uint64_t clock_hz = 0;
+};
+
+static rx_timestamp_port ports[RTE_MAX_ETHPORTS];
+
+static uint16_t software_timestamp_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                                            uint16_t max_packets, void *user_param)
+{
+    rx_timestamp_queue *queue = static_cast<rx_timestamp_queue *>(user_param);
+
+    // One TSC read per burst. The packets of a burst arrived within the same poll.
+    const uint64_t now = rte_rdtsc();
+    for (uint16_t i = 0; i < count; i++) {
+        packet_set_rx_tsc(packets[i], now);
+    }
+    queue->software_packets += count;
+
+    return count;
+}
+
+static uint16_t hardware_timestamp_callback(uint16_t port_id, uint16_t queue_id, rte_mbuf **packets, uint16_t count,
+                                            uint16_t max_packets, void *user_param)
+{
+    rx_timestamp_queue *queue = static_cast<rx_timestamp_queue *>(user_param);
+    const rx_timestamp_port &port = *queue->port;
+    uint64_t now = 0;
+
+    for (uint16_t i = 0; i < count; i++) {
+        if (packets[i]->ol_flags & port.hardware_flag) {
+            // The difference is signed: a packet can carry a timestamp from before the calibration.
+            const int64_t ticks = static_cast<int64_t>(*RTE_MBUF_DYNFIELD(packets[i], port.hardware_offset, rte_mbuf_timestamp_t *) -
+                                                       port.base_clock);
+            packet_set_rx_tsc(packets[i], port.base_tsc + static_cast<int64_t>(ticks * port.tsc_per_tick));
+            queue->hardware_packets++;
+        } else {
+            // Some NICs do not timestamp every packet type. Those packets get the TSC.
+            if (now == 0) {
+                now = rte_rdtsc();
+            }
+            packet_set_rx_tsc(packets[i], now);
+            queue->software_packets++;
+        }
+    }
+
+    return count;
+}
+
+uint64_t rx_timestamp_offloads(uint16_t port_id, bool allow_hardware)
+{
+    rte_eth_dev_info dev_info = {};
+    if (!allow_hardware || rte_eth_dev_info_get(port_id, &dev_info) != 0) {
+        return 0;
+    }
+
+    return dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+}
+
+// Measures the NIC clock against the TSC over 100ms. Returns false if the NIC clock cannot be read.
+static bool calibrate_clock(uint16_t port_id, rx_timestamp_port &port)
+{
+    uint64_t start_clock = 0;
+    uint64_t end_clock = 0;
+    const uint64_t start_tsc = rte_rdtsc();
+    if (rte_eth_read_clock(port_id, &start_clock) != 0) {
+        return false;
+    }
+
+    rte_delay_ms(100);
+
+    const uint64_t end_tsc = rte_rdtsc();
+    if (rte_eth_read_clock(port_id, &end_clock) != 0 || end_clock <= start_clock) {
+        return false;
+    }
+
+    port.base_clock = end_clock;
+    port.base_tsc = end_tsc;
+    port.tsc_per_tick = static_cast<double>(end_tsc - start_tsc) / (end_clock - start_clock);
+    port.clock_hz = rte_get_tsc_hz() / port.tsc_per_tick;
+    return true;
+}
+
+bool rx_timestamp_start(uint16_t port_id, uint16_t rx_queues)
+{
+    rx_timestamp_port &port = ports[port_id];
+    port.source = rx_timestamp_source::software;
+
+    rte_eth_conf conf = {};
+    const bool offload_enabled = (rte_eth_dev_conf_get(port_id, &conf) == 0) &&
+                                 (conf.rxmode.offloads & RTE_ETH_RX_OFFLOAD_TIMESTAMP);
+    if (offload_enabled) {
+        // The driver registered the timestamp field when the offload was configured. Registering again returns it.
+        if (rte_mbuf_dyn_rx_timestamp_register(&port.hardware_offset, &port.hardware_flag) == 0 &&
+            calibrate_clock(port_id, port)) {
+            port.source = rx_timestamp_source::hardware;
+        } else {
+            std::cout << "Warning: Unable to read the clock of port Id: " << port_id << ". Using software RX timestamps ... " << std::endl;
+        }
+    }
+
+    port.queues = static_cast<rx_timestamp_queue *>(rte_zmalloc_socket("rx_timestamp", rx_queues * sizeof(rx_timestamp_queue),
+                                                                       RTE_CACHE_LINE_SIZE, rte_eth_dev_socket_id(port_id)));
+    if (port.queues == nullptr) {
+        std::cerr << "Unable to allocate the RX timestamp state of port Id: " << port_id << std::endl;
+        return false;
+    }
+    port.rx_queues = rx_queues;
+
+    rte_rx_callback_fn callback = (port.source == rx_timestamp_source::hardware) ? hardware_timestamp_callback
+                                                                                  : software_timestamp_callback;
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        port.queues[i].port = &port;
+        port.queues[i].callback = rte_eth_add_rx_callback(port_id, i, callback, &port.queues[i]);
+        if (port.queues[i].callback == nullptr) {
+            std::cerr << "Unable to add the RX timestamp callback to port Id: " << port_id << " queue: " << i
+                      << ". Error code: " << rte_errno << std::endl;
+            return false;
+        }
+    }
+
+    std::cout << "Port Id: " << port_id << " RX timestamps: " << rx_timestamp_source_name(port_id);
+    if (port.source == rx_timestamp_source::hardware) {
+        std::cout << " (NIC clock " << port.clock_hz << "Hz)";
+    }
+    std::cout << std::endl;
+    return true;
+}
+
+void rx_timestamp_stop(uint16_t port_id)
+{
+    rx_timestamp_port &port = ports[port_id];
+    if (port.queues == nullptr) {
+        return;
+    }
+
+    for (uint16_t i = 0; i < port.rx_queues; i++) {
+        if (port.queues[i].callback != nullptr) {
+            rte_eth_remove_rx_callback(port_id, i, port.queues[i].callback);
+        }
+    }
+
+    // rte_eth_remove_rx_callback() does not free the callback, as an lcore may still be running it. The callers stop
+    // receiving before this function is called, so the memory can be freed.
+    rte_free(port.queues);
+    port.queues = nullptr;
+    port.rx_queues = 0;
+}
+
+rx_timestamp_source rx_timestamp_get_source(uint16_t port_id)
+{
+    return ports[port_id].source;
+}
+
+const char *rx_timestamp_source_name(uint16_t port_id)
+{
+    return (ports[port_id].source == rx_timestamp_source::hardware) ? "hardware" : "software";
+}
+
+void rx_timestamp_print_stats(uint16_t port_id)
+{
+    const rx_timestamp_port &port = ports[port_id];
+    if (port.queues == nullptr) {
+        return;
+    }
+
+    uint64_t hardware_packets = 0;
+    uint64_t software_packets = 0;
+    for (uint16_t i = 0; i < port.rx_queues; i++) {
+        hardware_packets += port.queues[i].hardware_packets;
+        software_packets += port.queues[i].software_packets;
+    }
+
+    std::cout << "Port Id: " << port_id << " RX timestamp source: " << rx_timestamp_source_name(port_id);
+    if (port.source == rx_timestamp_source::hardware) {
+        std::cout << " NIC clock: " << port.clock_hz << "Hz";
+    }
+    std::cout << " Hardware timestamped packets: " << hardware_packets
+              << " Software timestamped packets: " << software_packets << std::endl;
+}
@@ -0,0 +1,60 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// RX timestamps. Every received packet gets the time it arrived in the RX TSC of the packet metadata (see
+// packet_metadata.h), which the later stages use for latencies and capture files.
+//
+// If the NIC supports it, the RX timestamp offload (RTE_ETH_RX_OFFLOAD_TIMESTAMP) is enabled and the NIC writes the
+// time of arrival from its own clock into the timestamp field of the mbuf. The NIC clock is calibrated against the TSC
+// with rte_eth_read_clock() when the port starts, and every hardware timestamp is converted to the TSC time line.
+// Otherwise (or for packets without a hardware timestamp) the TSC is read when the burst is received. Both are done in
+// an RX callback, so every mode gets the timestamps without changes to its receive loop.
+
+enum class rx_timestamp_source {
+    software,   // TSC read when the burst is received.
+    hardware    // NIC timestamp converted to TSC.
+};
+
+// Returns the RX offloads to add to the port configuration: RTE_ETH_RX_OFFLOAD_TIMESTAMP if `allow_hardware` is set
+// and the NIC supports it, otherwise 0. Called before rte_eth_dev_configure().
+uint64_t rx_timestamp_offloads(uint16_t port_id, bool allow_hardware);
+
+// Calibrates the NIC clock if the timestamp offload is enabled and installs the timestamp callback on the first
+// `rx_queues` receive queues. Called after rte_eth_dev_start(). Falls back to software timestamps if the NIC clock
+// cannot be read. Returns false if a callback cannot be installed.
+bool rx_timestamp_start(uint16_t port_id, uint16_t rx_queues);
+
+// Removes the callbacks of the port. Called when no lcore receives on the port any more.
+void rx_timestamp_stop(uint16_t port_id);
+
+rx_timestamp_source rx_timestamp_get_source(uint16_t port_id);
+
+// Returns "hardware" or "software".
+const char *rx_timestamp_source_name(uint16_t port_id);
+
+// Prints the timestamp source, the NIC clock frequency and the packets with hardware and software timestamps. Prints
+// nothing if rx_timestamp_start() was not called for the port.
+void rx_timestamp_print_stats(uint16_t port_id);
@@ -0,0 +1,240 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "sflow_exporter.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ring_elem.h>
+#include <rte_thread.h>
+
+#include "packet_sampler.h"
+
+constexpr uint32_t sflow_version = 5;
+constexpr uint32_t sflow_address_ipv4 = 1;
+constexpr uint32_t sflow_flow_sample = 1;           // Enterprise 0, format 1.
+constexpr uint32_t sflow_raw_packet_header = 1;     // Enterprise 0, format 1.
+constexpr uint32_t sflow_header_ethernet = 1;       // ISO 8802-3 Ethernet.
+constexpr uint32_t samples_per_datagram = 7;
+constexpr uint32_t max_datagram_size = 1472;
+
+struct sflow_exporter {
+    rte_ring *samples = nullptr;
+    int socket_fd = -1;
+    sockaddr_in collector = {};
+    FILE *file = nullptr;
+    uint64_t start_tsc = 0;
+    uint32_t datagram_sequence = 0;
+    uint32_t sample_sequence = 0;
+    uint64_t datagrams = 0;
+    uint64_t exported_samples = 0;
+    rte_thread_t thread_id = {};
+    std::atomic<bool> stop{false};
+};
+
+// Appends XDR data: 32 bit big endian numbers and opaque data padded to 4 bytes.
+struct xdr_buffer {
+    uint8_t data[max_datagram_size];
+    uint32_t length = 0;
+
+    void put_u32(uint32_t value)
+    {
+        const uint32_t big_endian = htonl(value);
+        memcpy(data + length, &big_endian, sizeof(big_endian));
+        length += sizeof(big_endian);
+    }
+
+    void put_opaque(const uint8_t *bytes, uint32_t size)
+    {
+        memcpy(data + length, bytes, size);
+        memset(data + length + size, 0, RTE_ALIGN_CEIL(size, 4) - size);
+        length += RTE_ALIGN_CEIL(size, 4);
+    }
+};
+
+static void encode_flow_sample(sflow_exporter *exporter, xdr_buffer &buffer, const packet_sample &sample)
+{
+    const uint32_t header_length = RTE_ALIGN_CEIL(sample.header_length, 4U);
+    const uint32_t record_length = 4 * sizeof(uint32_t) + header_length;
+    const uint32_t sample_length = 8 * sizeof(uint32_t) + 2 * sizeof(uint32_t) + record_length;
+
+    buffer.put_u32(sflow_flow_sample);
+    buffer.put_u32(sample_length);
+    buffer.put_u32(++exporter->sample_sequence);
+    buffer.put_u32(sample.port);            // Source id: type 0 (ifIndex), index = port id.
+    buffer.put_u32(sample.sampling_rate);
+    buffer.put_u32(sample.sample_pool);
+    buffer.put_u32(sample.drops);
+    buffer.put_u32(sample.port);            // Input interface.
+    buffer.put_u32(0);                      // Output interface unknown.
+    buffer.put_u32(1);                      // Number of records.
+
+    buffer.put_u32(sflow_raw_packet_header);
+    buffer.put_u32(record_length);
+    buffer.put_u32(sflow_header_ethernet);
+    buffer.put_u32(sample.frame_length);
+    buffer.put_u32(0);                      // Bytes stripped. The NIC already removed the FCS.
+    buffer.put_u32(sample.header_length);
+    buffer.put_opaque(sample.header, sample.header_length);
+}
+
+static void send_datagram(sflow_exporter *exporter, const packet_sample *samples, uint32_t count)
+{
+    xdr_buffer buffer;
+    buffer.put_u32(sflow_version);
+    buffer.put_u32(sflow_address_ipv4);
+    buffer.put_u32(INADDR_LOOPBACK);        // Agent address.
+    buffer.put_u32(0);                      // Sub agent id.
+    buffer.put_u32(++exporter->datagram_sequence);
+    buffer.put_u32((rte_rdtsc() - exporter->start_tsc) * 1000 / rte_get_tsc_hz());     // Uptime in ms.
+    buffer.put_u32(count);
+    for (uint32_t i = 0; i < count; i++) {
+        encode_flow_sample(exporter, buffer, samples[i]);
+    }
+
+    if (exporter->file != nullptr) {
+        const uint32_t length = htonl(buffer.length);
+        fwrite(&length, sizeof(length), 1, exporter->file);
+        fwrite(buffer.data, buffer.length, 1, exporter->file);
+    } else {
+        sendto(exporter->socket_fd, buffer.data, buffer.length, 0, reinterpret_cast<const sockaddr *>(&exporter->collector),
+               sizeof(exporter->collector));
+    }
+    exporter->datagrams++;
+    exporter->exported_samples += count;
+}
+
+// Sends the samples in the ring. Returns the number of samples sent.
+static uint32_t export_samples(sflow_exporter *exporter)
+{
+    packet_sample samples[samples_per_datagram];
+    uint32_t exported = 0;
+    uint32_t count = 0;
+    while ((count = rte_ring_sc_dequeue_burst_elem(exporter->samples, samples, sizeof(packet_sample),
+                                                   samples_per_datagram, nullptr)) != 0) {
+        send_datagram(exporter, samples, count);
+        exported += count;
+    }
+    return exported;
+}
+
+static uint32_t exporter_thread(void *arg)
+{
+    sflow_exporter *exporter = static_cast<sflow_exporter *>(arg);
+    while (!exporter->stop.load(std::memory_order_relaxed)) {
+        if (export_samples(exporter) == 0) {
+            rte_delay_us_sleep(10 * 1000);
+        }
+    }
+
+    export_samples(exporter);
+    return 0;
+}
+
+// Opens `udp:<IPv4 address>:<port>` as a UDP socket, anything else as a file.
+static bool open_destination(sflow_exporter *exporter, const char *destination)
+{
+    if (strncmp(destination, "udp:", 4) != 0) {
+        exporter->file = fopen(destination, "wb");
+        if (exporter->file == nullptr) {
+            std::cerr << "Unable to create sFlow file: " << destination << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const char *port = strrchr(destination, ':');
+    if (port == destination + 3) {
+        std::cerr << "Missing sFlow collector port: " << destination << std::endl;
+        return false;
+    }
+    const std::string address(destination + 4, port);
+    exporter->collector.sin_family = AF_INET;
+    exporter->collector.sin_port = htons(strtoul(port + 1, nullptr, 10));
+    if (inet_pton(AF_INET, address.c_str(), &exporter->collector.sin_addr) != 1) {
+        std::cerr << "Invalid sFlow collector address: " << destination << std::endl;
+        return false;
+    }
+
+    exporter->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (exporter->socket_fd < 0) {
+        std::cerr << "Unable to create the sFlow socket. Error: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void close_destination(sflow_exporter *exporter)
+{
+    if (exporter->file != nullptr) {
+        fclose(exporter->file);
+    }
+    if (exporter->socket_fd >= 0) {
+        close(exporter->socket_fd);
+    }
+}
+
+sflow_exporter *sflow_exporter_start(rte_ring *samples, const char *destination)
+{
+    sflow_exporter *exporter = new sflow_exporter;
+    exporter->samples = samples;
+    exporter->start_tsc = rte_rdtsc();
+    if (!open_destination(exporter, destination)) {
+        close_destination(exporter);
+        delete exporter;
+        return nullptr;
+    }
+
+    if (rte_thread_create_control(&exporter->thread_id, "sflow", exporter_thread, exporter) != 0) {
+        std::cerr << "Unable to start the sFlow exporter thread" << std::endl;
+        close_destination(exporter);
+        delete exporter;
+        return nullptr;
+    }
+
+    std::cout << "Exporting packet samples as sFlow to " << destination << std::endl;
+    return exporter;
+}
+
+void sflow_exporter_stop(sflow_exporter *exporter)
+{
+    if (exporter == nullptr) {
+        return;
+    }
+
+    exporter->stop.store(true, std::memory_order_relaxed);
+    rte_thread_join(exporter->thread_id, nullptr);
+    close_destination(exporter);
+
+    std::cout << "sFlow datagrams: " << exporter->datagrams << " samples: " << exporter->exported_samples << std::endl;
+    delete exporter;
+}
@@ -0,0 +1,42 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <rte_ring.h>
+
+// sFlow exporter (https://sflow.org/sflow_version_5.txt). A control thread takes the samples from the sample ring (see
+// packet_sampler.h) and encodes them as sFlow version 5 datagrams: one flow sample with a raw packet header record per
+// sampled packet, up to 7 samples per datagram so it fits into a 1500 byte MTU. The sampling rate, the sample pool and
+// the drops of every sample let the collector scale the samples back to the total traffic.
+//
+// The datagrams are sent over UDP to `udp:<IPv4 address>:<port>` (e.g. to sflowtool or a collector), or written to a
+// file. In the file every datagram is preceded by its length as a 32 bit big endian number.
+
+struct sflow_exporter;
+
+// Starts the exporter thread which reads `samples` and writes to `destination`. Returns nullptr if the destination
+// cannot be opened or the thread cannot be created.
+sflow_exporter *sflow_exporter_start(rte_ring *samples, const char *destination);
+
+// Sends the remaining samples, stops the thread and frees the exporter. Does nothing for nullptr.
+void sflow_exporter_stop(sflow_exporter *exporter);
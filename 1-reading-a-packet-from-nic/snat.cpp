@@ -0,0 +1,534 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "snat.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_tcp.h>
+#include <rte_telemetry.h>
+#include <rte_udp.h>
+
+#include "app_telemetry.h"
+#include "checksum_update.h"
+
+constexpr uint16_t nat_burst_size = 32;
+constexpr uint32_t sweep_budget = 8;                // Ports checked for idle mappings per poll.
+constexpr uint32_t port_count = 65536;
+constexpr uint64_t checksum_offloads = RTE_ETH_TX_OFFLOAD_IPV4_CKSUM | RTE_ETH_TX_OFFLOAD_TCP_CKSUM |
+                                       RTE_ETH_TX_OFFLOAD_UDP_CKSUM;
+
+enum nat_protocol { nat_tcp, nat_udp, nat_protocol_count };
+
+// Key of an outbound mapping: the inside address and port. The values are in network byte order.
+struct nat_key {
+    uint32_t addr;
+    uint16_t port;
+    uint8_t proto;
+    uint8_t reserved;
+};
+
+// Entry of the inbound table: inside address << 32 | inside port << 16 | 1. 0 is a free port.
+static inline uint64_t make_inbound(uint32_t addr, uint16_t port)
+{
+    return (static_cast<uint64_t>(addr) << 32) | (static_cast<uint32_t>(port) << 16) | 1;
+}
+
+// Port pool of one protocol of a worker: a stack of the free ports of its slice. `free_count` is written only by the
+// worker and read by the telemetry thread.
+struct port_pool {
+    uint16_t *free_ports;
+    std::atomic<uint32_t> free_count;
+    uint64_t *last_tsc;             // Last outbound packet per port of the slice.
+};
+
+// A direction a worker forwards: from `in_port` to `out_port`, on the queues of the worker.
+struct nat_path {
+    uint16_t in_port;
+    uint16_t out_port;
+    bool offload_checksums;
+    bool rewrite_mac;
+    rte_ether_addr out_port_mac;
+};
+
+struct alignas(RTE_CACHE_LINE_SIZE) nat_worker {
+    nat_path paths[2];
+    uint32_t path_count;
+    uint16_t queue_id;
+    uint16_t slice_first;           // First public port of the slice, host byte order.
+    uint32_t slice_size;
+    uint32_t sweep_position;
+    rte_hash *mappings;
+    port_pool pools[nat_protocol_count];
+
+    // Written only by the worker, read by the telemetry thread.
+    std::atomic<uint64_t> outbound;
+    std::atomic<uint64_t> inbound;
+    std::atomic<uint64_t> new_mappings;
+    std::atomic<uint64_t> expired_mappings;
+    std::atomic<uint64_t> exhausted;         // Outbound packets dropped because the port pool was empty.
+    std::atomic<uint64_t> inbound_unknown;   // Inbound packets dropped because their port has no mapping.
+    std::atomic<uint64_t> untranslated;      // Dropped packets which are neither TCP nor UDP over IPv4.
+    std::atomic<uint64_t> tx_dropped;
+    uint64_t total_cycles;
+};
+
+static std::atomic<uint64_t> *inbound_table[nat_protocol_count];
+static nat_worker *workers[RTE_MAX_LCORE];
+static snat_options nat_config;
+static uint64_t timeout_cycles = 0;
+static const volatile sig_atomic_t *exit_flag = nullptr;
+
+// Replaces an address and a port of the packet and fixes the checksums. `address` and `port` point into the IPv4 and
+// the L4 header.
+static inline void rewrite(rte_mbuf *packet, rte_ipv4_hdr *ipv4_hdr, uint16_t *l4_checksum, uint32_t *address,
+                           uint16_t *port, uint32_t new_address, uint16_t new_port, bool offload_checksums)
+{
+    if (offload_checksums) {
+        *address = new_address;
+        *port = new_port;
+        packet->l2_len = sizeof(rte_ether_hdr);
+        packet->l3_len = rte_ipv4_hdr_len(ipv4_hdr);
+        packet->ol_flags |= RTE_MBUF_F_TX_IPV4 | RTE_MBUF_F_TX_IP_CKSUM;
+        packet->ol_flags |= (ipv4_hdr->next_proto_id == IPPROTO_TCP) ? RTE_MBUF_F_TX_TCP_CKSUM
+                                                                     : RTE_MBUF_F_TX_UDP_CKSUM;
+        ipv4_hdr->hdr_checksum = 0;
+        // The NIC expects the checksum of the pseudo header in the L4 checksum field.
+        *l4_checksum = rte_ipv4_phdr_cksum(ipv4_hdr, packet->ol_flags);
+        return;
+    }
+
+    ipv4_hdr->hdr_checksum = checksum_replace32(ipv4_hdr->hdr_checksum, *address, new_address);
+
+    // The address is part of the pseudo header of the L4 checksum. A UDP checksum of 0 means no checksum.
+    const bool udp_without_checksum = (ipv4_hdr->next_proto_id == IPPROTO_UDP && *l4_checksum == 0);
+    if (!udp_without_checksum) {
+        uint16_t checksum = checksum_replace32(*l4_checksum, *address, new_address);
+        checksum = checksum_replace16(checksum, *port, new_port);
+        if (ipv4_hdr->next_proto_id == IPPROTO_UDP && checksum == 0) {
+            checksum = 0xFFFF;
+        }
+        *l4_checksum = checksum;
+    }
+    *address = new_address;
+    *port = new_port;
+}
+
+// Returns the public port of the inside endpoint, allocating one from the pool of the worker if it has none. Returns
+// 0 if the pool is empty.
+static inline uint16_t outbound_port(nat_worker &worker, const nat_key &key, nat_protocol protocol, uint64_t now)
+{
+    port_pool &pool = worker.pools[protocol];
+    void *data = nullptr;
+    uint16_t public_port = 0;
+    if (rte_hash_lookup_data(worker.mappings, &key, &data) >= 0) {
+        public_port = static_cast<uint16_t>(reinterpret_cast<uintptr_t>(data));
+    } else {
+        const uint32_t free_count = pool.free_count.load(std::memory_order_relaxed);
+        if (free_count == 0) {
+            return 0;
+        }
+        public_port = pool.free_ports[free_count - 1];
+        void *value = reinterpret_cast<void *>(static_cast<uintptr_t>(public_port));
+        if (rte_hash_add_key_data(worker.mappings, &key, value) != 0) {
+            return 0;
+        }
+        pool.free_count.store(free_count - 1, std::memory_order_relaxed);
+        inbound_table[protocol][public_port].store(make_inbound(key.addr, key.port), std::memory_order_release);
+        telemetry_counter_add(worker.new_mappings, 1);
+    }
+    pool.last_tsc[public_port - worker.slice_first] = now;
+    return public_port;
+}
+
+// Frees the mappings of up to sweep_budget ports of the slice which had no outbound packet for the timeout.
+static void sweep_mappings(nat_worker &worker, uint64_t now)
+{
+    for (uint32_t i = 0; i < sweep_budget; i++) {
+        const uint32_t offset = worker.sweep_position;
+        worker.sweep_position = (worker.sweep_position + 1) % worker.slice_size;
+        const uint16_t public_port = worker.slice_first + offset;
+
+        for (uint32_t protocol = 0; protocol < nat_protocol_count; protocol++) {
+            port_pool &pool = worker.pools[protocol];
+            const uint64_t inbound = inbound_table[protocol][public_port].load(std::memory_order_relaxed);
+            if (inbound == 0 || now - pool.last_tsc[offset] < timeout_cycles) {
+                continue;
+            }
+
+            const nat_key key = {static_cast<uint32_t>(inbound >> 32), static_cast<uint16_t>(inbound >> 16),
+                                 static_cast<uint8_t>(protocol == nat_tcp ? IPPROTO_TCP : IPPROTO_UDP), 0};
+            rte_hash_del_key(worker.mappings, &key);
+            inbound_table[protocol][public_port].store(0, std::memory_order_release);
+            const uint32_t free_count = pool.free_count.load(std::memory_order_relaxed);
+            pool.free_ports[free_count] = public_port;
+            pool.free_count.store(free_count + 1, std::memory_order_relaxed);
+            telemetry_counter_add(worker.expired_mappings, 1);
+        }
+    }
+}
+
+// Translates a packet. Returns false if the packet must be dropped.
+static inline bool translate(nat_worker &worker, rte_mbuf *packet, uint64_t now, bool offload_checksums)
+{
+    rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packet, rte_ether_hdr *);
+    if (eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+        packet->data_len < sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr)) {
+        telemetry_counter_add(worker.untranslated, 1);
+        return false;
+    }
+
+    rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<rte_ipv4_hdr *>(eth_hdr + 1);
+    const uint32_t l4_offset = sizeof(rte_ether_hdr) + rte_ipv4_hdr_len(ipv4_hdr);
+    const uint8_t proto = ipv4_hdr->next_proto_id;
+    const uint32_t l4_size = (proto == IPPROTO_TCP) ? sizeof(rte_tcp_hdr) : sizeof(rte_udp_hdr);
+
+    // Fragments after the first one have no L4 header.
+    if ((proto != IPPROTO_TCP && proto != IPPROTO_UDP) || packet->data_len < l4_offset + l4_size ||
+        (ipv4_hdr->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) != 0) {
+        telemetry_counter_add(worker.untranslated, 1);
+        return false;
+    }
+
+    const nat_protocol protocol = (proto == IPPROTO_TCP) ? nat_tcp : nat_udp;
+    uint8_t *l4_hdr = rte_pktmbuf_mtod_offset(packet, uint8_t *, l4_offset);
+    uint16_t *ports = reinterpret_cast<uint16_t *>(l4_hdr);
+    uint16_t *l4_checksum = (proto == IPPROTO_TCP) ? &reinterpret_cast<rte_tcp_hdr *>(l4_hdr)->cksum
+                                                   : &reinterpret_cast<rte_udp_hdr *>(l4_hdr)->dgram_cksum;
+
+    const uint16_t dst_port = rte_be_to_cpu_16(ports[1]);
+    if (ipv4_hdr->dst_addr == nat_config.public_addr) {
+        const uint64_t inbound = (dst_port >= nat_config.port_low && dst_port <= nat_config.port_high)
+                                 ? inbound_table[protocol][dst_port].load(std::memory_order_acquire) : 0;
+        if (inbound == 0) {
+            telemetry_counter_add(worker.inbound_unknown, 1);
+            return false;
+        }
+        rewrite(packet, ipv4_hdr, l4_checksum, &ipv4_hdr->dst_addr, &ports[1], inbound >> 32,
+                static_cast<uint16_t>(inbound >> 16), offload_checksums);
+        telemetry_counter_add(worker.inbound, 1);
+        return true;
+    }
+
+    const nat_key key = {ipv4_hdr->src_addr, ports[0], proto, 0};
+    const uint16_t public_port = outbound_port(worker, key, protocol, now);
+    if (public_port == 0) {
+        telemetry_counter_add(worker.exhausted, 1);
+        return false;
+    }
+    rewrite(packet, ipv4_hdr, l4_checksum, &ipv4_hdr->src_addr, &ports[0], nat_config.public_addr,
+            rte_cpu_to_be_16(public_port), offload_checksums);
+    telemetry_counter_add(worker.outbound, 1);
+    return true;
+}
+
+// Receives a burst on the in port of the path, translates it and transmits it on the out port.
+static void forward_burst(nat_worker &worker, const nat_path &path)
+{
+    rte_mbuf *packets[nat_burst_size];
+    const uint16_t count = rte_eth_rx_burst(path.in_port, worker.queue_id, packets, nat_burst_size);
+    app_telemetry_poll(count);
+    if (count == 0) {
+        return;
+    }
+
+    const uint64_t now = rte_rdtsc();
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (!translate(worker, packets[i], now, path.offload_checksums)) {
+            rte_pktmbuf_free(packets[i]);
+            continue;
+        }
+        if (path.rewrite_mac) {
+            rte_ether_hdr *eth_hdr = rte_pktmbuf_mtod(packets[i], rte_ether_hdr *);
+            rte_ether_addr_copy(&nat_config.dst_mac, &eth_hdr->dst_addr);
+            rte_ether_addr_copy(&path.out_port_mac, &eth_hdr->src_addr);
+        }
+        packets[kept++] = packets[i];
+    }
+    app_telemetry_drop(count - kept);
+
+    const uint16_t sent = rte_eth_tx_burst(path.out_port, worker.queue_id, packets, kept);
+    if (sent < kept) {
+        rte_pktmbuf_free_bulk(&packets[sent], kept - sent);
+        telemetry_counter_add(worker.tx_dropped, kept - sent);
+        app_telemetry_queue_drop(kept - sent);
+    }
+}
+
+static int nat_worker_loop(void *arg)
+{
+    nat_worker &worker = *static_cast<nat_worker *>(arg);
+
+    const uint64_t start = rte_rdtsc();
+    while (!*exit_flag) {
+        for (uint32_t i = 0; i < worker.path_count; i++) {
+            forward_burst(worker, worker.paths[i]);
+        }
+        sweep_mappings(worker, rte_rdtsc());
+    }
+    worker.total_cycles = rte_rdtsc() - start;
+
+    return 0;
+}
+
+static int nat_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    uint64_t outbound = 0, inbound = 0, new_mappings = 0, expired = 0, exhausted = 0, inbound_unknown = 0;
+    uint64_t untranslated = 0, tx_dropped = 0, free_ports = 0, total_ports = 0;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const nat_worker *worker = workers[lcore_id];
+        if (worker == nullptr) {
+            continue;
+        }
+        outbound += worker->outbound.load(std::memory_order_relaxed);
+        inbound += worker->inbound.load(std::memory_order_relaxed);
+        new_mappings += worker->new_mappings.load(std::memory_order_relaxed);
+        expired += worker->expired_mappings.load(std::memory_order_relaxed);
+        exhausted += worker->exhausted.load(std::memory_order_relaxed);
+        inbound_unknown += worker->inbound_unknown.load(std::memory_order_relaxed);
+        untranslated += worker->untranslated.load(std::memory_order_relaxed);
+        tx_dropped += worker->tx_dropped.load(std::memory_order_relaxed);
+        for (const port_pool &pool : worker->pools) {
+            free_ports += pool.free_count.load(std::memory_order_relaxed);
+            total_ports += worker->slice_size;
+        }
+    }
+
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_uint(data, "outbound", outbound);
+    rte_tel_data_add_dict_uint(data, "inbound", inbound);
+    rte_tel_data_add_dict_uint(data, "new_mappings", new_mappings);
+    rte_tel_data_add_dict_uint(data, "expired_mappings", expired);
+    rte_tel_data_add_dict_uint(data, "active_mappings", total_ports - free_ports);
+    rte_tel_data_add_dict_uint(data, "free_ports", free_ports);
+    rte_tel_data_add_dict_uint(data, "pool_exhausted", exhausted);
+    rte_tel_data_add_dict_uint(data, "inbound_unknown", inbound_unknown);
+    rte_tel_data_add_dict_uint(data, "untranslated", untranslated);
+    rte_tel_data_add_dict_uint(data, "tx_dropped", tx_dropped);
+    return 0;
+}
+
+// Allocates the mapping table and the port pools of a worker for the ports [first, first + size).
+static nat_worker *create_worker(uint32_t lcore_id, uint16_t first, uint32_t size)
+{
+    const int32_t socket_id = rte_lcore_to_socket_id(lcore_id);
+    nat_worker *worker = static_cast<nat_worker *>(rte_zmalloc_socket("nat_worker", sizeof(nat_worker),
+                                                                      RTE_CACHE_LINE_SIZE, socket_id));
+    if (worker == nullptr) {
+        return nullptr;
+    }
+    worker->slice_first = first;
+    worker->slice_size = size;
+
+    const std::string name = "nat_mappings_" + std::to_string(lcore_id);
+    rte_hash_parameters params = {};
+    params.name = name.c_str();
+    params.entries = RTE_MAX(nat_protocol_count * size, 8U);
+    params.key_len = sizeof(nat_key);
+    params.hash_func = rte_hash_crc;
+    params.socket_id = socket_id;
+    worker->mappings = rte_hash_create(&params);
+    bool allocated = (worker->mappings != nullptr);
+
+    for (port_pool &pool : worker->pools) {
+        pool.free_ports = static_cast<uint16_t *>(rte_malloc_socket("nat_ports", size * sizeof(uint16_t), 0,
+                                                                    socket_id));
+        pool.last_tsc = static_cast<uint64_t *>(rte_zmalloc_socket("nat_ports", size * sizeof(uint64_t), 0, socket_id));
+        allocated = allocated && pool.free_ports != nullptr && pool.last_tsc != nullptr;
+        if (pool.free_ports != nullptr) {
+            // Allocated from the end of the stack, so the lowest ports are used first.
+            for (uint32_t i = 0; i < size; i++) {
+                pool.free_ports[i] = first + size - 1 - i;
+            }
+            pool.free_count.store(size, std::memory_order_relaxed);
+        }
+    }
+
+    if (!allocated) {
+        std::cerr << "Unable to allocate the NAT tables of lcore " << lcore_id << std::endl;
+        rte_hash_free(worker->mappings);
+        for (port_pool &pool : worker->pools) {
+            rte_free(pool.free_ports);
+            rte_free(pool.last_tsc);
+        }
+        rte_free(worker);
+        return nullptr;
+    }
+    return worker;
+}
+
+static void free_workers()
+{
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        nat_worker *worker = workers[lcore_id];
+        if (worker == nullptr) {
+            continue;
+        }
+        rte_hash_free(worker->mappings);
+        for (port_pool &pool : worker->pools) {
+            rte_free(pool.free_ports);
+            rte_free(pool.last_tsc);
+        }
+        rte_free(worker);
+        workers[lcore_id] = nullptr;
+    }
+    for (std::atomic<uint64_t> *&table : inbound_table) {
+        rte_free(table);
+        table = nullptr;
+    }
+}
+
+bool snat_parse_ports(const char *range, snat_options &options)
+{
+    char *end = nullptr;
+    const uint32_t low = strtoul(range, &end, 10);
+    if (*end != '-') {
+        return false;
+    }
+    const uint32_t high = strtoul(end + 1, &end, 10);
+    if (*end != '\0' || low == 0 || low > high || high > UINT16_MAX) {
+        return false;
+    }
+    options.port_low = low;
+    options.port_high = high;
+    return true;
+}
+
+uint64_t snat_tx_offloads(uint16_t port_id, const snat_options &options)
+{
+    if (!options.checksum_offload) {
+        return 0;
+    }
+
+    rte_eth_dev_info dev_info = {};
+    rte_eth_dev_info_get(port_id, &dev_info);
+    if ((dev_info.tx_offload_capa & checksum_offloads) != checksum_offloads) {
+        std::cout << "Warning: Port Id: " << port_id << " does not support IPv4, TCP and UDP checksum offload. "
+                  << "Updating the checksums in software. Ignoring ... " << std::endl;
+        return 0;
+    }
+    return checksum_offloads;
+}
+
+bool snat_loop(uint16_t rx_port, uint16_t tx_port, const snat_options &options,
+               const volatile sig_atomic_t &exit_indicator)
+{
+    const uint32_t worker_count = rte_lcore_count() - 1;
+    const uint32_t range_size = options.port_high - options.port_low + 1;
+    if (worker_count == 0 || range_size < worker_count) {
+        std::cerr << "NAT mode needs at least one worker lcore and one public port per worker. Pass more lcores with "
+                  << "the -l EAL argument." << std::endl;
+        return false;
+    }
+
+    nat_config = options;
+    exit_flag = &exit_indicator;
+    timeout_cycles = options.timeout_s * rte_get_tsc_hz();
+
+    // With two ports the replies arrive on the TX port and go back out on the RX port. The destination MAC is only
+    // rewritten towards the TX port.
+    nat_path paths[2] = {{rx_port, tx_port, false, options.rewrite_mac, {}}, {tx_port, rx_port, false, false, {}}};
+    const uint32_t path_count = (tx_port != rx_port) ? 2 : 1;
+    for (nat_path &path : paths) {
+        rte_eth_conf conf = {};
+        rte_eth_dev_conf_get(path.out_port, &conf);
+        path.offload_checksums = (conf.txmode.offloads & checksum_offloads) == checksum_offloads;
+        rte_eth_macaddr_get(path.out_port, &path.out_port_mac);
+    }
+
+    for (std::atomic<uint64_t> *&table : inbound_table) {
+        table = static_cast<std::atomic<uint64_t> *>(rte_zmalloc("nat_inbound", port_count * sizeof(uint64_t),
+                                                                 RTE_CACHE_LINE_SIZE));
+        if (table == nullptr) {
+            std::cerr << "Unable to allocate the NAT inbound table" << std::endl;
+            free_workers();
+            return false;
+        }
+    }
+
+    // Every worker gets an equal slice of the public ports, the first workers one more if it does not divide evenly.
+    uint16_t queue_id = 0;
+    uint32_t first = options.port_low;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const uint32_t size = range_size / worker_count + (queue_id < range_size % worker_count ? 1 : 0);
+        workers[lcore_id] = create_worker(lcore_id, first, size);
+        if (workers[lcore_id] == nullptr) {
+            free_workers();
+            return false;
+        }
+        workers[lcore_id]->paths[0] = paths[0];
+        workers[lcore_id]->paths[1] = paths[1];
+        workers[lcore_id]->path_count = path_count;
+        workers[lcore_id]->queue_id = queue_id++;
+        first += size;
+    }
+
+    if (rte_telemetry_register_cmd("/app/nat", nat_command,
+                                   "Returns the NAT translations, mappings and port pool usage. "
+                                   "Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/nat telemetry command. Ignoring ... " << std::endl;
+    }
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        rte_eal_remote_launch(nat_worker_loop, workers[lcore_id], lcore_id);
+    }
+
+    char address[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &options.public_addr, address, sizeof(address));
+    std::cout << "Translating packets from port Id: " << rx_port << " to port Id: " << tx_port << " with "
+              << worker_count << " workers. Public address: " << address << " ports: " << options.port_low << "-"
+              << options.port_high << " Checksums: " << (paths[0].offload_checksums ? "offload" : "incremental")
+              << " ... " << std::endl;
+    rte_eal_mp_wait_lcore();
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const nat_worker &worker = *workers[lcore_id];
+        const uint64_t translated = worker.outbound.load() + worker.inbound.load();
+        const double seconds = static_cast<double>(worker.total_cycles) / rte_get_tsc_hz();
+        std::cout << "NAT lcore " << lcore_id << ": ports " << worker.slice_first << "-"
+                  << worker.slice_first + worker.slice_size - 1 << " Outbound: " << worker.outbound.load()
+                  << " Inbound: " << worker.inbound.load()
+                  << " Mpps: " << (seconds > 0 ? translated / seconds / 1e6 : 0.0) << std::endl
+                  << "    New mappings: " << worker.new_mappings.load()
+                  << " Expired: " << worker.expired_mappings.load()
+                  << " Active TCP/UDP: " << worker.slice_size - worker.pools[nat_tcp].free_count.load() << "/"
+                  << worker.slice_size - worker.pools[nat_udp].free_count.load() << " Pool exhausted: "
+                  << worker.exhausted.load() << " Inbound unknown: " << worker.inbound_unknown.load()
+                  << " Untranslated: " << worker.untranslated.load() << " TX dropped: " << worker.tx_dropped.load()
+                  << std::endl;
+    }
+    free_workers();
+    return true;
+}
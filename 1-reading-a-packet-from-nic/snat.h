@@ -0,0 +1,68 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <csignal>
+#include <cstdint>
+#include <rte_ether.h>
+
+// Source NAT mode. Like the RSS mode, the ports have one receive and one transmit queue per worker lcore. Every worker
+// translates the packets received on its queue of the RX port and transmits them on its queue of the TX port. With two
+// ports the replies arrive on the TX port and the worker forwards them the other way.
+//
+// Outbound packets (every IPv4 TCP / UDP packet not addressed to the public address) get the public address as source
+// and a port from the pool of the worker as source port. The mapping from the inside address and port to the public
+// port is kept per worker in an rte_hash table which only that worker uses. The public port range is split into one
+// slice per worker up front, so allocating and freeing ports needs no lock and no other worker.
+//
+// Inbound packets (addressed to the public address and a port of the range) are translated back with a table indexed
+// by the public port. Only the worker which owns the port writes its entry, as one 64 bit atomic store, so every
+// worker can translate the replies of every other worker: RSS does not send the replies to the worker of the mapping.
+//
+// The addresses and ports are rewritten in place and the IPv4, TCP and UDP checksums are updated incrementally
+// (RFC 1624) from the changed words only, or, with checksum offload, computed by the NIC. A mapping which sees no
+// outbound packet for the timeout is freed by a sweep which checks a few ports of the slice per poll.
+//
+// The ACL and the blocklist stage are not supported in this mode as they allow only one lcore.
+
+struct snat_options {
+    uint32_t public_addr = 0;           // Network byte order. 0 means not set.
+    uint16_t port_low = 1024;           // Public port range, host byte order.
+    uint16_t port_high = 65535;
+    uint32_t timeout_s = 120;           // Mappings without outbound packets for this long are freed.
+    bool checksum_offload = false;      // Let the NIC compute the checksums if it supports it.
+    bool rewrite_mac = false;           // Rewrite source MAC to the TX port MAC and destination MAC to `dst_mac`.
+    rte_ether_addr dst_mac = {};
+};
+
+// Parses a port range, e.g. "1024-65535". Returns false if it is invalid.
+bool snat_parse_ports(const char *range, snat_options &options);
+
+// Returns the TX offloads the TX port must be configured with: the IPv4, TCP and UDP checksum offloads if
+// `options.checksum_offload` is set and the port supports all of them, otherwise 0.
+uint64_t snat_tx_offloads(uint16_t port_id, const snat_options &options);
+
+// Runs the NAT mode until `exit_indicator` is set. `rx_port` and `tx_port` must have one receive and one transmit queue
+// per worker lcore and be started. Returns false if there is no worker lcore or the tables cannot be created.
+bool snat_loop(uint16_t rx_port, uint16_t tx_port, const snat_options &options,
+               const volatile sig_atomic_t &exit_indicator);
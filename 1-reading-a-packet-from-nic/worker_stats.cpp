@@ -0,0 +1,191 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "worker_stats.h"
+
+#include <iomanip>
+#include <iostream>
+#include <rte_cycles.h>
+#include <rte_pause.h>
+
+#include "app_telemetry.h"
+#include "metrics_exporter.h"
+#include "packet_metadata.h"
+
+worker_stats lcore_worker_stats[RTE_MAX_LCORE];
+
+void worker_process_burst(worker_stats &stats, rte_mbuf **packets, uint16_t count, uint64_t work_cycles)
+{
+    const uint64_t start = rte_rdtsc();
+    const uint64_t hz = rte_get_tsc_hz();
+
+    for (uint16_t i = 0; i < count; i++) {
+        // Emulated processing. rte_delay_us_block() is too coarse for a few hundred cycles, so we spin on the TSC.
+        const uint64_t work_end = rte_rdtsc() + work_cycles;
+        while (rte_rdtsc() < work_end) {
+            rte_pause();
+        }
+
+        if (packet_has_rx_tsc(packets[i])) {
+            const uint64_t latency_ns = (rte_rdtsc() - packet_rx_tsc(packets[i])) * 1000000000ULL / hz;
+            const uint32_t bucket = (latency_ns == 0) ? 0 : 63 - __builtin_clzll(latency_ns);
+            telemetry_counter_add(bucket < latency_buckets ? stats.latency[bucket] : stats.latency_overflow, 1);
+            telemetry_counter_add(stats.latency_sum_ns, latency_ns);
+        }
+    }
+
+    telemetry_counter_add(stats.packets, count);
+    telemetry_counter_add(stats.bursts, 1);
+    telemetry_counter_add(stats.busy_cycles, rte_rdtsc() - start);
+}
+
+// A copy of the latency histogram of one or more workers.
+struct latency_histogram {
+    uint64_t buckets[latency_buckets] = {0};
+    uint64_t overflow = 0;
+
+    void add(const worker_stats &stats)
+    {
+        for (uint32_t i = 0; i < latency_buckets; i++) {
+            buckets[i] += stats.latency[i].load(std::memory_order_relaxed);
+        }
+        overflow += stats.latency_overflow.load(std::memory_order_relaxed);
+    }
+};
+
+// Returns the upper bound in nanoseconds of the bucket which contains the given percentile, "inf" if the percentile
+// falls into the overflow.
+static std::string latency_percentile(const latency_histogram &histogram, double percentile)
+{
+    uint64_t total = histogram.overflow;
+    for (uint32_t i = 0; i < latency_buckets; i++) {
+        total += histogram.buckets[i];
+    }
+    if (total == 0) {
+        return "0";
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < latency_buckets; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= total * percentile) {
+            return std::to_string(2ULL << i);
+        }
+    }
+    return "inf";
+}
+
+void worker_stats_print(const worker_stats *stats, uint32_t lcore_count)
+{
+    uint64_t total_packets = 0;
+    uint64_t total_busy_cycles = 0;
+    uint64_t total_cycles = 0;
+    latency_histogram total_latency;
+    uint64_t max_packets = 0;
+    uint32_t workers = 0;
+
+    std::cout << std::left << std::setw(8) << "lcore" << std::setw(14) << "packets" << std::setw(8) << "busy%"
+              << std::setw(12) << "p50(ns)" << std::setw(12) << "p99(ns)" << "p99.9(ns)" << std::endl;
+
+    for (uint32_t lcore = 0; lcore < lcore_count; lcore++) {
+        const worker_stats &worker = stats[lcore];
+        if (worker.total_cycles == 0) {
+            continue;
+        }
+
+        const uint64_t packets = worker.packets.load(std::memory_order_relaxed);
+        const uint64_t busy_cycles = worker.busy_cycles.load(std::memory_order_relaxed);
+        latency_histogram latency;
+        latency.add(worker);
+
+        std::cout << std::left << std::setw(8) << lcore << std::setw(14) << packets << std::setw(8)
+                  << std::fixed << std::setprecision(1) << 100.0 * busy_cycles / worker.total_cycles
+                  << std::setw(12) << latency_percentile(latency, 0.5)
+                  << std::setw(12) << latency_percentile(latency, 0.99)
+                  << latency_percentile(latency, 0.999) << std::endl;
+
+        total_packets += packets;
+        total_busy_cycles += busy_cycles;
+        total_cycles += worker.total_cycles;
+        total_latency.add(worker);
+        max_packets = RTE_MAX(max_packets, packets);
+        workers++;
+    }
+
+    if (workers == 0 || total_cycles == 0) {
+        return;
+    }
+
+    // An imbalance of 1.0 means that every worker processed the same number of packets.
+    const double average_packets = static_cast<double>(total_packets) / workers;
+    std::cout << std::left << std::setw(8) << "total" << std::setw(14) << total_packets << std::setw(8)
+              << std::fixed << std::setprecision(1) << 100.0 * total_busy_cycles / total_cycles
+              << std::setw(12) << latency_percentile(total_latency, 0.5)
+              << std::setw(12) << latency_percentile(total_latency, 0.99)
+              << latency_percentile(total_latency, 0.999) << std::endl;
+    std::cout << "Load imbalance (busiest / average): " << std::setprecision(2)
+              << (average_packets > 0 ? max_packets / average_packets : 0.0) << std::endl;
+}
+
+void worker_stats_collect_metrics(std::string &out, void *arg)
+{
+    metrics_append_header(out, "app_worker_packets_total", "counter", "Packets processed by the worker.");
+    for (uint32_t lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+        if (lcore_worker_stats[lcore].bursts.load(std::memory_order_relaxed) > 0) {
+            metrics_append_sample(out, "app_worker_packets_total", "lcore=\"" + std::to_string(lcore) + "\"",
+                                  lcore_worker_stats[lcore].packets.load(std::memory_order_relaxed));
+        }
+    }
+
+    metrics_append_header(out, "app_worker_busy_cycles_total", "counter", "TSC cycles the worker spent processing packets.");
+    for (uint32_t lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+        if (lcore_worker_stats[lcore].bursts.load(std::memory_order_relaxed) > 0) {
+            metrics_append_sample(out, "app_worker_busy_cycles_total", "lcore=\"" + std::to_string(lcore) + "\"",
+                                  lcore_worker_stats[lcore].busy_cycles.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Prometheus histogram buckets are cumulative: `le` is the upper bound of all the latencies counted so far. The
+    // overflow has no upper bound, so it is only counted in the +Inf bucket.
+    metrics_append_header(out, "app_worker_latency_ns", "histogram", "Latency from the RX timestamp until the worker processed the packet.");
+    for (uint32_t lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+        const worker_stats &stats = lcore_worker_stats[lcore];
+        if (stats.bursts.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+
+        latency_histogram latency;
+        latency.add(stats);
+
+        const std::string lcore_label = "lcore=\"" + std::to_string(lcore) + "\"";
+        uint64_t cumulative = 0;
+        for (uint32_t i = 0; i < latency_buckets; i++) {
+            cumulative += latency.buckets[i];
+            metrics_append_sample(out, "app_worker_latency_ns_bucket", lcore_label + ",le=\"" + std::to_string(2ULL << i) + "\"",
+                                  cumulative);
+        }
+        cumulative += latency.overflow;
+        metrics_append_sample(out, "app_worker_latency_ns_bucket", lcore_label + ",le=\"+Inf\"", cumulative);
+        metrics_append_sample(out, "app_worker_latency_ns_sum", lcore_label, stats.latency_sum_ns.load(std::memory_order_relaxed));
+        metrics_append_sample(out, "app_worker_latency_ns_count", lcore_label, cumulative);
+    }
+}
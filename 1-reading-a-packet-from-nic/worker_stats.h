@@ -0,0 +1,66 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <rte_common.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+// Statistics of the worker lcores of the multi-core modes (eventdev, distributor and RSS). They are used to compare
+// how the modes spread the load: utilisation shows how busy every worker is and the latency histogram shows the
+// tail latency from the RX timestamp until a worker finished the packet.
+
+// Latency buckets: bucket i counts the latencies in [2^i, 2^(i+1)) nanoseconds. Longer latencies (4.3 s and more)
+// are counted in `latency_overflow`, which has no upper bound.
+constexpr uint32_t latency_buckets = 32;
+
+// The counters are written only by the worker and read by the metrics exporter while the worker runs, so they are
+// atomics updated with telemetry_counter_add() (see app_telemetry.h).
+struct alignas(RTE_CACHE_LINE_SIZE) worker_stats {
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> bursts{0};
+    std::atomic<uint64_t> busy_cycles{0};       // Cycles spent processing packets.
+    std::atomic<uint64_t> latency[latency_buckets] = {};
+    std::atomic<uint64_t> latency_overflow{0};
+    std::atomic<uint64_t> latency_sum_ns{0};
+    uint64_t total_cycles = 0;                  // Cycles since the worker started. Set when the worker stops.
+};
+
+// The statistics of every lcore, indexed by lcore id. Each worker writes only its own entry.
+extern worker_stats lcore_worker_stats[RTE_MAX_LCORE];
+
+// Processes a burst on a worker lcore: spends `work_cycles` per packet to emulate the per packet processing cost of an
+// application and records the latency since the RX TSC of the packet metadata (see packet_metadata.h). The caller
+// frees or passes on the packets.
+void worker_process_burst(worker_stats &stats, rte_mbuf **packets, uint16_t count, uint64_t work_cycles);
+
+// Prints packets, utilisation and latency percentiles per worker, followed by the totals and the load imbalance
+// (busiest worker compared to the average). Called after the workers stopped.
+void worker_stats_print(const worker_stats *stats, uint32_t lcore_count);
+
+// Metrics collector (see metrics_exporter.h) which exports the packets, busy cycles and the latency histogram of every
+// worker in lcore_worker_stats.
+void worker_stats_collect_metrics(std::string &out, void *arg);
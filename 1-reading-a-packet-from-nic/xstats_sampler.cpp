@@ -0,0 +1,266 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "xstats_sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_thread.h>
+
+#include "app_telemetry.h"
+
+// Generic xstats which are already shown from rte_eth_stats.
+static const char *const generic_xstats[] = {"rx_missed_errors", "rx_errors", "tx_errors", "rx_mbuf_allocation_errors"};
+
+struct port_sample {
+    rte_eth_stats stats = {};
+    std::vector<uint64_t> xstats;
+};
+
+struct sampler_port {
+    uint16_t port_id;
+    std::vector<uint64_t> xstat_ids;    // Ids of the drop related xstats of the driver.
+    std::vector<std::string> xstat_names;
+    port_sample first;                  // Sample taken when the sampler started.
+    port_sample last;                   // Sample of the previous interval.
+};
+
+struct app_sample {
+    uint64_t dropped = 0;
+    uint64_t queue_dropped = 0;
+};
+
+// Packets lost per layer in an interval.
+struct layer_drops {
+    uint64_t ring_overflow = 0;
+    uint64_t mempool_exhausted = 0;
+    uint64_t queue_full = 0;
+    uint64_t policy = 0;
+    uint64_t nic_errors = 0;
+};
+
+struct xstats_sampler {
+    std::vector<sampler_port> ports;
+    const rte_mempool *pool = nullptr;
+    uint32_t interval_s = 0;
+    app_sample first_app;
+    app_sample last_app;
+    rte_thread_t thread_id = {};
+    std::atomic<bool> stop{false};
+};
+
+static bool is_drop_xstat(const char *name)
+{
+    for (const char *generic : generic_xstats) {
+        if (strcmp(name, generic) == 0) {
+            return false;
+        }
+    }
+    return strstr(name, "drop") != nullptr || strstr(name, "miss") != nullptr || strstr(name, "error") != nullptr ||
+           strstr(name, "nombuf") != nullptr;
+}
+
+// Looks up the drop related xstats of the port once. The names do not change while the port is started.
+static void find_drop_xstats(sampler_port &port)
+{
+    const int32_t count = rte_eth_xstats_get_names_by_id(port.port_id, nullptr, 0, nullptr);
+    if (count <= 0) {
+        return;
+    }
+
+    std::vector<rte_eth_xstat_name> names(count);
+    if (rte_eth_xstats_get_names_by_id(port.port_id, names.data(), count, nullptr) != count) {
+        return;
+    }
+    for (int32_t i = 0; i < count; i++) {
+        if (is_drop_xstat(names[i].name)) {
+            port.xstat_ids.push_back(i);
+            port.xstat_names.emplace_back(names[i].name);
+        }
+    }
+}
+
+static port_sample take_port_sample(const sampler_port &port)
+{
+    port_sample sample;
+    rte_eth_stats_get(port.port_id, &sample.stats);
+    sample.xstats.resize(port.xstat_ids.size());
+    if (!port.xstat_ids.empty() &&
+        rte_eth_xstats_get_by_id(port.port_id, port.xstat_ids.data(), sample.xstats.data(), port.xstat_ids.size()) < 0) {
+        std::fill(sample.xstats.begin(), sample.xstats.end(), 0);
+    }
+    return sample;
+}
+
+static app_sample take_app_sample()
+{
+    app_sample sample;
+    for (uint32_t i = 0; i < RTE_MAX_LCORE; i++) {
+        sample.dropped += lcore_telemetry_counters[i].dropped.load(std::memory_order_relaxed);
+        sample.queue_dropped += lcore_telemetry_counters[i].queue_dropped.load(std::memory_order_relaxed);
+    }
+    return sample;
+}
+
+// Prints the drops of one port between two samples and adds them to `drops`.
+static void print_port_delta(const sampler_port &port, const port_sample &from, const port_sample &to,
+                             layer_drops &drops)
+{
+    const uint64_t missed = to.stats.imissed - from.stats.imissed;
+    const uint64_t nombuf = to.stats.rx_nombuf - from.stats.rx_nombuf;
+    const uint64_t errors = to.stats.ierrors - from.stats.ierrors;
+    drops.ring_overflow += missed;
+    drops.mempool_exhausted += nombuf;
+    drops.nic_errors += errors;
+
+    std::cout << "  Port " << port.port_id << ": RX packets: " << to.stats.ipackets - from.stats.ipackets
+              << " RX missed: " << missed << " RX no mbuf: " << nombuf << " RX errors: " << errors
+              << " TX errors: " << to.stats.oerrors - from.stats.oerrors << std::endl;
+
+    // Only the xstats which changed are printed, most drivers have dozens of them.
+    for (size_t i = 0; i < port.xstat_ids.size(); i++) {
+        const uint64_t delta = to.xstats[i] - from.xstats[i];
+        if (delta != 0) {
+            std::cout << "    " << port.xstat_names[i] << ": " << delta << std::endl;
+        }
+    }
+}
+
+// Prints the drops per layer and names the layer which lost the most packets.
+static void print_attribution(const layer_drops &drops)
+{
+    const std::pair<const char *, uint64_t> layers[] = {
+        {"NIC ring overflow", drops.ring_overflow},
+        {"mempool exhaustion", drops.mempool_exhausted},
+        {"software queue full", drops.queue_full},
+        {"policy", drops.policy},
+        {"NIC errors", drops.nic_errors},
+    };
+
+    const std::pair<const char *, uint64_t> *worst = &layers[0];
+    std::cout << "  Drops by layer:";
+    for (const auto &layer : layers) {
+        std::cout << " " << layer.first << ": " << layer.second;
+        if (layer.second > worst->second) {
+            worst = &layer;
+        }
+    }
+    std::cout << std::endl;
+
+    if (worst->second == 0) {
+        std::cout << "  No drops" << std::endl;
+    } else {
+        std::cout << "  Losing layer: " << worst->first << std::endl;
+    }
+}
+
+// Prints the drops between the `from` samples and the current counters. `first` selects the samples taken at the start
+// instead of the samples of the previous interval.
+static void print_drops(xstats_sampler *sampler, bool first)
+{
+    layer_drops drops;
+    for (sampler_port &port : sampler->ports) {
+        const port_sample sample = take_port_sample(port);
+        print_port_delta(port, first ? port.first : port.last, sample, drops);
+        port.last = sample;
+    }
+
+    const app_sample app = take_app_sample();
+    const app_sample &from = first ? sampler->first_app : sampler->last_app;
+    drops.queue_full = app.queue_dropped - from.queue_dropped;
+    drops.policy = app.dropped - from.dropped;
+    sampler->last_app = app;
+
+    std::cout << "  Application: dropped: " << drops.policy << " software queue dropped: " << drops.queue_full;
+    if (sampler->pool != nullptr) {
+        std::cout << " mempool free: " << rte_mempool_avail_count(sampler->pool) << "/" << sampler->pool->size;
+    }
+    std::cout << std::endl;
+    print_attribution(drops);
+}
+
+static uint32_t sampler_thread(void *arg)
+{
+    xstats_sampler *sampler = static_cast<xstats_sampler *>(arg);
+    const uint64_t interval_cycles = sampler->interval_s * rte_get_timer_hz();
+    uint64_t next_sample = rte_get_timer_cycles() + interval_cycles;
+
+    // Sleeping in short steps bounds how long xstats_sampler_stop() waits for the thread.
+    while (!sampler->stop.load(std::memory_order_relaxed)) {
+        rte_delay_us_sleep(100 * 1000);
+        if (rte_get_timer_cycles() < next_sample) {
+            continue;
+        }
+
+        std::cout << "Drops in the last " << sampler->interval_s << " s:" << std::endl;
+        print_drops(sampler, false);
+        next_sample += interval_cycles;
+    }
+
+    return 0;
+}
+
+xstats_sampler *xstats_sampler_start(const uint16_t *port_ids, uint16_t port_count, const rte_mempool *pool,
+                                     uint32_t interval_s)
+{
+    xstats_sampler *sampler = new xstats_sampler;
+    sampler->pool = pool;
+    sampler->interval_s = interval_s;
+    for (uint16_t i = 0; i < port_count; i++) {
+        sampler_port port;
+        port.port_id = port_ids[i];
+        find_drop_xstats(port);
+        port.first = take_port_sample(port);
+        port.last = port.first;
+        sampler->ports.push_back(std::move(port));
+    }
+    sampler->first_app = take_app_sample();
+    sampler->last_app = sampler->first_app;
+
+    if (rte_thread_create_control(&sampler->thread_id, "xstats", sampler_thread, sampler) != 0) {
+        std::cerr << "Unable to start the xstats sampler thread" << std::endl;
+        delete sampler;
+        return nullptr;
+    }
+    return sampler;
+}
+
+void xstats_sampler_stop(xstats_sampler *sampler)
+{
+    if (sampler == nullptr) {
+        return;
+    }
+
+    sampler->stop.store(true, std::memory_order_relaxed);
+    rte_thread_join(sampler->thread_id, nullptr);
+
+    std::cout << "Drops since start:" << std::endl;
+    print_drops(sampler, true);
+    delete sampler;
+}
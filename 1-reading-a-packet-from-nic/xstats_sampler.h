@@ -0,0 +1,52 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mempool.h>
+
+// Drop attribution. A control thread samples the port statistics every few seconds and prints how many packets each
+// layer lost in the interval, next to the counters of the application (see app_telemetry.h):
+//
+//   NIC ring overflow   : imissed. The NIC had no free RX descriptor, the lcores do not poll fast enough.
+//   Mempool exhaustion  : rx_nombuf. The PMD could not refill a descriptor because the packet memory pool was empty,
+//                         packets are held too long (e.g. in a software queue) or the pool is too small.
+//   Software queue full : packets dropped by the application because a TX queue, the event device or the reorder
+//                         buffer had no room (app_telemetry_queue_drop()).
+//   Policy              : packets dropped on purpose by the application, e.g. denied by the ACL.
+//   NIC errors          : ierrors. Bad frames (CRC, length), not a capacity problem.
+//
+// The extended statistics (rte_eth_xstats) of the driver whose name contains "drop", "miss", "error" or "nombuf" are
+// printed as well, they often tell more precisely where the NIC dropped. The sampler only reads counters, it runs on a
+// control thread and never takes time from the data path.
+
+struct xstats_sampler;
+
+// Starts sampling `port_count` ports of `port_ids` and `pool` every `interval_s` seconds. Returns nullptr if the
+// thread cannot be created.
+xstats_sampler *xstats_sampler_start(const uint16_t *port_ids, uint16_t port_count, const rte_mempool *pool,
+                                     uint32_t interval_s);
+
+// Stops the thread, prints the drops by layer since xstats_sampler_start() and frees the sampler. Does nothing for
+// nullptr.
+void xstats_sampler_stop(xstats_sampler *sampler);
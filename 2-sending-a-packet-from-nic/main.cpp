@@ -20,15 +20,34 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
 #include <iostream>
 #include <thread>
 #include <csignal>
+#include <getopt.h>
+#include <rte_cycles.h>
 #include <rte_eal.h>
 #include <rte_errno.h>
 #include <rte_ethdev.h>
+#include <rte_ip.h>
 #include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include "app_telemetry.h"
+#include "event_log.h"
+#include "mempool_ops.h"
+#include "metrics_exporter.h"
+#include "packet_metadata.h"
+#include "perf_counters.h"
 
 static volatile sig_atomic_t exit_indicator = 0;
+static uint64_t transmitted_packet_count = 0;
+
+// Events of the transmit loop. They are written to the event log (see event_log.h) instead of std::cout, so that
+// printing never delays the next packet.
+static const uint32_t tx_failed_event = event_log_define("Unable to transmit the packet.");
+static const uint32_t tx_event = event_log_define("Packet transmitted successfully ... ({})");
+static const uint32_t reply_event = event_log_define("Reply received. Round trip time: {}ns");
 
 void terminate(int signal) 
 {
@@ -67,14 +86,15 @@ void set_ipv4_hdr(rte_ipv4_hdr *const ipv4_hdr){
     ipv4_hdr->hdr_checksum = rte_ipv4_cksum(ipv4_hdr);      // Calculating and setting IPv4 checksum in IPv4 header.
 }
 
-void send_packet(rte_mbuf *packet, uint16_t port_ids){
-    const uint16_t tx_packets = rte_eth_tx_burst(port_ids[0], 0, &packet, 1);
+void send_packet(rte_mbuf *packet, uint16_t port_id){
+    const uint16_t tx_packets = rte_eth_tx_burst(port_id, 0, &packet, 1);
+    app_telemetry_poll(tx_packets);
     if (tx_packets == 0) {
-        std::cout << "Unable to transmit the packet. " << std::endl;
+        event_log_write(tx_failed_event);
         rte_pktmbuf_free(packet);   // As the packet is not transmitted, we need to free the memory buffer by our self.
     } else {
         transmitted_packet_count += tx_packets;
-        std::cout << "Packet transmitted successfully ... (" << transmitted_packet_count << ")" << std::endl;
+        event_log_write(tx_event, transmitted_packet_count);
     }
 }
 
@@ -85,7 +105,7 @@ void set_udp_hdr(rte_udp_hdr *const udp_hdr){
     udp_hdr->dgram_cksum = 0;                       // Setting checksum = 0;
 }
 
-void insert_data_udp(uint8_t *payload){
+void insert_data_udp(rte_mbuf *packet, uint8_t *payload){
     memset(payload, 0, 172);
     const char sample_data[] = {"This is a sample data generated by a DPDK application ..."};
     memcpy(payload, sample_data, sizeof(sample_data));
@@ -95,6 +115,134 @@ void insert_data_udp(uint8_t *payload){
     packet->data_len = packet->pkt_len = sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr) + 172;
 }
 
+// In latency mode the TSC value at transmit time is written into the UDP payload at this offset (after the sample data).
+constexpr uint16_t latency_timestamp_offset = 64;
+
+// Round trip times of the packets sent back by a reflector (see reflector.h of the receiving tutorial).
+struct latency_stats {
+    uint64_t replies = 0;
+    uint64_t min_cycles = UINT64_MAX;
+    uint64_t max_cycles = 0;
+    uint64_t total_cycles = 0;
+};
+
+void insert_latency_timestamp(uint8_t *payload){
+    const uint64_t tsc = rte_rdtsc();
+    memcpy(payload + latency_timestamp_offset, &tsc, sizeof(tsc));
+}
+
+// Receives the packets sent back by the reflector until `until_cycles` and records their round trip time. A reflector
+// swaps the UDP ports, so a reply has source port 5000 and destination port 10000.
+void poll_latency_replies(uint16_t port_id, uint64_t until_cycles, latency_stats &stats){
+    rte_mbuf *packets[32];
+    const uint16_t reply_size = sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr) + latency_timestamp_offset + sizeof(uint64_t);
+
+    while (!exit_indicator && rte_rdtsc() < until_cycles) {
+        const uint16_t rx_packets = rte_eth_rx_burst(port_id, 0, packets, 32);
+        app_telemetry_poll(rx_packets);
+        const uint64_t now = rte_rdtsc();
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            packet_set_rx_tsc(packets[i], now);
+        }
+
+        for (uint16_t i = 0; i < rx_packets; i++) {
+            uint8_t *data = rte_pktmbuf_mtod(packets[i], uint8_t *);
+            const rte_ether_hdr *eth_hdr = reinterpret_cast<const rte_ether_hdr *>(data);
+            const rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<const rte_ipv4_hdr *>(data + sizeof(rte_ether_hdr));
+            const rte_udp_hdr *udp_hdr = reinterpret_cast<const rte_udp_hdr *>(data + sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr));
+
+            if (packets[i]->data_len < reply_size || eth_hdr->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+                ipv4_hdr->next_proto_id != 17 || udp_hdr->src_port != rte_cpu_to_be_16(5000) ||
+                udp_hdr->dst_port != rte_cpu_to_be_16(10000)) {
+                continue;
+            }
+
+            uint64_t sent_tsc = 0;
+            memcpy(&sent_tsc, data + sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr) + latency_timestamp_offset, sizeof(sent_tsc));
+            const uint64_t rtt_cycles = packet_rx_tsc(packets[i]) - sent_tsc;
+
+            stats.replies++;
+            stats.total_cycles += rtt_cycles;
+            stats.min_cycles = std::min(stats.min_cycles, rtt_cycles);
+            stats.max_cycles = std::max(stats.max_cycles, rtt_cycles);
+            event_log_write(reply_event, rtt_cycles * 1000000000 / rte_get_tsc_hz());
+        }
+
+        rte_pktmbuf_free_bulk(packets, rx_packets);
+    }
+}
+
+void print_latency_stats(const latency_stats &stats){
+    const double cycles_per_us = rte_get_tsc_hz() / 1000000.0;
+    std::cout << "Replies: " << stats.replies << " of " << transmitted_packet_count << " packets" << std::endl;
+    if (stats.replies > 0) {
+        std::cout << "Round trip time (us) min: " << stats.min_cycles / cycles_per_us
+                  << " avg: " << stats.total_cycles / stats.replies / cycles_per_us
+                  << " max: " << stats.max_cycles / cycles_per_us << std::endl;
+    }
+}
+
+// Application arguments. These are the arguments passed after `--` on the command line.
+struct app_options {
+    const char *mempool_ops = default_mempool_ops;  // Mempool driver used by the packet memory pool.
+    bool latency = false;                           // Measure the round trip time of the packets sent back by a reflector.
+    uint16_t metrics_port = 0;                      // TCP port of the Prometheus exporter. 0 disables it.
+    bool perf_counters = false;                     // Profile the bursts with hardware counters (see perf_counters.h).
+    const char *event_log_file = nullptr;           // File of the event log (see event_log.h). nullptr writes to stdout.
+};
+
+void print_usage(const char *program_name)
+{
+    std::cerr << "Usage: " << program_name << " [EAL arguments] -- [--mempool-ops=";
+    print_supported_mempool_ops(std::cerr);
+    std::cerr << "] [--latency] [--metrics-port=PORT] [--perf-counters] [--event-log=PATH]" << std::endl;
+}
+
+// Parses the application arguments with getopt_long(). Returns false if an argument is invalid.
+bool parse_app_args(int argc, char **argv, app_options &options)
+{
+    enum { OPT_MEMPOOL_OPS = 256, OPT_LATENCY, OPT_METRICS_PORT, OPT_PERF_COUNTERS, OPT_EVENT_LOG };
+    static const option long_options[] = {
+        {"mempool-ops", required_argument, nullptr, OPT_MEMPOOL_OPS},
+        {"latency", no_argument, nullptr, OPT_LATENCY},
+        {"metrics-port", required_argument, nullptr, OPT_METRICS_PORT},
+        {"perf-counters", no_argument, nullptr, OPT_PERF_COUNTERS},
+        {"event-log", required_argument, nullptr, OPT_EVENT_LOG},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt = 0;
+    optind = 1;     // rte_eal_init() has already used getopt, so we reset its state.
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_MEMPOOL_OPS:
+            if (!is_supported_mempool_ops(optarg)) {
+                std::cerr << "Unsupported mempool ops: " << optarg << std::endl;
+                return false;
+            }
+            options.mempool_ops = optarg;
+            break;
+        case OPT_LATENCY:
+            options.latency = true;
+            break;
+        case OPT_METRICS_PORT:
+            options.metrics_port = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_PERF_COUNTERS:
+            options.perf_counters = true;
+            break;
+        case OPT_EVENT_LOG:
+            options.event_log_file = optarg;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     // Setting up signals to catch TERM and INT signal.
@@ -116,6 +264,35 @@ int main(int argc, char **argv)
     argc -= return_val;
     argv += return_val;
 
+    app_options options;
+    if (!parse_app_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    // Registers the mbuf dynamic fields which carry the per packet metadata between the stages (see packet_metadata.h).
+    if (!packet_metadata_register()) {
+        std::cerr << "Unable to register the packet metadata fields. Error code: " << rte_errno << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    // Registers the /app telemetry commands (see app_telemetry.h). The application works without them.
+    if (!app_telemetry_register()) {
+        std::cout << "Warning: Unable to register the telemetry commands. Ignoring ... " << std::endl;
+    }
+
+    // Hardware counters per burst (see perf_counters.h). The lcores open them on their first poll.
+    if (options.perf_counters) {
+        perf_counters_enable();
+    }
+
+    // Without the event log the program still works, but the per packet messages are not shown.
+    if (!event_log_start(options.event_log_file)) {
+        std::cout << "Warning: Unable to start the event log. Ignoring ... " << std::endl;
+    }
+
     uint16_t port_ids[RTE_MAX_ETHPORTS] = {0};
     int16_t id = 0;
     int16_t total_port_count = 0;
@@ -140,9 +317,17 @@ int main(int argc, char **argv)
 
     std::cout << "Total ports detected: " << total_port_count << std::endl;
 
-    rte_mempool *memory_pool = rte_pktmbuf_pool_create("mempool_1", 1023, 512, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+    // The free memory buffers are kept by the mempool driver selected with `--mempool-ops` (see mempool_ops.h).
+    rte_mempool *memory_pool = create_packet_pool("mempool_1", 1023, 512, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id(),
+                                                  options.mempool_ops);
+    if (memory_pool == nullptr) {
+        std::cerr << "Unable to create memory pool with mempool ops " << options.mempool_ops << ". Error code: " << rte_errno << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
 
-    const uint16_t rx_queues = 0;
+    // A receive queue is only needed to receive the replies in latency mode.
+    const uint16_t rx_queues = options.latency ? 1 : 0;
     const uint16_t tx_queues = 1;
 
     rte_eth_conf portConf = {
@@ -155,26 +340,70 @@ int main(int argc, char **argv)
     };
 
     // Configure the port (ethernet interface).
-     rte_eth_dev_configure(port_ids[0], rx_queues, tx_queues, &portConf);
-
+    if ((return_val = rte_eth_dev_configure(port_ids[0], rx_queues, tx_queues, &portConf)) != 0) {
+        std::cerr << "Unable to configure port. port Id: " << port_ids[0] << " Return code: "  << return_val << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
 
     const int16_t portSocketId = rte_eth_dev_socket_id(port_ids[0]);
     const int16_t coreSocketId = rte_socket_id();
 
     // Configure the Rx queue(s) of the port.
- 
-    rte_eth_rx_queue_setup(port_ids[0], i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr, memory_pool);
-    rte_eth_tx_queue_setup(port_ids[0], i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr);
-        
+    for (uint16_t i = 0; i < rx_queues; i++) {
+        return_val = rte_eth_rx_queue_setup(port_ids[0], i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr, memory_pool);
+
+        if (return_val < 0) {
+            std::cerr << "Unable to setup RX queue " << i << " Port Id: " << port_ids[0] << "Return code: " << return_val << std::endl;
+            rte_eal_cleanup();
+            exit(1);
+        }
+    }
+
+    // Configure the Tx queue(s) of the port.
+    for (uint16_t i = 0; i < tx_queues; i++) {
+        return_val = rte_eth_tx_queue_setup(port_ids[0], i, 256, ((portSocketId >= 0) ? portSocketId : coreSocketId), nullptr);
+
+        if (return_val < 0) {
+            std::cerr << "Unable to setup TX queue " << i << " Port Id: " << port_ids[0] << "Return code: " << return_val << std::endl;
+            rte_eal_cleanup();
+            exit(1);
+        }
+    }
+
     // All the configuration is done. Finally starting the port (ethernet interface) so that we can start transmitting the packets.
-    rte_eth_dev_start(port_ids[0]);
+    return_val = rte_eth_dev_start(port_ids[0]);
+    if (return_val < 0) {
+        std::cout << "Unable to start port Id: " << port_ids[0] << " Return code: " << return_val << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
 
 
+    // The reflector swaps the MAC addresses, so the replies are sent to the made up source MAC of the packets, which
+    // the NIC filters out unless the port is in promiscuous mode.
+    if (options.latency) {
+        return_val = rte_eth_promiscuous_enable(port_ids[0]);
+        if (return_val != 0) {
+            std::cout << "Warning: Unable to set the promiscuous mode for port Id: " << port_ids[0] << " Return code: " << return_val << " Ignoring ... " << std::endl;
+        }
+    }
+
     std::cout << "Port configuration successful. Port Id: " << port_ids[0] << std::endl;
 
     std::cout << "Starting packet tranmission on the ethernet port ... " << std::endl;
 
-    uint64_t transmitted_packet_count = 0;
+    latency_stats latency;
+
+    // The exporter thread only reads counters, so the program keeps running if it cannot be started.
+    metrics_exporter *exporter = nullptr;
+    if (options.metrics_port != 0) {
+        exporter = metrics_exporter_create(options.metrics_port);
+        if (exporter != nullptr && !metrics_exporter_start(exporter)) {
+            metrics_exporter_stop(exporter);
+            exporter = nullptr;
+        }
+    }
 
     // Now we go into a loop to continously transmit the packets on the port (ethernet interface).
     while (!exit_indicator) {
@@ -182,6 +411,7 @@ int main(int argc, char **argv)
         rte_mbuf *packet = nullptr;
         if (rte_mempool_get(memory_pool, reinterpret_cast<void **>(&packet)) != 0) {
             std::cout << "Error: Unable to get memory buffer from memory pool. " << std::endl;
+            app_telemetry_idle();
             using namespace std::literals;
             std::this_thread::sleep_for(100ms);
             continue;
@@ -202,14 +432,36 @@ int main(int argc, char **argv)
 
         // Setting data in the UDP payload
         uint8_t *payload = data + sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr);
-        insert_data_udp(payload);
+        insert_data_udp(packet, payload);
+
+        // In latency mode the timestamp is written last so that it is as close as possible to the transmission.
+        if (options.latency) {
+            insert_latency_timestamp(payload);
+        }
 
         // Now our packet is finally prepared. We will now send it using the DPDK API.
-        send_packet(packet, port_ids);
+        send_packet(packet, port_ids[0]);
+
+        // In latency mode we keep polling for replies instead of sleeping, so that the arrival time of a reply is
+        // taken as soon as it is received.
+        if (options.latency) {
+            poll_latency_replies(port_ids[0], rte_rdtsc() + rte_get_tsc_hz() / 5, latency);
+            continue;
+        }
+
+        app_telemetry_idle();
         using namespace std::literals;
         std::this_thread::sleep_for(200ms);
     }
 
+    if (options.latency) {
+        print_latency_stats(latency);
+    }
+    perf_counters_print();
+    event_log_stop();
+
+    metrics_exporter_stop(exporter);
+
     std::cout << "Exiting DPDK program ... " << std::endl;
     rte_eal_cleanup();
     return 0;
@@ -0,0 +1,179 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <getopt.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_udp.h>
+
+#include "acl_classifier.h"
+
+// This benchmark measures the classification cycles per packet of the ACL stage of the receiving tutorial as the
+// number of rules grows. For every rule count a random rules file is generated, loaded with acl_classifier_create()
+// and random UDP packets are classified in bursts of 32.
+// To execute: sudo ./acl-classify-benchmark --lcores=0 -n 4 -- --max-rules=10000
+
+constexpr uint16_t burst_size = 32;
+constexpr uint32_t packet_count = 1024;
+
+struct benchmark_options {
+    uint32_t max_rules = 10000;
+    uint32_t rounds = 10000;    // Number of times all the packets are classified per rule count.
+    const char *rules_file = "/tmp/acl-classify-benchmark.rules";
+};
+
+static std::string random_prefix(std::mt19937 &generator)
+{
+    const uint32_t ip = generator();
+    const uint32_t depth = 8 + generator() % 25;
+    return std::to_string(ip >> 24) + "." + std::to_string((ip >> 16) & 0xff) + "." + std::to_string((ip >> 8) & 0xff) +
+           "." + std::to_string(ip & 0xff) + "/" + std::to_string(depth);
+}
+
+static void write_rules(const char *path, uint32_t rule_count, std::mt19937 &generator)
+{
+    static const char *protocols[] = {"tcp", "udp", "any"};
+    std::ofstream file(path);
+    for (uint32_t i = 0; i < rule_count; i++) {
+        const uint32_t port = generator() % 65536;
+        file << random_prefix(generator) << " " << random_prefix(generator) << " 0-65535 " << port << "-"
+             << RTE_MIN(port + generator() % 1024, 65535U) << " " << protocols[generator() % 3] << " "
+             << ((generator() & 1) ? "permit" : "deny") << "\n";
+    }
+}
+
+static void fill_packets(rte_mbuf **packets, std::mt19937 &generator)
+{
+    for (uint32_t i = 0; i < packet_count; i++) {
+        uint8_t *data = rte_pktmbuf_mtod(packets[i], uint8_t *);
+        rte_ether_hdr *eth_hdr = reinterpret_cast<rte_ether_hdr *>(data);
+        rte_ipv4_hdr *ipv4_hdr = reinterpret_cast<rte_ipv4_hdr *>(eth_hdr + 1);
+        rte_udp_hdr *udp_hdr = reinterpret_cast<rte_udp_hdr *>(ipv4_hdr + 1);
+
+        memset(data, 0, sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr));
+        eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+        ipv4_hdr->version_ihl = RTE_IPV4_VHL_DEF;
+        ipv4_hdr->next_proto_id = IPPROTO_UDP;
+        ipv4_hdr->src_addr = generator();
+        ipv4_hdr->dst_addr = generator();
+        udp_hdr->src_port = generator();
+        udp_hdr->dst_port = generator();
+        packets[i]->data_len = packets[i]->pkt_len = sizeof(rte_ether_hdr) + sizeof(rte_ipv4_hdr) + sizeof(rte_udp_hdr);
+    }
+}
+
+bool parse_app_args(int argc, char **argv, benchmark_options &options)
+{
+    enum { OPT_MAX_RULES = 256, OPT_ROUNDS, OPT_RULES_FILE };
+    static const option long_options[] = {
+        {"max-rules", required_argument, nullptr, OPT_MAX_RULES},
+        {"rounds", required_argument, nullptr, OPT_ROUNDS},
+        {"rules-file", required_argument, nullptr, OPT_RULES_FILE},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt = 0;
+    optind = 1;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_MAX_RULES:
+            options.max_rules = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_ROUNDS:
+            options.rounds = strtoul(optarg, nullptr, 10);
+            break;
+        case OPT_RULES_FILE:
+            options.rules_file = optarg;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return options.rounds > 0;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t return_val = rte_eal_init(argc, argv);
+    if (return_val < 0) {
+        std::cerr << "Unable to initialize DPDK EAL (Environment Abstraction Layer). Error code: " << rte_errno << std::endl;
+        exit(1);
+    }
+
+    argc -= return_val;
+    argv += return_val;
+
+    benchmark_options options;
+    if (!parse_app_args(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [EAL arguments] -- [--max-rules=N] [--rounds=N] [--rules-file=PATH]" << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    rte_mempool *memory_pool = rte_pktmbuf_pool_create("benchmark_pool", packet_count * 2 - 1, 0, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+    rte_mbuf *packets[packet_count];
+    if (memory_pool == nullptr || rte_pktmbuf_alloc_bulk(memory_pool, packets, packet_count) != 0) {
+        std::cerr << "Unable to allocate the packets. Error code: " << rte_errno << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    std::mt19937 generator(42);
+    fill_packets(packets, generator);
+
+    std::cout << std::left << std::setw(10) << "rules" << "cycles/packet" << std::endl;
+
+    uint32_t actions[burst_size];
+    for (uint32_t rule_count = 10; rule_count <= options.max_rules; rule_count *= 10) {
+        write_rules(options.rules_file, rule_count, generator);
+        acl_classifier *classifier = acl_classifier_create(options.rules_file, rte_socket_id());
+        if (classifier == nullptr) {
+            break;
+        }
+
+        const uint64_t start = rte_rdtsc_precise();
+        for (uint32_t round = 0; round < options.rounds; round++) {
+            for (uint32_t i = 0; i < packet_count; i += burst_size) {
+                acl_classify_burst(classifier, &packets[i], burst_size, actions);
+            }
+        }
+        const uint64_t cycles = rte_rdtsc_precise() - start;
+
+        std::cout << std::left << std::setw(10) << rule_count << std::fixed << std::setprecision(2)
+                  << static_cast<double>(cycles) / (static_cast<uint64_t>(options.rounds) * packet_count) << std::endl;
+        acl_classifier_free(classifier);
+    }
+
+    rte_pktmbuf_free_bulk(packets, packet_count);
+    rte_mempool_free(memory_pool);
+    rte_eal_cleanup();
+    return 0;
+}
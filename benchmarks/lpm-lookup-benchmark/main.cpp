@@ -0,0 +1,215 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <getopt.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_lpm.h>
+#include <rte_lpm6.h>
+
+// This benchmark measures the cost of an LPM lookup as the route table grows from 1K to 1M prefixes. The lookups use
+// the same APIs as the route mode of the receiving tutorial: rte_lpm_lookupx4() for IPv4 and
+// rte_lpm6_lookup_bulk_func() for IPv6. A DIR-24-8 table should give (almost) the same cycles per lookup for every
+// table size; a growing number means that the tables no longer fit in the cache and the TLB.
+// To execute: sudo ./lpm-lookup-benchmark --lcores=0 -n 4 -- --lookups=4194304
+
+constexpr uint32_t burst_size = 32;
+
+// The lookup results are summed into this variable so that the compiler cannot remove the lookups.
+static volatile uint64_t lookup_sink = 0;
+
+struct benchmark_options {
+    uint32_t lookups = 1 << 22;         // Number of random addresses looked up per table size.
+    uint32_t number_tbl8s = 1 << 16;    // Number of second level tables of the IPv4 table.
+};
+
+// Random prefix lengths with roughly the shape of an internet routing table: mostly /24, some shorter and a few longer
+// prefixes which need a second level table.
+static uint8_t random_ipv4_depth(std::mt19937 &generator)
+{
+    const uint32_t value = generator() % 100;
+    if (value < 60) {
+        return 24;
+    }
+    if (value < 98) {
+        return 16 + value % 8;
+    }
+    return 25 + value % 8;
+}
+
+double benchmark_ipv4(uint32_t prefix_count, const benchmark_options &options, uint32_t &added)
+{
+    rte_lpm_config config = {};
+    config.max_rules = prefix_count;
+    config.number_tbl8s = options.number_tbl8s;
+    rte_lpm *lpm = rte_lpm_create("benchmark_lpm", rte_socket_id(), &config);
+    if (lpm == nullptr) {
+        std::cerr << "Unable to create LPM table. Error code: " << rte_errno << std::endl;
+        return -1;
+    }
+
+    std::mt19937 generator(prefix_count);
+    added = 0;
+    for (uint32_t i = 0; i < prefix_count; i++) {
+        added += (rte_lpm_add(lpm, generator(), random_ipv4_depth(generator), i & 0xff) == 0);
+    }
+
+    std::vector<uint32_t> addresses(options.lookups);
+    for (uint32_t &address : addresses) {
+        address = generator();
+    }
+
+    uint32_t hops[4];
+    uint64_t checksum = 0;
+    const uint64_t start = rte_rdtsc_precise();
+    for (uint32_t i = 0; i + 4 <= options.lookups; i += 4) {
+        const xmm_t ips = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&addresses[i]));
+        rte_lpm_lookupx4(lpm, ips, hops, UINT32_MAX);
+        checksum += hops[0] + hops[1] + hops[2] + hops[3];
+    }
+    const uint64_t cycles = rte_rdtsc_precise() - start;
+
+    lookup_sink = checksum;
+
+    rte_lpm_free(lpm);
+    return static_cast<double>(cycles) / options.lookups;
+}
+
+double benchmark_ipv6(uint32_t prefix_count, const benchmark_options &options, uint32_t &added)
+{
+    rte_lpm6_config config = {};
+    config.max_rules = prefix_count;
+    config.number_tbl8s = options.number_tbl8s * 4;
+    rte_lpm6 *lpm6 = rte_lpm6_create("benchmark_lpm6", rte_socket_id(), &config);
+    if (lpm6 == nullptr) {
+        std::cerr << "Unable to create LPM6 table. Error code: " << rte_errno << std::endl;
+        return -1;
+    }
+
+    std::mt19937 generator(prefix_count);
+    uint8_t ip[RTE_LPM6_IPV6_ADDR_SIZE];
+    added = 0;
+    for (uint32_t i = 0; i < prefix_count; i++) {
+        for (uint8_t &byte : ip) {
+            byte = generator();
+        }
+        // IPv6 routing tables are dominated by /32 to /48 prefixes.
+        added += (rte_lpm6_add(lpm6, ip, 32 + generator() % 17, i & 0xff) == 0);
+    }
+
+    std::vector<uint8_t> addresses(static_cast<size_t>(options.lookups) * RTE_LPM6_IPV6_ADDR_SIZE);
+    for (uint8_t &byte : addresses) {
+        byte = generator();
+    }
+
+    int32_t hops[burst_size];
+    uint64_t checksum = 0;
+    const uint64_t start = rte_rdtsc_precise();
+    for (uint32_t i = 0; i + burst_size <= options.lookups; i += burst_size) {
+        auto *ips = reinterpret_cast<uint8_t (*)[RTE_LPM6_IPV6_ADDR_SIZE]>(&addresses[static_cast<size_t>(i) * RTE_LPM6_IPV6_ADDR_SIZE]);
+        rte_lpm6_lookup_bulk_func(lpm6, ips, hops, burst_size);
+        checksum += hops[0];
+    }
+    const uint64_t cycles = rte_rdtsc_precise() - start;
+
+    lookup_sink = checksum;
+
+    rte_lpm6_free(lpm6);
+    return static_cast<double>(cycles) / options.lookups;
+}
+
+bool parse_app_args(int argc, char **argv, benchmark_options &options)
+{
+    enum { OPT_LOOKUPS = 256, OPT_TBL8S };
+    static const option long_options[] = {
+        {"lookups", required_argument, nullptr, OPT_LOOKUPS},
+        {"tbl8s", required_argument, nullptr, OPT_TBL8S},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt = 0;
+    optind = 1;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_LOOKUPS:
+            options.lookups = strtoul(optarg, nullptr, 10);
+            if (options.lookups < burst_size) {
+                std::cerr << "Lookups must be at least " << burst_size << std::endl;
+                return false;
+            }
+            break;
+        case OPT_TBL8S:
+            options.number_tbl8s = strtoul(optarg, nullptr, 10);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t return_val = rte_eal_init(argc, argv);
+    if (return_val < 0) {
+        std::cerr << "Unable to initialize DPDK EAL (Environment Abstraction Layer). Error code: " << rte_errno << std::endl;
+        exit(1);
+    }
+
+    argc -= return_val;
+    argv += return_val;
+
+    benchmark_options options;
+    if (!parse_app_args(argc, argv, options)) {
+        std::cerr << "Usage: " << argv[0] << " [EAL arguments] -- [--lookups=N] [--tbl8s=N]" << std::endl;
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    std::cout << std::left << std::setw(10) << "family" << std::setw(12) << "prefixes" << std::setw(12) << "added"
+              << "cycles/lookup" << std::endl;
+
+    for (uint32_t prefix_count = 1000; prefix_count <= 1000000; prefix_count *= 10) {
+        uint32_t added = 0;
+        const double ipv4_cycles = benchmark_ipv4(prefix_count, options, added);
+        if (ipv4_cycles >= 0) {
+            std::cout << std::left << std::setw(10) << "ipv4" << std::setw(12) << prefix_count << std::setw(12) << added
+                      << std::fixed << std::setprecision(2) << ipv4_cycles << std::endl;
+        }
+
+        const double ipv6_cycles = benchmark_ipv6(prefix_count, options, added);
+        if (ipv6_cycles >= 0) {
+            std::cout << std::left << std::setw(10) << "ipv6" << std::setw(12) << prefix_count << std::setw(12) << added
+                      << std::fixed << std::setprecision(2) << ipv6_cycles << std::endl;
+        }
+    }
+
+    rte_eal_cleanup();
+    return 0;
+}
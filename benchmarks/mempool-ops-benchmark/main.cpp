@@ -0,0 +1,236 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <getopt.h>
+#include <rte_cycles.h>
+#include <rte_eal.h>
+#include <rte_errno.h>
+#include <rte_launch.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_pause.h>
+
+#include "mempool_ops.h"
+
+// This benchmark measures how many objects per second the lcores can allocate from and free to a packet memory pool
+// for every supported mempool driver. Each run uses 1..N lcores (N = number of lcores given to the EAL), so the
+// output tells which mempool driver scales best for the core count of a deployment.
+// To execute: sudo ./mempool-ops-benchmark --lcores=0-3 -n 4 -- --burst=32 --cache-size=512 --duration-ms=1000
+
+constexpr uint32_t max_burst = 512;
+
+struct benchmark_options {
+    const char *mempool_ops = nullptr;  // Benchmark a single mempool driver. nullptr means all supported drivers.
+    uint32_t burst = 32;                // Number of objects allocated and freed together.
+    uint32_t cache_size = 512;          // Per-lcore mempool cache size. 0 measures the mempool driver alone.
+    uint32_t duration_ms = 1000;        // Duration of a single run.
+};
+
+// Shared state of a benchmark run. Each lcore writes only its own slot in `operations`.
+struct benchmark_run {
+    rte_mempool *pool = nullptr;
+    uint32_t burst = 0;
+    uint64_t duration_cycles = 0;
+    std::atomic<bool> start{false};
+    alignas(RTE_CACHE_LINE_SIZE) uint64_t operations[RTE_MAX_LCORE] = {0};
+};
+
+int benchmark_lcore(void *arg)
+{
+    benchmark_run *run = static_cast<benchmark_run *>(arg);
+    void *objects[max_burst];
+    uint64_t operations = 0;
+
+    // All the lcores start together so that they compete for the mempool for the whole run.
+    while (!run->start.load(std::memory_order_acquire)) {
+        rte_pause();
+    }
+
+    const uint64_t end_cycles = rte_get_timer_cycles() + run->duration_cycles;
+    while (rte_get_timer_cycles() < end_cycles) {
+        if (rte_mempool_get_bulk(run->pool, objects, run->burst) == 0) {
+            rte_mempool_put_bulk(run->pool, objects, run->burst);
+            operations += run->burst;
+        }
+    }
+
+    run->operations[rte_lcore_id()] = operations;
+    return 0;
+}
+
+// Runs the benchmark for one mempool driver on `lcore_count` lcores (main lcore included). Returns the total number
+// of objects allocated and freed per second, or -1 if the memory pool could not be created.
+double run_benchmark(const char *ops_name, uint32_t lcore_count, const benchmark_options &options)
+{
+    // Every lcore can hold up to 1.5 * cache_size objects in its cache plus one burst in flight.
+    const uint32_t mbuf_count = 4096 + lcore_count * (options.cache_size * 2 + options.burst);
+
+    rte_mempool *pool = create_packet_pool("benchmark_pool", mbuf_count, options.cache_size, RTE_MBUF_DEFAULT_BUF_SIZE,
+                                           rte_socket_id(), ops_name);
+    if (pool == nullptr) {
+        std::cerr << "Unable to create memory pool with mempool ops " << ops_name << ". Error code: " << rte_errno << std::endl;
+        return -1;
+    }
+
+    benchmark_run *run = new benchmark_run();
+    run->pool = pool;
+    run->burst = options.burst;
+    run->duration_cycles = rte_get_timer_hz() * options.duration_ms / 1000;
+
+    uint32_t launched = 1;
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        if (launched >= lcore_count) {
+            break;
+        }
+        rte_eal_remote_launch(benchmark_lcore, run, lcore_id);
+        launched++;
+    }
+
+    run->start.store(true, std::memory_order_release);
+    benchmark_lcore(run);
+    rte_eal_mp_wait_lcore();
+
+    uint64_t total_operations = 0;
+    for (uint32_t i = 0; i < RTE_MAX_LCORE; i++) {
+        total_operations += run->operations[i];
+    }
+
+    delete run;
+    rte_mempool_free(pool);
+    return static_cast<double>(total_operations) * 1000.0 / options.duration_ms;
+}
+
+void print_usage(const char *program_name)
+{
+    std::cerr << "Usage: " << program_name << " [EAL arguments] -- [--mempool-ops=";
+    print_supported_mempool_ops(std::cerr);
+    std::cerr << "] [--burst=N] [--cache-size=N] [--duration-ms=N]" << std::endl;
+}
+
+bool parse_app_args(int argc, char **argv, benchmark_options &options)
+{
+    enum { OPT_MEMPOOL_OPS = 256, OPT_BURST, OPT_CACHE_SIZE, OPT_DURATION };
+    static const option long_options[] = {
+        {"mempool-ops", required_argument, nullptr, OPT_MEMPOOL_OPS},
+        {"burst", required_argument, nullptr, OPT_BURST},
+        {"cache-size", required_argument, nullptr, OPT_CACHE_SIZE},
+        {"duration-ms", required_argument, nullptr, OPT_DURATION},
+        {nullptr, 0, nullptr, 0}
+    };
+
+    int opt = 0;
+    optind = 1;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_MEMPOOL_OPS:
+            if (!is_supported_mempool_ops(optarg)) {
+                std::cerr << "Unsupported mempool ops: " << optarg << std::endl;
+                return false;
+            }
+            options.mempool_ops = optarg;
+            break;
+        case OPT_BURST:
+            options.burst = strtoul(optarg, nullptr, 10);
+            if (options.burst == 0 || options.burst > max_burst) {
+                std::cerr << "Burst must be between 1 and " << max_burst << std::endl;
+                return false;
+            }
+            break;
+        case OPT_CACHE_SIZE:
+            options.cache_size = strtoul(optarg, nullptr, 10);
+            if (options.cache_size > RTE_MEMPOOL_CACHE_MAX_SIZE) {
+                std::cerr << "Cache size must not exceed " << RTE_MEMPOOL_CACHE_MAX_SIZE << std::endl;
+                return false;
+            }
+            break;
+        case OPT_DURATION:
+            options.duration_ms = strtoul(optarg, nullptr, 10);
+            if (options.duration_ms == 0) {
+                std::cerr << "Duration must be greater than 0" << std::endl;
+                return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int32_t return_val = rte_eal_init(argc, argv);
+    if (return_val < 0) {
+        std::cerr << "Unable to initialize DPDK EAL (Environment Abstraction Layer). Error code: " << rte_errno << std::endl;
+        exit(1);
+    }
+
+    argc -= return_val;
+    argv += return_val;
+
+    benchmark_options options;
+    if (!parse_app_args(argc, argv, options)) {
+        print_usage(argv[0]);
+        rte_eal_cleanup();
+        exit(1);
+    }
+
+    const uint32_t max_lcores = rte_lcore_count();
+    std::cout << "Mempool ops benchmark. Burst: " << options.burst << " Cache size: " << options.cache_size
+              << " Duration: " << options.duration_ms << "ms" << std::endl;
+    std::cout << std::left << std::setw(12) << "ops" << std::setw(8) << "lcores" << std::setw(16) << "Mops/s"
+              << "Mops/s/lcore" << std::endl;
+
+    for (uint32_t i = 0; supported_mempool_ops[i] != nullptr; i++) {
+        const char *ops_name = supported_mempool_ops[i];
+        if (options.mempool_ops != nullptr && strcmp(options.mempool_ops, ops_name) != 0) {
+            continue;
+        }
+
+        for (uint32_t lcores = 1; lcores <= max_lcores; lcores++) {
+            // A single producer / single consumer ring is not safe with more than one lcore.
+            if (lcores > 1 && is_single_lcore_mempool_ops(ops_name)) {
+                break;
+            }
+
+            const double operations_per_second = run_benchmark(ops_name, lcores, options);
+            if (operations_per_second < 0) {
+                break;
+            }
+
+            std::cout << std::left << std::setw(12) << ops_name << std::setw(8) << lcores << std::fixed
+                      << std::setprecision(2) << std::setw(16) << operations_per_second / 1e6
+                      << operations_per_second / 1e6 / lcores << std::endl;
+        }
+    }
+
+    rte_eal_cleanup();
+    return 0;
+}
@@ -0,0 +1,226 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "app_telemetry.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mempool.h>
+#include <rte_telemetry.h>
+
+lcore_telemetry lcore_telemetry_counters[RTE_MAX_LCORE];
+
+// Counters of the previous call of a command, used to compute the rates. Several telemetry clients can call the same
+// command at the same time, so the snapshots are protected by a mutex.
+struct port_snapshot {
+    uint64_t tsc = 0;
+    rte_eth_stats stats = {};
+};
+
+struct lcore_snapshot {
+    uint64_t polls = 0;
+    uint64_t busy_polls = 0;
+    uint64_t packets = 0;
+    uint64_t busy_cycles = 0;
+    uint64_t idle_cycles = 0;
+};
+
+static std::mutex snapshot_mutex;
+static port_snapshot port_snapshots[RTE_MAX_ETHPORTS];
+static lcore_snapshot lcore_snapshots[RTE_MAX_LCORE];
+
+// Returns `delta` per second over `cycles` TSC cycles.
+static uint64_t per_second(uint64_t delta, uint64_t cycles)
+{
+    return (cycles == 0) ? 0 : static_cast<uint64_t>(static_cast<double>(delta) * rte_get_tsc_hz() / cycles);
+}
+
+// Adds an array of per queue rates to `data`. Returns false if the array cannot be allocated.
+static bool add_queue_rates(rte_tel_data *data, const char *name, const uint64_t *current, const uint64_t *previous,
+                            uint16_t queues, uint64_t cycles, uint64_t multiplier)
+{
+    rte_tel_data *rates = rte_tel_data_alloc();
+    if (rates == nullptr) {
+        return false;
+    }
+
+    rte_tel_data_start_array(rates, RTE_TEL_UINT_VAL);
+    for (uint16_t i = 0; i < queues; i++) {
+        rte_tel_data_add_array_uint(rates, per_second((current[i] - previous[i]) * multiplier, cycles));
+    }
+    rte_tel_data_add_dict_container(data, name, rates, 0);
+    return true;
+}
+
+static int rx_stats_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    if (params == nullptr || *params == '\0') {
+        return -EINVAL;
+    }
+
+    char *end = nullptr;
+    const unsigned long port_id = strtoul(params, &end, 10);
+    if (*end != '\0' || port_id >= RTE_MAX_ETHPORTS || !rte_eth_dev_is_valid_port(port_id)) {
+        return -EINVAL;
+    }
+
+    rte_eth_dev_info dev_info = {};
+    rte_eth_stats stats = {};
+    if (rte_eth_dev_info_get(port_id, &dev_info) != 0 || rte_eth_stats_get(port_id, &stats) != 0) {
+        return -EIO;
+    }
+
+    const std::lock_guard<std::mutex> lock(snapshot_mutex);
+    port_snapshot &previous = port_snapshots[port_id];
+    const uint64_t now = rte_rdtsc();
+    const uint64_t cycles = now - previous.tsc;
+
+    // The per queue counters exist for the first RTE_ETHDEV_QUEUE_STAT_CNTRS queues only.
+    const uint16_t rx_queues = RTE_MIN(dev_info.nb_rx_queues, static_cast<uint16_t>(RTE_ETHDEV_QUEUE_STAT_CNTRS));
+    const uint16_t tx_queues = RTE_MIN(dev_info.nb_tx_queues, static_cast<uint16_t>(RTE_ETHDEV_QUEUE_STAT_CNTRS));
+
+    rte_tel_data_start_dict(data);
+    rte_tel_data_add_dict_uint(data, "rx_pps", per_second(stats.ipackets - previous.stats.ipackets, cycles));
+    rte_tel_data_add_dict_uint(data, "rx_bps", per_second((stats.ibytes - previous.stats.ibytes) * 8, cycles));
+    rte_tel_data_add_dict_uint(data, "tx_pps", per_second(stats.opackets - previous.stats.opackets, cycles));
+    rte_tel_data_add_dict_uint(data, "tx_bps", per_second((stats.obytes - previous.stats.obytes) * 8, cycles));
+    rte_tel_data_add_dict_uint(data, "rx_missed", stats.imissed);
+    rte_tel_data_add_dict_uint(data, "rx_errors", stats.ierrors);
+    rte_tel_data_add_dict_uint(data, "rx_nombuf", stats.rx_nombuf);
+    rte_tel_data_add_dict_uint(data, "tx_errors", stats.oerrors);
+
+    uint64_t app_dropped = 0;
+    uint64_t app_queue_dropped = 0;
+    for (uint32_t i = 0; i < RTE_MAX_LCORE; i++) {
+        app_dropped += lcore_telemetry_counters[i].dropped.load(std::memory_order_relaxed);
+        app_queue_dropped += lcore_telemetry_counters[i].queue_dropped.load(std::memory_order_relaxed);
+    }
+    rte_tel_data_add_dict_uint(data, "app_dropped", app_dropped);
+    rte_tel_data_add_dict_uint(data, "app_queue_dropped", app_queue_dropped);
+
+    const bool added = add_queue_rates(data, "rx_queue_pps", stats.q_ipackets, previous.stats.q_ipackets, rx_queues, cycles, 1) &&
+                       add_queue_rates(data, "rx_queue_bps", stats.q_ibytes, previous.stats.q_ibytes, rx_queues, cycles, 8) &&
+                       add_queue_rates(data, "tx_queue_pps", stats.q_opackets, previous.stats.q_opackets, tx_queues, cycles, 1) &&
+                       add_queue_rates(data, "tx_queue_bps", stats.q_obytes, previous.stats.q_obytes, tx_queues, cycles, 8);
+
+    previous.tsc = now;
+    previous.stats = stats;
+    return added ? 0 : -ENOMEM;
+}
+
+static int lcore_busy_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    const std::lock_guard<std::mutex> lock(snapshot_mutex);
+    rte_tel_data_start_dict(data);
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const lcore_telemetry &counters = lcore_telemetry_counters[lcore_id];
+        lcore_snapshot &previous = lcore_snapshots[lcore_id];
+        lcore_snapshot current;
+        current.polls = counters.polls.load(std::memory_order_relaxed);
+        current.busy_polls = counters.busy_polls.load(std::memory_order_relaxed);
+        current.packets = counters.packets.load(std::memory_order_relaxed);
+        current.busy_cycles = counters.busy_cycles.load(std::memory_order_relaxed);
+        current.idle_cycles = counters.idle_cycles.load(std::memory_order_relaxed);
+        const uint64_t polls = current.polls - previous.polls;
+        const uint64_t busy_cycles = current.busy_cycles - previous.busy_cycles;
+        const uint64_t total_cycles = busy_cycles + current.idle_cycles - previous.idle_cycles;
+        const uint64_t packets = current.packets - previous.packets;
+        const uint64_t bursts = current.busy_polls - previous.busy_polls;
+
+        rte_tel_data *lcore = rte_tel_data_alloc();
+        if (lcore == nullptr) {
+            return -ENOMEM;
+        }
+        rte_tel_data_start_dict(lcore);
+        rte_tel_data_add_dict_uint(lcore, "polls", current.polls);
+        rte_tel_data_add_dict_uint(lcore, "busy_polls", current.busy_polls);
+        rte_tel_data_add_dict_uint(lcore, "packets", current.packets);
+        rte_tel_data_add_dict_uint(lcore, "dropped", counters.dropped.load(std::memory_order_relaxed));
+        rte_tel_data_add_dict_uint(lcore, "queue_dropped", counters.queue_dropped.load(std::memory_order_relaxed));
+        rte_tel_data_add_dict_uint(lcore, "busy_percent", (polls == 0) ? 0 : 100 * bursts / polls);
+        rte_tel_data_add_dict_uint(lcore, "busy_cycles", current.busy_cycles);
+        rte_tel_data_add_dict_uint(lcore, "idle_cycles", current.idle_cycles);
+        rte_tel_data_add_dict_uint(lcore, "cycles_busy_percent",
+                                   (total_cycles == 0) ? 0 : 100 * busy_cycles / total_cycles);
+        rte_tel_data_add_dict_uint(lcore, "cycles_per_packet", (packets == 0) ? 0 : busy_cycles / packets);
+        rte_tel_data_add_dict_uint(lcore, "cycles_per_burst", (bursts == 0) ? 0 : busy_cycles / bursts);
+
+        const std::string name = "lcore_" + std::to_string(lcore_id);
+        rte_tel_data_add_dict_container(data, name.c_str(), lcore, 0);
+        previous = current;
+    }
+
+    return 0;
+}
+
+static void add_mempool(rte_mempool *pool, void *arg)
+{
+    rte_tel_data *data = static_cast<rte_tel_data *>(arg);
+    rte_tel_data *info = rte_tel_data_alloc();
+    if (info == nullptr) {
+        return;
+    }
+
+    const uint32_t free_count = rte_mempool_avail_count(pool);
+    rte_tel_data_start_dict(info);
+    rte_tel_data_add_dict_uint(info, "size", pool->size);
+    rte_tel_data_add_dict_uint(info, "free", free_count);
+    rte_tel_data_add_dict_uint(info, "in_use", pool->size - free_count);
+    rte_tel_data_add_dict_uint(info, "cache_size", pool->cache_size);
+    rte_tel_data_add_dict_string(info, "ops", rte_mempool_get_ops(pool->ops_index)->name);
+    rte_tel_data_add_dict_container(data, pool->name, info, 0);
+}
+
+static int mempool_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    rte_tel_data_start_dict(data);
+    rte_mempool_walk(add_mempool, data);
+    return 0;
+}
+
+// Reports the cycles of app_telemetry_poll() to the EAL for /eal/lcore/usage and rte_lcore_dump(). Lcores which never
+// polled have no usage.
+static int lcore_usage(unsigned int lcore_id, rte_lcore_usage *usage)
+{
+    const lcore_telemetry &counters = lcore_telemetry_counters[lcore_id];
+    usage->busy_cycles = counters.busy_cycles.load(std::memory_order_relaxed);
+    usage->total_cycles = usage->busy_cycles + counters.idle_cycles.load(std::memory_order_relaxed);
+    return (usage->total_cycles == 0) ? -1 : 0;
+}
+
+bool app_telemetry_register()
+{
+    rte_lcore_register_usage_cb(lcore_usage);
+    return rte_telemetry_register_cmd("/app/rx_stats", rx_stats_command,
+                                      "Returns the packet and bit rates per queue and the drop counters of a port. Parameters: int port_id") == 0 &&
+           rte_telemetry_register_cmd("/app/lcore_busy", lcore_busy_command,
+                                      "Returns the polls, busyness and cycles per packet per lcore. Takes no parameters") == 0 &&
+           rte_telemetry_register_cmd("/app/mempool", mempool_command,
+                                      "Returns the size, free and in use memory buffers per memory pool. Takes no parameters") == 0;
+}
@@ -0,0 +1,121 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+
+#include "perf_counters.h"
+
+// Application metrics over the DPDK telemetry socket (rte_telemetry). The EAL serves the socket
+// /var/run/dpdk/<file-prefix>/dpdk_telemetry.v2, which can be queried with usertools/dpdk-telemetry.py. The
+// applications register these commands:
+//   /app/rx_stats,<port_id> : packets and bytes per second per RX / TX queue and the drop counters of a port.
+//   /app/lcore_busy         : polls, busy polls (polls which returned packets), busyness, busy and idle cycles, cycles
+//                             per packet and cycles per burst per lcore.
+//   /app/mempool            : size, free and in use memory buffers per memory pool.
+// The rates and the busyness cover the time since the previous call of the same command.
+//
+// The NIC counters are read from the driver when a command is called. The per lcore counters below are written by the
+// hot loops: every lcore writes only its own cache line with plain stores, and the telemetry thread reads them without
+// locking, so updating them costs the same as a local counter.
+//
+// Busy polling lcores always show 100% in `top`. To tell how busy they really are, every poll also reads the TSC: the
+// cycles from one poll to the next are busy cycles if the first poll returned packets (they were spent processing
+// them), otherwise idle cycles. The busy cycles divided by the packets and by the busy polls are the cycles per packet
+// and per burst. The busy and total cycles are also reported to the EAL (rte_lcore_register_usage_cb()), so they show
+// up in the /eal/lcore/usage telemetry command and in rte_lcore_dump().
+
+struct alignas(RTE_CACHE_LINE_SIZE) lcore_telemetry {
+    std::atomic<uint64_t> polls{0};
+    std::atomic<uint64_t> busy_polls{0};
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> dropped{0};       // Packets dropped by the application (e.g. denied by the ACL).
+    std::atomic<uint64_t> queue_dropped{0}; // Packets dropped because a software queue was full (TX queue, event
+                                            // device, reorder buffer).
+    std::atomic<uint64_t> busy_cycles{0};   // TSC cycles after polls which returned packets.
+    std::atomic<uint64_t> idle_cycles{0};   // TSC cycles after empty polls (and sleeps, see app_telemetry_idle()).
+    uint64_t last_tsc = 0;                  // Only used by the lcore: TSC of the previous poll, 0 before the first.
+    bool last_busy = false;                 // Only used by the lcore: the previous poll returned packets.
+};
+
+extern lcore_telemetry lcore_telemetry_counters[RTE_MAX_LCORE];
+
+// Adds to a counter which only the calling lcore writes. A relaxed load and store instead of fetch_add(): there is no
+// other writer, so no locked instruction is needed.
+static inline void telemetry_counter_add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Adds the cycles since the previous poll to the busy or idle cycles of the lcore and starts the next period.
+static inline void telemetry_account_cycles(lcore_telemetry &counters, bool busy)
+{
+    const uint64_t now = rte_rdtsc();
+    if (counters.last_tsc != 0) {
+        telemetry_counter_add(counters.last_busy ? counters.busy_cycles : counters.idle_cycles, now - counters.last_tsc);
+    }
+    counters.last_tsc = now;
+    counters.last_busy = busy;
+}
+
+// Records one poll (RX burst, event dequeue, TX burst, ...) of the calling lcore which returned `count` packets. Must
+// be called from an EAL lcore.
+static inline void app_telemetry_poll(uint16_t count)
+{
+    lcore_telemetry &counters = lcore_telemetry_counters[rte_lcore_id()];
+    telemetry_account_cycles(counters, count > 0);
+    perf_counters_poll(count);
+    telemetry_counter_add(counters.polls, 1);
+    if (count > 0) {
+        telemetry_counter_add(counters.busy_polls, 1);
+        telemetry_counter_add(counters.packets, count);
+    }
+}
+
+// Ends the busy period of the calling lcore without counting a poll. Called before the lcore sleeps, so that the sleep
+// counts as idle cycles. Must be called from an EAL lcore.
+static inline void app_telemetry_idle()
+{
+    telemetry_account_cycles(lcore_telemetry_counters[rte_lcore_id()], false);
+    perf_counters_poll(0);
+}
+
+// Records packets which the calling lcore dropped. Must be called from an EAL lcore.
+static inline void app_telemetry_drop(uint32_t count)
+{
+    telemetry_counter_add(lcore_telemetry_counters[rte_lcore_id()].dropped, count);
+}
+
+// Records packets which the calling lcore dropped because a software queue was full. Must be called from an EAL lcore.
+static inline void app_telemetry_queue_drop(uint32_t count)
+{
+    telemetry_counter_add(lcore_telemetry_counters[rte_lcore_id()].queue_dropped, count);
+}
+
+// Registers the /app telemetry commands and the lcore usage callback of the EAL. Returns false if a command cannot be
+// registered.
+bool app_telemetry_register();
@@ -0,0 +1,193 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "event_log.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <rte_errno.h>
+#include <rte_thread.h>
+
+// Records per ring. At 32 bytes per record a ring takes 256KB per lcore.
+constexpr uint32_t event_ring_size = 8192;
+constexpr uint32_t event_drain_burst = 64;
+
+event_log_lcore event_log_lcores[RTE_MAX_LCORE];
+
+static FILE *log_file = nullptr;
+static uint64_t start_tsc = 0;
+static rte_thread_t writer_thread_id = {};
+static std::atomic<bool> writer_stop{false};
+
+// The events are defined by static initializers in other translation units, so the formats are a function local static
+// which is constructed on first use.
+static std::vector<std::string> &event_formats()
+{
+    static std::vector<std::string> formats;
+    return formats;
+}
+
+uint32_t event_log_define(const char *format)
+{
+    event_formats().emplace_back(format);
+    return event_formats().size() - 1;
+}
+
+// Writes one record as `<microseconds since start> lcore <id> <formatted event>`.
+static void write_record(uint32_t lcore_id, const event_record &record)
+{
+    const double time_us = static_cast<double>(record.tsc - start_tsc) * 1000000.0 / rte_get_tsc_hz();
+    fprintf(log_file, "%.3f lcore %u ", time_us, lcore_id);
+
+    const std::vector<std::string> &formats = event_formats();
+    if (record.event >= formats.size()) {
+        fprintf(log_file, "unknown event %u\n", record.event);
+        return;
+    }
+
+    const uint64_t args[] = {record.arg0, record.arg1, record.arg2};
+    uint32_t next_arg = 0;
+    const char *format = formats[record.event].c_str();
+    while (*format != '\0') {
+        if (format[0] == '{' && format[1] == '}' && next_arg < RTE_DIM(args)) {
+            fprintf(log_file, "%" PRIu64, args[next_arg++]);
+            format += 2;
+        } else {
+            fputc(*format++, log_file);
+        }
+    }
+    fputc('\n', log_file);
+}
+
+// Drains all rings once. Returns the number of records written.
+static uint32_t drain_rings()
+{
+    event_record records[event_drain_burst];
+    uint32_t written = 0;
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rte_ring *ring = event_log_lcores[lcore_id].ring;
+        if (ring == nullptr) {
+            continue;
+        }
+
+        const uint32_t count = rte_ring_sc_dequeue_burst_elem(ring, records, sizeof(event_record), event_drain_burst,
+                                                              nullptr);
+        for (uint32_t i = 0; i < count; i++) {
+            write_record(lcore_id, records[i]);
+        }
+        written += count;
+    }
+    return written;
+}
+
+static uint32_t writer_thread(void *arg)
+{
+    while (!writer_stop.load(std::memory_order_relaxed)) {
+        if (drain_rings() == 0) {
+            fflush(log_file);
+            rte_delay_us_sleep(1000);
+        }
+    }
+
+    while (drain_rings() != 0) {
+    }
+    fflush(log_file);
+    return 0;
+}
+
+static void free_rings()
+{
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        rte_ring_free(event_log_lcores[lcore_id].ring);
+        event_log_lcores[lcore_id].ring = nullptr;
+    }
+}
+
+static void close_log_file()
+{
+    if (log_file != stdout) {
+        fclose(log_file);
+    }
+    log_file = nullptr;
+}
+
+bool event_log_start(const char *path)
+{
+    log_file = (path == nullptr) ? stdout : fopen(path, "w");
+    if (log_file == nullptr) {
+        std::cerr << "Unable to create event log file: " << path << std::endl;
+        return false;
+    }
+
+    // The rings are allocated before the lcores start polling, so a non null ring means the log is running.
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const std::string name = "event_log_" + std::to_string(lcore_id);
+        rte_ring *ring = rte_ring_create_elem(name.c_str(), sizeof(event_record), event_ring_size,
+                                              rte_lcore_to_socket_id(lcore_id), RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (ring == nullptr) {
+            std::cerr << "Unable to create the event log ring of lcore " << lcore_id << ". Error code: " << rte_errno << std::endl;
+            free_rings();
+            close_log_file();
+            return false;
+        }
+        event_log_lcores[lcore_id].ring = ring;
+    }
+
+    start_tsc = rte_rdtsc();
+    writer_stop.store(false, std::memory_order_relaxed);
+    if (rte_thread_create_control(&writer_thread_id, "event-log", writer_thread, nullptr) != 0) {
+        std::cerr << "Unable to start the event log thread" << std::endl;
+        free_rings();
+        close_log_file();
+        return false;
+    }
+    return true;
+}
+
+void event_log_stop()
+{
+    if (log_file == nullptr) {
+        return;
+    }
+
+    writer_stop.store(true, std::memory_order_relaxed);
+    rte_thread_join(writer_thread_id, nullptr);
+    free_rings();
+
+    uint64_t dropped = 0;
+    for (const event_log_lcore &log : event_log_lcores) {
+        dropped += log.dropped.load(std::memory_order_relaxed);
+    }
+    if (dropped != 0) {
+        std::cout << "Event log records dropped (ring full): " << dropped << std::endl;
+    }
+
+    close_log_file();
+}
@@ -0,0 +1,93 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+#include <rte_ring_elem.h>
+
+// Binary event log for diagnostics from the data path. Printing with std::cout takes microseconds, takes a lock and can
+// block on the terminal, which stalls the poll loop and makes the NIC drop packets. Instead an lcore writes a 32 byte
+// record (TSC, event id and three numbers) into its own single producer / single consumer ring (rte_ring), which takes
+// a few nanoseconds and never waits. A control thread drains the rings, formats the records and writes them to the log
+// file, or to stdout if no file is given.
+//
+// If a ring is full the record is dropped and counted; the poll loop is never blocked. Records of different lcores are
+// written in the order they are drained, the TSC of every record gives the exact order.
+//
+// Usage:
+//   const uint16_t packet_received = event_log_define("Packet received. Length: {}");   // Before event_log_start().
+//   event_log_write(packet_received, packet->data_len);                                 // On any lcore.
+
+// The arguments are formatted in the order arg0, arg1, arg2. arg2 is the small one so the record stays 32 bytes.
+struct alignas(32) event_record {
+    uint64_t tsc;
+    uint32_t event;     // Id returned by event_log_define().
+    uint32_t arg2;
+    uint64_t arg0;
+    uint64_t arg1;
+};
+
+static_assert(sizeof(event_record) == 32, "event records must stay 32 bytes, two per cache line");
+
+// The ring of an lcore and the records dropped because it was full.
+struct alignas(RTE_CACHE_LINE_SIZE) event_log_lcore {
+    rte_ring *ring = nullptr;
+    std::atomic<uint64_t> dropped{0};
+};
+
+extern event_log_lcore event_log_lcores[RTE_MAX_LCORE];
+
+// Defines an event and returns its id. Every `{}` in `format` is replaced by the next argument of the record. Must be
+// called before event_log_start().
+uint32_t event_log_define(const char *format);
+
+// Creates a ring for every lcore and starts the writer thread. The events are written to `path`, or to stdout if `path`
+// is nullptr. Returns false if a ring, the file or the thread cannot be created.
+bool event_log_start(const char *path);
+
+// Writes the remaining records, stops the writer thread and frees the rings. Prints the dropped records, if any.
+void event_log_stop();
+
+// Records an event on the calling lcore. Does nothing if the event log is not started or the caller is not an lcore.
+static inline void event_log_write(uint32_t event, uint64_t arg0 = 0, uint64_t arg1 = 0, uint32_t arg2 = 0)
+{
+    const uint32_t lcore_id = rte_lcore_id();
+    if (unlikely(lcore_id >= RTE_MAX_LCORE)) {
+        return;
+    }
+
+    event_log_lcore &log = event_log_lcores[lcore_id];
+    if (unlikely(log.ring == nullptr)) {
+        return;
+    }
+
+    const event_record record = {rte_rdtsc(), event, arg2, arg0, arg1};
+    if (unlikely(rte_ring_sp_enqueue_elem(log.ring, &record, sizeof(record)) != 0)) {
+        log.dropped.store(log.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,72 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "mempool_ops.h"
+
+#include <cstring>
+#include <rte_errno.h>
+#include <rte_mbuf.h>
+
+const char *const supported_mempool_ops[] = {
+    "ring_mp_mc",
+    "ring_sp_sc",
+    "stack",
+    "lf_stack",
+    "bucket",
+    nullptr
+};
+
+bool is_supported_mempool_ops(const char *ops_name)
+{
+    for (uint32_t i = 0; supported_mempool_ops[i] != nullptr; i++) {
+        if (strcmp(supported_mempool_ops[i], ops_name) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool is_single_lcore_mempool_ops(const char *ops_name)
+{
+    return strcmp(ops_name, "ring_sp_sc") == 0;
+}
+
+void print_supported_mempool_ops(std::ostream &stream)
+{
+    for (uint32_t i = 0; supported_mempool_ops[i] != nullptr; i++) {
+        stream << (i == 0 ? "" : "|") << supported_mempool_ops[i];
+    }
+}
+
+rte_mempool *create_packet_pool(const char *name, uint32_t mbuf_count, uint32_t cache_size, uint16_t data_room_size,
+                                int32_t socket_id, const char *ops_name)
+{
+    if (!is_supported_mempool_ops(ops_name)) {
+        rte_errno = EINVAL;
+        return nullptr;
+    }
+
+    // rte_pktmbuf_pool_create_by_ops() works exactly like rte_pktmbuf_pool_create() except that the mempool driver is
+    // given by name instead of using the default one.
+    return rte_pktmbuf_pool_create_by_ops(name, mbuf_count, cache_size, 0, data_room_size, socket_id, ops_name);
+}
@@ -0,0 +1,59 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <rte_mempool.h>
+
+// A DPDK memory pool stores its free objects in a "mempool driver" (also called mempool ops). By default
+// rte_pktmbuf_pool_create() uses the ring based driver `ring_mp_mc`, which is safe for any number of producer and
+// consumer threads. Other drivers trade this generality for speed on specific core counts:
+//   ring_mp_mc : lock-free ring, multi producer / multi consumer (DPDK default).
+//   ring_sp_sc : lock-free ring, single producer / single consumer. Only safe when one lcore allocates and frees.
+//   stack      : spinlock protected stack. Objects freed last are reused first, so they are usually still in cache.
+//   lf_stack   : lock-free stack. Same LIFO behaviour as `stack` without the spinlock.
+//   bucket     : allocates objects in contiguous buckets, good for bulk allocations on one lcore.
+// The mempool driver libraries (librte_mempool_ring, librte_mempool_stack, librte_mempool_bucket) must be linked or
+// loaded with the EAL argument `-d` for the driver to be available.
+
+// The mempool driver used when the user does not pass one.
+constexpr const char *default_mempool_ops = "ring_mp_mc";
+
+// Names of the mempool drivers the tutorials accept. The list is terminated with nullptr.
+extern const char *const supported_mempool_ops[];
+
+// Returns true if `ops_name` is one of the supported mempool drivers.
+bool is_supported_mempool_ops(const char *ops_name);
+
+// Returns true if `ops_name` is only safe when a single lcore allocates and frees the objects (ring_sp_sc).
+bool is_single_lcore_mempool_ops(const char *ops_name);
+
+// Prints the supported mempool drivers separated by '|'. Used in the usage message of the tutorials.
+void print_supported_mempool_ops(std::ostream &stream);
+
+// Creates a packet memory pool which uses the mempool driver `ops_name`. This is a thin wrapper over
+// rte_pktmbuf_pool_create_by_ops(). Returns nullptr (and rte_errno is set) if the pool cannot be created, for example
+// when the mempool driver is not loaded.
+rte_mempool *create_packet_pool(const char *name, uint32_t mbuf_count, uint32_t cache_size, uint16_t data_room_size,
+                                int32_t socket_id, const char *ops_name);
@@ -0,0 +1,304 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "metrics_exporter.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_mempool.h>
+#include <rte_thread.h>
+
+#include "app_telemetry.h"
+
+struct metrics_exporter {
+    int listen_fd = -1;
+    rte_thread_t thread_id = {};
+    bool thread_started = false;
+    std::atomic<bool> stop{false};
+    std::vector<std::pair<metrics_collector, void *>> collectors;
+};
+
+void metrics_append_header(std::string &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void metrics_append_sample(std::string &out, const char *name, const std::string &labels, uint64_t value)
+{
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += std::to_string(value);
+    out += '\n';
+}
+
+static void collect_port_metrics(std::string &out)
+{
+    struct port_counter {
+        const char *name;
+        const char *help;
+        uint64_t rte_eth_stats::*field;
+    };
+    static const port_counter counters[] = {
+        {"dpdk_port_rx_packets_total", "Packets received by the port.", &rte_eth_stats::ipackets},
+        {"dpdk_port_tx_packets_total", "Packets transmitted by the port.", &rte_eth_stats::opackets},
+        {"dpdk_port_rx_bytes_total", "Bytes received by the port.", &rte_eth_stats::ibytes},
+        {"dpdk_port_tx_bytes_total", "Bytes transmitted by the port.", &rte_eth_stats::obytes},
+        {"dpdk_port_rx_missed_total", "Packets dropped by the NIC because the receive ring was full.", &rte_eth_stats::imissed},
+        {"dpdk_port_rx_errors_total", "Erroneous received packets.", &rte_eth_stats::ierrors},
+        {"dpdk_port_rx_nombuf_total", "Receive buffer allocation failures.", &rte_eth_stats::rx_nombuf},
+        {"dpdk_port_tx_errors_total", "Failed transmitted packets.", &rte_eth_stats::oerrors},
+    };
+
+    rte_eth_stats stats[RTE_MAX_ETHPORTS] = {};
+    bool valid[RTE_MAX_ETHPORTS] = {};
+    uint16_t port_id = 0;
+    RTE_ETH_FOREACH_DEV(port_id) {
+        valid[port_id] = (rte_eth_stats_get(port_id, &stats[port_id]) == 0);
+    }
+
+    for (const port_counter &counter : counters) {
+        metrics_append_header(out, counter.name, "counter", counter.help);
+        RTE_ETH_FOREACH_DEV(port_id) {
+            if (valid[port_id]) {
+                metrics_append_sample(out, counter.name, "port=\"" + std::to_string(port_id) + "\"", stats[port_id].*counter.field);
+            }
+        }
+    }
+
+    // The extended statistics differ per driver, so they are exported as one metric with the xstat name as label.
+    metrics_append_header(out, "dpdk_port_xstat", "untyped", "Extended statistics of the port driver (rte_eth_xstats).");
+    RTE_ETH_FOREACH_DEV(port_id) {
+        const int32_t count = rte_eth_xstats_get_names(port_id, nullptr, 0);
+        if (count <= 0) {
+            continue;
+        }
+
+        std::vector<rte_eth_xstat_name> names(count);
+        std::vector<rte_eth_xstat> values(count);
+        if (rte_eth_xstats_get_names(port_id, names.data(), count) != count ||
+            rte_eth_xstats_get(port_id, values.data(), count) != count) {
+            continue;
+        }
+
+        for (int32_t i = 0; i < count; i++) {
+            metrics_append_sample(out, "dpdk_port_xstat", "port=\"" + std::to_string(port_id) + "\",name=\"" +
+                                  names[values[i].id].name + "\"", values[i].value);
+        }
+    }
+}
+
+static void add_mempool(rte_mempool *pool, void *arg)
+{
+    static_cast<std::vector<rte_mempool *> *>(arg)->push_back(pool);
+}
+
+static void collect_mempool_metrics(std::string &out)
+{
+    // The samples of a metric must follow each other, so the pools are listed first and then written per metric.
+    std::vector<rte_mempool *> pools;
+    rte_mempool_walk(add_mempool, &pools);
+
+    metrics_append_header(out, "dpdk_mempool_size", "gauge", "Memory buffers in the memory pool.");
+    for (const rte_mempool *pool : pools) {
+        metrics_append_sample(out, "dpdk_mempool_size", std::string("pool=\"") + pool->name + "\"", pool->size);
+    }
+
+    metrics_append_header(out, "dpdk_mempool_in_use", "gauge", "Memory buffers of the memory pool in use.");
+    for (const rte_mempool *pool : pools) {
+        metrics_append_sample(out, "dpdk_mempool_in_use", std::string("pool=\"") + pool->name + "\"",
+                              rte_mempool_in_use_count(pool));
+    }
+}
+
+static void collect_lcore_metrics(std::string &out)
+{
+    struct lcore_counter {
+        const char *name;
+        const char *help;
+        std::atomic<uint64_t> lcore_telemetry::*field;
+    };
+    static const lcore_counter counters[] = {
+        {"app_lcore_polls_total", "Polls of the lcore.", &lcore_telemetry::polls},
+        {"app_lcore_busy_polls_total", "Polls of the lcore which returned packets.", &lcore_telemetry::busy_polls},
+        {"app_lcore_packets_total", "Packets polled by the lcore.", &lcore_telemetry::packets},
+        {"app_lcore_dropped_total", "Packets dropped by the application on the lcore.", &lcore_telemetry::dropped},
+        {"app_lcore_queue_dropped_total", "Packets dropped on the lcore because a software queue was full.", &lcore_telemetry::queue_dropped},
+        {"app_lcore_busy_cycles_total", "TSC cycles of the lcore after polls which returned packets.", &lcore_telemetry::busy_cycles},
+        {"app_lcore_idle_cycles_total", "TSC cycles of the lcore after empty polls.", &lcore_telemetry::idle_cycles},
+    };
+
+    for (const lcore_counter &counter : counters) {
+        metrics_append_header(out, counter.name, "counter", counter.help);
+        uint32_t lcore_id = 0;
+        RTE_LCORE_FOREACH(lcore_id) {
+            metrics_append_sample(out, counter.name, "lcore=\"" + std::to_string(lcore_id) + "\"",
+                                  (lcore_telemetry_counters[lcore_id].*counter.field).load(std::memory_order_relaxed));
+        }
+    }
+}
+
+static std::string collect_metrics(const metrics_exporter *exporter)
+{
+    std::string out;
+    collect_port_metrics(out);
+    collect_mempool_metrics(out);
+    collect_lcore_metrics(out);
+    for (const auto &collector : exporter->collectors) {
+        collector.first(out, collector.second);
+    }
+    return out;
+}
+
+// Answers one HTTP request. Only `GET /metrics` is served, every connection is closed after the response.
+static void handle_connection(const metrics_exporter *exporter, int fd)
+{
+    char request[1024];
+    const ssize_t length = recv(fd, request, sizeof(request) - 1, 0);
+    if (length <= 0) {
+        return;
+    }
+    request[length] = '\0';
+
+    std::string status = "404 Not Found";
+    std::string body = "Not found. Use /metrics\n";
+    if (strncmp(request, "GET /metrics ", strlen("GET /metrics ")) == 0) {
+        status = "200 OK";
+        body = collect_metrics(exporter);
+    }
+
+    const std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                 std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const ssize_t result = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            return;
+        }
+        sent += result;
+    }
+}
+
+static uint32_t exporter_thread(void *arg)
+{
+    metrics_exporter *exporter = static_cast<metrics_exporter *>(arg);
+    pollfd listen_poll = {exporter->listen_fd, POLLIN, 0};
+
+    // The poll timeout bounds how long metrics_exporter_stop() waits for the thread.
+    while (!exporter->stop.load(std::memory_order_relaxed)) {
+        if (poll(&listen_poll, 1, 100) <= 0) {
+            continue;
+        }
+
+        const int fd = accept(exporter->listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        // A client which does not send its request within one second is dropped.
+        const timeval timeout = {1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        handle_connection(exporter, fd);
+        close(fd);
+    }
+
+    return 0;
+}
+
+metrics_exporter *metrics_exporter_create(uint16_t tcp_port)
+{
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::cerr << "Unable to create the metrics socket. Error: " << strerror(errno) << std::endl;
+        return nullptr;
+    }
+
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    // Bound to localhost only: the metrics are for a local scraper or an agent, not for the network.
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(tcp_port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0) {
+        std::cerr << "Unable to listen on 127.0.0.1:" << tcp_port << " for metrics. Error: " << strerror(errno) << std::endl;
+        close(fd);
+        return nullptr;
+    }
+
+    metrics_exporter *exporter = new metrics_exporter;
+    exporter->listen_fd = fd;
+    return exporter;
+}
+
+void metrics_exporter_add_collector(metrics_exporter *exporter, metrics_collector collector, void *arg)
+{
+    exporter->collectors.emplace_back(collector, arg);
+}
+
+bool metrics_exporter_start(metrics_exporter *exporter)
+{
+    if (rte_thread_create_control(&exporter->thread_id, "metrics", exporter_thread, exporter) != 0) {
+        std::cerr << "Unable to start the metrics thread" << std::endl;
+        return false;
+    }
+
+    exporter->thread_started = true;
+    return true;
+}
+
+void metrics_exporter_stop(metrics_exporter *exporter)
+{
+    if (exporter == nullptr) {
+        return;
+    }
+
+    if (exporter->thread_started) {
+        exporter->stop.store(true, std::memory_order_relaxed);
+        rte_thread_join(exporter->thread_id, nullptr);
+    }
+    close(exporter->listen_fd);
+    delete exporter;
+}
@@ -0,0 +1,57 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Prometheus metrics exporter. A small HTTP server on 127.0.0.1 answers `GET /metrics` with the metrics in the
+// Prometheus text format (https://prometheus.io/docs/instrumenting/exposition_formats/). It runs on a DPDK control
+// thread, which the EAL keeps off the cores of the lcores, so a scrape never takes time from the data path.
+//
+// Every scrape reads the counters fresh: the port counters and extended statistics (rte_eth_xstats) of every port,
+// the memory pool utilisation, the per lcore counters of app_telemetry.h, and the metrics of the registered collectors.
+// The per lcore counters are read without locks, the data path never waits for a scrape.
+
+// Appends metrics in the Prometheus text format to `out`. Called on the exporter thread for every scrape.
+using metrics_collector = void (*)(std::string &out, void *arg);
+
+struct metrics_exporter;
+
+// Creates the exporter listening on 127.0.0.1:`tcp_port`. Returns nullptr if the port cannot be bound.
+metrics_exporter *metrics_exporter_create(uint16_t tcp_port);
+
+// Adds a collector with application specific metrics. Must be called before metrics_exporter_start().
+void metrics_exporter_add_collector(metrics_exporter *exporter, metrics_collector collector, void *arg);
+
+// Starts the exporter thread. Returns false if the thread cannot be created.
+bool metrics_exporter_start(metrics_exporter *exporter);
+
+// Stops the exporter thread and frees the exporter.
+void metrics_exporter_stop(metrics_exporter *exporter);
+
+// Appends the `# HELP` and `# TYPE` lines of a metric.
+void metrics_append_header(std::string &out, const char *name, const char *type, const char *help);
+
+// Appends one sample line `name{labels} value`. `labels` can be empty.
+void metrics_append_sample(std::string &out, const char *name, const std::string &labels, uint64_t value);
@@ -0,0 +1,68 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "packet_metadata.h"
+
+int32_t packet_rx_tsc_offset = -1;
+int32_t packet_flow_id_offset = -1;
+int32_t packet_sequence_offset = -1;
+int32_t packet_class_id_offset = -1;
+
+uint64_t packet_rx_tsc_flag = 0;
+uint64_t packet_flow_id_flag = 0;
+uint64_t packet_sequence_flag = 0;
+uint64_t packet_class_id_flag = 0;
+
+// Registers a dynamic field of `size` bytes and its flag. Returns false if either cannot be registered.
+static bool register_field(const char *field_name, size_t size, size_t align, const char *flag_name,
+                           int32_t &offset, uint64_t &flag)
+{
+    rte_mbuf_dynfield field = {};
+    rte_strscpy(field.name, field_name, sizeof(field.name));
+    field.size = size;
+    field.align = align;
+
+    rte_mbuf_dynflag dynflag = {};
+    rte_strscpy(dynflag.name, flag_name, sizeof(dynflag.name));
+
+    // Registering a name again returns the offset of the first registration if the size and alignment match.
+    offset = rte_mbuf_dynfield_register(&field);
+    const int32_t bit = rte_mbuf_dynflag_register(&dynflag);
+    if (offset < 0 || bit < 0) {
+        return false;
+    }
+
+    flag = RTE_BIT64(bit);
+    return true;
+}
+
+bool packet_metadata_register()
+{
+    return register_field("dpdk_tutorials_rx_tsc", sizeof(uint64_t), alignof(uint64_t),
+                          "dpdk_tutorials_rx_tsc_valid", packet_rx_tsc_offset, packet_rx_tsc_flag) &&
+           register_field("dpdk_tutorials_flow_id", sizeof(uint32_t), alignof(uint32_t),
+                          "dpdk_tutorials_flow_id_valid", packet_flow_id_offset, packet_flow_id_flag) &&
+           register_field(RTE_REORDER_SEQN_DYNFIELD_NAME, sizeof(rte_reorder_seqn_t), alignof(rte_reorder_seqn_t),
+                          "dpdk_tutorials_sequence_valid", packet_sequence_offset, packet_sequence_flag) &&
+           register_field("dpdk_tutorials_class_id", sizeof(uint32_t), alignof(uint32_t),
+                          "dpdk_tutorials_class_id_valid", packet_class_id_offset, packet_class_id_flag);
+}
@@ -0,0 +1,119 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
+#include <rte_reorder.h>
+
+// Per packet metadata in mbuf dynamic fields (rte_mbuf_dyn). A stage which computes a value stores it in the mbuf of
+// the packet, and every later stage reads it from there instead of computing it again or keeping a side array. The
+// dynamic fields live in the reserved area of the mbuf, so they cost no extra allocation.
+//
+//   rx_tsc   : TSC when the packet was received.
+//   flow_id  : flow hash of the packet (RSS hash of the NIC or hash of the 5-tuple).
+//   sequence : stream sequence number. Registered under the name used by rte_reorder, so a reorder buffer reads the
+//              same field.
+//   class_id : classification result, e.g. the ACL action.
+//
+// Every field has a dynamic flag in `ol_flags` which is set when the field is written. The NIC drivers reset
+// `ol_flags` on receive, so a field left over from an earlier use of the mbuf is never read as valid.
+
+extern int32_t packet_rx_tsc_offset;
+extern int32_t packet_flow_id_offset;
+extern int32_t packet_sequence_offset;
+extern int32_t packet_class_id_offset;
+
+extern uint64_t packet_rx_tsc_flag;
+extern uint64_t packet_flow_id_flag;
+extern uint64_t packet_sequence_flag;
+extern uint64_t packet_class_id_flag;
+
+// Registers the dynamic fields and flags. Must be called after rte_eal_init() and before any accessor below is used.
+// Calling it again is harmless. Returns false (and rte_errno is set) if the mbuf has no room left.
+bool packet_metadata_register();
+
+static inline void packet_set_rx_tsc(rte_mbuf *packet, uint64_t tsc)
+{
+    *RTE_MBUF_DYNFIELD(packet, packet_rx_tsc_offset, uint64_t *) = tsc;
+    packet->ol_flags |= packet_rx_tsc_flag;
+}
+
+static inline bool packet_has_rx_tsc(const rte_mbuf *packet)
+{
+    return packet->ol_flags & packet_rx_tsc_flag;
+}
+
+static inline uint64_t packet_rx_tsc(const rte_mbuf *packet)
+{
+    return *RTE_MBUF_DYNFIELD(packet, packet_rx_tsc_offset, const uint64_t *);
+}
+
+static inline void packet_set_flow_id(rte_mbuf *packet, uint32_t flow_id)
+{
+    *RTE_MBUF_DYNFIELD(packet, packet_flow_id_offset, uint32_t *) = flow_id;
+    packet->ol_flags |= packet_flow_id_flag;
+}
+
+static inline bool packet_has_flow_id(const rte_mbuf *packet)
+{
+    return packet->ol_flags & packet_flow_id_flag;
+}
+
+static inline uint32_t packet_flow_id(const rte_mbuf *packet)
+{
+    return *RTE_MBUF_DYNFIELD(packet, packet_flow_id_offset, const uint32_t *);
+}
+
+static inline void packet_set_sequence(rte_mbuf *packet, rte_reorder_seqn_t sequence)
+{
+    *RTE_MBUF_DYNFIELD(packet, packet_sequence_offset, rte_reorder_seqn_t *) = sequence;
+    packet->ol_flags |= packet_sequence_flag;
+}
+
+static inline bool packet_has_sequence(const rte_mbuf *packet)
+{
+    return packet->ol_flags & packet_sequence_flag;
+}
+
+static inline rte_reorder_seqn_t packet_sequence(const rte_mbuf *packet)
+{
+    return *RTE_MBUF_DYNFIELD(packet, packet_sequence_offset, const rte_reorder_seqn_t *);
+}
+
+static inline void packet_set_class_id(rte_mbuf *packet, uint32_t class_id)
+{
+    *RTE_MBUF_DYNFIELD(packet, packet_class_id_offset, uint32_t *) = class_id;
+    packet->ol_flags |= packet_class_id_flag;
+}
+
+static inline bool packet_has_class_id(const rte_mbuf *packet)
+{
+    return packet->ol_flags & packet_class_id_flag;
+}
+
+static inline uint32_t packet_class_id(const rte_mbuf *packet)
+{
+    return *RTE_MBUF_DYNFIELD(packet, packet_class_id_offset, const uint32_t *);
+}
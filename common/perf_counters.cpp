@@ -0,0 +1,210 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <rte_atomic.h>
+#include <rte_telemetry.h>
+
+bool perf_counters_enabled = false;
+perf_lcore perf_lcore_counters[RTE_MAX_LCORE];
+
+static const char *const counter_names[perf_counter_count] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+static const uint64_t counter_configs[perf_counter_count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+static void close_counters(perf_lcore &perf)
+{
+    for (uint32_t i = 0; i < perf_counter_count; i++) {
+        if (perf.pages[i] != nullptr) {
+            munmap(const_cast<perf_event_mmap_page *>(perf.pages[i]), sysconf(_SC_PAGESIZE));
+            perf.pages[i] = nullptr;
+        }
+        if (perf.fds[i] >= 0) {
+            close(perf.fds[i]);
+            perf.fds[i] = -1;
+        }
+    }
+}
+
+void perf_counters_open(perf_lcore &perf)
+{
+    // The first counter is the group leader. The group is scheduled on the PMU as a whole, so all counters cover the
+    // same instructions.
+    for (uint32_t i = 0; i < perf_counter_count; i++) {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = counter_configs[i];
+        attr.disabled = (i == 0);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        perf.fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, (i == 0) ? -1 : perf.fds[0], 0);
+        void *page = (perf.fds[i] < 0) ? MAP_FAILED :
+                     mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, perf.fds[i], 0);
+        if (page == MAP_FAILED) {
+            std::cout << "Warning: Unable to open the " << counter_names[i] << " counter on lcore " << rte_lcore_id()
+                      << ". Error: " << strerror(errno) << ". Ignoring ... " << std::endl;
+            close_counters(perf);
+            perf.state = perf_lcore_state::failed;
+            return;
+        }
+        perf.pages[i] = static_cast<const perf_event_mmap_page *>(page);
+    }
+
+    ioctl(perf.fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf.use_rdpmc = true;
+    for (const perf_event_mmap_page *page : perf.pages) {
+        perf.use_rdpmc = perf.use_rdpmc && page->cap_user_rdpmc;
+    }
+    perf.state = perf_lcore_state::open;
+}
+
+#if defined(RTE_ARCH_X86)
+static inline uint64_t rdpmc(uint32_t counter)
+{
+    uint32_t low = 0;
+    uint32_t high = 0;
+    asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(counter));
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+// Reads a counter from user space as described in include/uapi/linux/perf_event.h: the kernel keeps the offset and the
+// hardware counter index in the mapped page, and the sequence lock detects a concurrent update by the kernel.
+static inline uint64_t read_counter_rdpmc(const perf_event_mmap_page *page)
+{
+    uint32_t seq = 0;
+    uint64_t count = 0;
+    do {
+        seq = page->lock;
+        rte_compiler_barrier();
+        const uint32_t index = page->index;
+        count = page->offset;
+        if (index != 0) {
+            const uint32_t shift = 64 - page->pmc_width;
+            count += static_cast<uint64_t>(static_cast<int64_t>(rdpmc(index - 1) << shift) >> shift);
+        }
+        rte_compiler_barrier();
+    } while (page->lock != seq);
+    return count;
+}
+#endif
+
+void perf_counters_read(const perf_lcore &perf, uint64_t values[perf_counter_count])
+{
+#if defined(RTE_ARCH_X86)
+    if (perf.use_rdpmc) {
+        for (uint32_t i = 0; i < perf_counter_count; i++) {
+            values[i] = read_counter_rdpmc(perf.pages[i]);
+        }
+        return;
+    }
+#endif
+    for (uint32_t i = 0; i < perf_counter_count; i++) {
+        if (read(perf.fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+            values[i] = 0;
+        }
+    }
+}
+
+// Returns `value` / `divisor`, 0 if `divisor` is 0.
+static double ratio(uint64_t value, uint64_t divisor)
+{
+    return (divisor == 0) ? 0 : static_cast<double>(value) / divisor;
+}
+
+static int perf_command(const char *cmd, const char *params, rte_tel_data *data)
+{
+    rte_tel_data_start_dict(data);
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const perf_lcore &perf = perf_lcore_counters[lcore_id];
+        const uint64_t packets = perf.packets.load(std::memory_order_relaxed);
+        if (packets == 0) {
+            continue;
+        }
+
+        rte_tel_data *lcore = rte_tel_data_alloc();
+        if (lcore == nullptr) {
+            return -ENOMEM;
+        }
+        rte_tel_data_start_dict(lcore);
+        rte_tel_data_add_dict_uint(lcore, "packets", packets);
+        rte_tel_data_add_dict_uint(lcore, "bursts", perf.bursts.load(std::memory_order_relaxed));
+        for (uint32_t i = 0; i < perf_counter_count; i++) {
+            rte_tel_data_add_dict_uint(lcore, counter_names[i], perf.totals[i].load(std::memory_order_relaxed));
+        }
+
+        const std::string name = "lcore_" + std::to_string(lcore_id);
+        rte_tel_data_add_dict_container(data, name.c_str(), lcore, 0);
+    }
+
+    return 0;
+}
+
+void perf_counters_enable()
+{
+    perf_counters_enabled = true;
+    if (rte_telemetry_register_cmd("/app/perf", perf_command,
+                                   "Returns the hardware counters of the packet bursts per lcore. Takes no parameters") != 0) {
+        std::cout << "Warning: Unable to register the /app/perf telemetry command. Ignoring ... " << std::endl;
+    }
+}
+
+void perf_counters_print()
+{
+    if (!perf_counters_enabled) {
+        return;
+    }
+
+    uint32_t lcore_id = 0;
+    RTE_LCORE_FOREACH(lcore_id) {
+        const perf_lcore &perf = perf_lcore_counters[lcore_id];
+        if (perf.state != perf_lcore_state::open) {
+            continue;
+        }
+
+        uint64_t totals[perf_counter_count];
+        for (uint32_t i = 0; i < perf_counter_count; i++) {
+            totals[i] = perf.totals[i].load(std::memory_order_relaxed);
+        }
+        const uint64_t packets = perf.packets.load(std::memory_order_relaxed);
+        std::cout << "Lcore " << lcore_id << " hardware counters: packets: " << packets
+                  << " bursts: " << perf.bursts.load(std::memory_order_relaxed)
+                  << " IPC: " << ratio(totals[perf_instructions], totals[perf_cycles])
+                  << " per packet: cycles: " << ratio(totals[perf_cycles], packets)
+                  << " instructions: " << ratio(totals[perf_instructions], packets)
+                  << " LLC misses: " << ratio(totals[perf_llc_misses], packets)
+                  << " branch misses: " << ratio(totals[perf_branch_misses], packets)
+                  << (perf.use_rdpmc ? "" : " (read with read(), no rdpmc)") << std::endl;
+    }
+}
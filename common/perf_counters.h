@@ -0,0 +1,124 @@
+// MIT License
+// 
+// Copyright (c) 2024 Muhammad Awais Khalid
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <linux/perf_event.h>
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_lcore.h>
+
+// Hardware performance counters per lcore (opt-in, --perf-counters). The cycles of app_telemetry.h tell how long a
+// burst took, these tell why: every lcore opens a group of perf_event_open() counters for its own thread (cycles,
+// instructions, last level cache misses and branch misses) and reads them with the rdpmc instruction from user space,
+// which takes a few dozen cycles instead of a system call.
+//
+// The counters are read by app_telemetry_poll(): a burst starts when a poll returns packets and ends with the next
+// poll, so the deltas cover the processing and the transmission of the burst, and are divided by its packets. Empty
+// polls are not counted. The counters are opened on the first poll of an lcore, so every mode and every worker gets
+// them without changes.
+//
+// The counters count user space only, which works with the default perf_event_paranoid of 2. If the kernel does not
+// allow rdpmc (/sys/bus/event_source/devices/cpu/rdpmc is 0) the counters are read with read() instead.
+
+enum perf_counter_id {
+    perf_cycles,
+    perf_instructions,
+    perf_llc_misses,
+    perf_branch_misses,
+    perf_counter_count
+};
+
+enum class perf_lcore_state : uint8_t {
+    closed,     // Not opened yet, opened on the next poll.
+    open,
+    failed      // perf_event_open() failed, the lcore is not profiled.
+};
+
+struct alignas(RTE_CACHE_LINE_SIZE) perf_lcore {
+    // Only used by the lcore.
+    perf_lcore_state state = perf_lcore_state::closed;
+    bool use_rdpmc = false;
+    int fds[perf_counter_count] = {-1, -1, -1, -1};
+    const perf_event_mmap_page *pages[perf_counter_count] = {};
+    uint64_t start[perf_counter_count] = {};
+    uint16_t burst_packets = 0;                         // Packets of the burst in progress. 0 if there is none.
+
+    // Written by the lcore, read by the telemetry thread and at exit.
+    std::atomic<uint64_t> totals[perf_counter_count] = {};
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> bursts{0};
+};
+
+extern bool perf_counters_enabled;
+extern perf_lcore perf_lcore_counters[RTE_MAX_LCORE];
+
+// Opens the counters of the calling lcore. Called on the first poll.
+void perf_counters_open(perf_lcore &perf);
+
+// Reads all counters of the calling lcore.
+void perf_counters_read(const perf_lcore &perf, uint64_t values[perf_counter_count]);
+
+// Ends the burst in progress of the calling lcore and starts a new one if `count` packets were polled. Called by
+// app_telemetry_poll() and app_telemetry_idle(). Costs one load and a branch when the counters are not enabled.
+static inline void perf_counters_poll(uint16_t count)
+{
+    if (likely(!perf_counters_enabled)) {
+        return;
+    }
+
+    perf_lcore &perf = perf_lcore_counters[rte_lcore_id()];
+    if (unlikely(perf.state != perf_lcore_state::open)) {
+        if (perf.state == perf_lcore_state::failed) {
+            return;
+        }
+        perf_counters_open(perf);
+        return;
+    }
+    if (perf.burst_packets == 0 && count == 0) {
+        return;
+    }
+
+    uint64_t now[perf_counter_count];
+    perf_counters_read(perf, now);
+    if (perf.burst_packets != 0) {
+        for (uint32_t i = 0; i < perf_counter_count; i++) {
+            perf.totals[i].store(perf.totals[i].load(std::memory_order_relaxed) + now[i] - perf.start[i],
+                                 std::memory_order_relaxed);
+        }
+        perf.packets.store(perf.packets.load(std::memory_order_relaxed) + perf.burst_packets, std::memory_order_relaxed);
+        perf.bursts.store(perf.bursts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    perf.burst_packets = count;
+    for (uint32_t i = 0; i < perf_counter_count; i++) {
+        perf.start[i] = now[i];
+    }
+}
+
+// Enables the counters and registers the /app/perf telemetry command. Called once after parsing the arguments.
+void perf_counters_enable();
+
+// Prints IPC, cycles, instructions, LLC misses and branch misses per packet for every profiled lcore.
+void perf_counters_print();